@@ -0,0 +1,647 @@
+/**
+ * @file       bench.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Entry point for the ball detection benchmark.
+ * @details Runs every registered detector with every requested number of threads over
+ *     the same frame sets, and reports the per-frame latency, throughput, heap
+ *     allocations and, for labelled frames, the detection error of each. The fork/join
+ *     overhead of the worker pool is reported for every number of threads as well, and
+ *     every specialization of the vision kernels is timed against the generic kernels.
+ *     Every detector is checked to find the same ball on a frame with dense texture in
+ *     its top rows with one band and with four bands, which exceeds the share of the
+ *     top band but not the capacity of the frame.
+ *     Allocations after the warm-up pass can be limited, which turns the benchmark into
+ *     a check that the detectors keep their steady state free of the heap. Recordings
+ *     are made with the F9 key in the ball-tracking application and contain the grayscale
+ *     frames exactly as the detectors receive them. Results can be written as JSON, to
+ *     compare them between versions.
+ */
+
+#include "detector.h"
+#include "frames.h"
+#include "kernels.h"
+#include "pool.h"
+#include "stats.h"
+#include "tripwire.h"
+#include "vision.h"
+
+#include <opencv.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+/**
+ * @struct options
+ * @brief Command-line options of the benchmark.
+ */
+struct options {
+    std::vector<std::string> sets;                  /**< Directories or "synthetic". */
+    vis::detect_settings settings{3, 40, 0, false}; /**< Parameters of the detectors. */
+    int repeats{5};                                 /**< Number of timed passes. */
+    std::vector<int> threads;                       /**< Thread counts to run with. */
+    bench::synthetic_settings synthetic;            /**< Parameters of generated sets. */
+    std::filesystem::path json;                     /**< JSON output file, if any. */
+    std::string label;                              /**< Label of the tested version. */
+    std::optional<double> maxallocations;           /**< Allowed allocations per frame. */
+};
+
+/**
+ * @struct result
+ * @brief Measurements of one detector configuration on one frame set.
+ */
+struct result {
+    std::string set{};          /**< Name of the frame set. */
+    std::string_view method{};  /**< Name of the detector. */
+    int threads{};              /**< Number of threads in the pool. */
+    std::size_t frames{};       /**< Number of timed detections. */
+    std::size_t found{};        /**< Timed detections that found a ball. */
+    double mean{};              /**< Mean latency in milliseconds. */
+    double p50{};               /**< Median latency in milliseconds. */
+    double p90{};               /**< 90th percentile latency in milliseconds. */
+    double p99{};               /**< 99th percentile latency in milliseconds. */
+    double max{};               /**< Maximum latency in milliseconds. */
+    double throughput{};        /**< Detections per second. */
+    double allocations{};       /**< Heap allocations per detection. */
+    std::size_t labelled{};     /**< Frames with a known ground truth. */
+    std::size_t misses{};       /**< Labelled frames on which the ball was missed. */
+    std::size_t falsepositives{};/**< Labelled frames without a ball that found one. */
+    std::vector<double> errors{};/**< Position errors of the labelled hits. */
+};
+
+/**
+ * @struct overhead
+ * @brief Fork/join overhead of a worker pool, measured with empty tasks.
+ */
+struct overhead {
+    int threads{};     /**< Number of threads in the pool. */
+    double loop_p50{}; /**< Median duration of a loop in microseconds. */
+    double loop_p99{}; /**< 99th percentile duration of a loop in microseconds. */
+    double fork_p50{}; /**< Median duration of a fork/join in microseconds. */
+    double fork_p99{}; /**< 99th percentile duration of a fork/join in microseconds. */
+};
+
+/**
+ * @struct kernel_timing
+ * @brief Duration of the vision kernels of one frame, specialized and generic.
+ */
+struct kernel_timing {
+    vis::frame_kernels kernels{}; /**< Specialization under test. */
+    double generic_p50{};         /**< Median of the generic kernels in microseconds. */
+    double specialized_p50{};     /**< Median of the specialization in microseconds. */
+    bool identical{};             /**< Whether both produced the same images. */
+};
+
+/**
+ * @struct banding
+ * @brief Detections of one detector on the textured frame, with and without bands.
+ */
+struct banding {
+    std::string_view method{};      /**< Name of the detector. */
+    std::optional<vis::blob> whole; /**< Ball found with a single band. */
+    std::optional<vis::blob> split; /**< Ball found with several bands. */
+
+    /**
+     * @brief Returns whether both detections agree.
+     */
+    [[nodiscard]]
+    auto agrees() const noexcept -> bool {
+        if (not whole or not split) return whole.has_value() == split.has_value();
+        return std::hypot(whole->x - split->x, whole->y - split->y) < 0.05f
+            and std::abs(whole->radius - split->radius) < 0.05f;
+    }
+};
+
+constexpr auto usage = R"(usage: ball-tracking-bench [options] <frame set>...
+A frame set is a directory of recorded PNG frames, optionally labelled by a truth.csv
+file of file,x,y,radius rows, or "synthetic" for generated and labelled frames.
+options:
+  --min-radius <px>       minimum radius of the ball (3)
+  --max-radius <px>       maximum radius of the ball (40)
+  --threshold <level>     blob threshold, or 0 to select one automatically (0)
+  --edge-threshold <step> edge step of the gradient voter, or 0 to select one (0)
+  --dark                  the ball is darker than the plate
+  --repeats <n>           number of timed passes over the frames (5)
+  --threads <n>[,<n>...]  thread counts to run with, 0 for one per core (1)
+  --frames <n>            number of synthetic frames (500)
+  --size <w>x<h>          size of the synthetic frames (320x240)
+  --radius <px>           radius of the synthetic ball (12)
+  --noise <level>         amplitude of the synthetic noise (8)
+  --seed <n>              seed of the synthetic noise (1)
+  --json <file>           write the results as JSON
+  --label <text>          label of the version under test, stored in the JSON
+  --max-allocs <n>        fail if a detector allocates more than n times per frame
+                          once warmed up, as a gate for the steady state
+)";
+
+/**
+ * @brief Parses a number, or returns none if the text is not entirely a number.
+ */
+template <typename T>
+auto parse(std::string_view text) -> std::optional<T> {
+    auto value = T{};
+    auto const [end, error] = std::from_chars(text.data(), text.data() + text.size(),
+        value);
+    if (error != std::errc{} or end != text.data() + text.size()) return std::nullopt;
+    return value;
+}
+
+/**
+ * @brief Parses a list of numbers separated by a single character.
+ */
+template <typename T>
+auto parse_list(std::string_view text, char separator) -> std::optional<std::vector<T>> {
+    auto values = std::vector<T>{};
+    while (true) {
+        auto const end = text.find(separator);
+        auto const value = parse<T>(text.substr(0, end));
+        if (not value) return std::nullopt;
+        values.push_back(*value);
+        if (end == std::string_view::npos) return values;
+        text.remove_prefix(end + 1);
+    }
+}
+
+/**
+ * @brief Parses the command-line arguments.
+ * @return If the arguments are valid, returns the options. Otherwise, returns none.
+ */
+auto parse_options(int argc, char* argv[]) -> std::optional<options> {
+    auto opts = options{};
+    for (int i{1}; i < argc; ++i) {
+        auto const arg = std::string_view{argv[i]};
+        if (not arg.starts_with("--")) {
+            opts.sets.emplace_back(arg);
+            continue;
+        }
+        if (arg == "--dark") {
+            opts.settings.dark = true;
+            opts.synthetic.dark = true;
+            continue;
+        }
+        if (i + 1 >= argc) return std::nullopt;
+        auto const value = std::string_view{argv[++i]};
+
+        auto valid = true;
+        auto const number = [&](auto& target) {
+            auto const parsed = parse<std::remove_reference_t<decltype(target)>>(value);
+            valid = parsed.has_value();
+            if (valid) target = *parsed;
+        };
+        if (arg == "--min-radius") number(opts.settings.minradius);
+        else if (arg == "--max-radius") number(opts.settings.maxradius);
+        else if (arg == "--threshold") number(opts.settings.threshold);
+        else if (arg == "--edge-threshold") number(opts.settings.edgethreshold);
+        else if (arg == "--repeats") number(opts.repeats);
+        else if (arg == "--frames") number(opts.synthetic.frames);
+        else if (arg == "--radius") number(opts.synthetic.radius);
+        else if (arg == "--noise") number(opts.synthetic.noise);
+        else if (arg == "--seed") number(opts.synthetic.seed);
+        else if (arg == "--json") opts.json = value;
+        else if (arg == "--label") opts.label = value;
+        else if (arg == "--max-allocs") {
+            opts.maxallocations = parse<double>(value);
+            valid = opts.maxallocations.has_value();
+        }
+        else if (arg == "--threads") {
+            auto threads = parse_list<int>(value, ',');
+            valid = threads.has_value();
+            if (valid) opts.threads = std::move(*threads);
+        } else if (arg == "--size") {
+            auto const size = parse_list<int>(value, 'x');
+            valid = size and size->size() == 2;
+            if (valid) {
+                opts.synthetic.width = size->front();
+                opts.synthetic.height = size->back();
+            }
+        } else {
+            valid = false;
+        }
+        if (not valid) return std::nullopt;
+    }
+    if (opts.sets.empty()) return std::nullopt;
+    if (opts.threads.empty()) opts.threads.push_back(1);
+    opts.repeats = std::max(opts.repeats, 1);
+    return opts;
+}
+
+/**
+ * @brief Returns the given percentile of a set of samples, or zero if there are none.
+ */
+auto percentile(std::vector<double> samples, double p) -> double {
+    if (samples.empty()) return 0.0;
+    auto const rank = std::clamp(p, 0.0, 100.0) / 100.0 * (samples.size() - 1);
+    auto const nth = samples.begin() + static_cast<std::ptrdiff_t>(rank + 0.5);
+    std::ranges::nth_element(samples, nth);
+    return *nth;
+}
+
+/**
+ * @brief Runs a detector over all frames of a set.
+ * @details The first pass warms up the caches and any lazily allocated buffers, and is
+ *     the one that is compared to the ground truth. The detectors are deterministic, so
+ *     the timed passes find the same balls.
+ */
+auto run(bench::frame_set const& set, vis::detector& detector,
+    vis::detect_settings const& settings, int repeats) -> result
+{
+    auto out = result{.set = set.name};
+    auto detection = vis::detection{};
+    detection.candidates.reserve(vis::blob_detector::maxcandidates);
+    auto const detect = [&](cv::Mat const& image) {
+        detector.detect(image, {0, 0, image.cols, image.rows}, settings, detection);
+        return detection.best();
+    };
+
+    for (auto const& frame : set.frames) {
+        auto const ball = detect(frame.image);
+        if (not frame.labelled) continue;
+        ++out.labelled;
+        if (frame.ball and ball) {
+            out.errors.push_back(std::hypot(ball->x - frame.ball->x,
+                ball->y - frame.ball->y));
+        }
+        out.misses += frame.ball and not ball;
+        out.falsepositives += not frame.ball and ball;
+    }
+
+    auto latency = perf::latency_stats{set.frames.size() * repeats};
+    auto const allocated = perf::total_allocations();
+    auto const start = perf::clock::now();
+    for (int r{}; r < repeats; ++r) {
+        for (auto const& frame : set.frames) {
+            auto const t = perf::clock::now();
+            auto const ball = detect(frame.image);
+            latency.add(perf::elapsed_ms(t));
+            out.found += ball.has_value();
+        }
+    }
+    auto const total = perf::elapsed_ms(start);
+
+    out.frames = latency.count();
+    out.mean = latency.mean();
+    out.p50 = latency.percentile(50.0);
+    out.p90 = latency.percentile(90.0);
+    out.p99 = latency.percentile(99.0);
+    out.max = latency.max();
+    out.throughput = 1'000.0 * out.frames / std::max(total, 1e-9);
+    out.allocations = static_cast<double>(perf::total_allocations() - allocated)
+        / std::max<std::size_t>(out.frames, 1);
+    return out;
+}
+
+/**
+ * @brief Measures the fork/join overhead of a worker pool.
+ * @details Times loops of one empty task per thread and forks of a single empty task,
+ *     back to back, which is how the vision passes of a frame follow each other.
+ */
+auto measure(par::worker_pool& workers) -> overhead {
+    constexpr auto samples = 10'000;
+    auto loops = perf::latency_stats{samples};
+    auto forks = perf::latency_stats{samples};
+    auto counter = std::atomic<int>{};
+    auto const task = [&] { counter.fetch_add(1, std::memory_order_relaxed); };
+    for (int i{}; i < samples; ++i) {
+        auto t = perf::clock::now();
+        workers.run(workers.size(), [&](int) { task(); });
+        loops.add(perf::elapsed_ms(t));
+        t = perf::clock::now();
+        workers.fork_join(task, task);
+        forks.add(perf::elapsed_ms(t));
+    }
+    return {
+        .threads = workers.size(),
+        .loop_p50 = 1'000.0 * loops.percentile(50.0),
+        .loop_p99 = 1'000.0 * loops.percentile(99.0),
+        .fork_p50 = 1'000.0 * forks.percentile(50.0),
+        .fork_p99 = 1'000.0 * forks.percentile(99.0)};
+}
+
+/**
+ * @brief Detects the ball in the textured frame with one band and with four bands.
+ * @details The texture overflows the share of the top band once the frame is split, which
+ *     a detector has to recover from to keep its result independent of the number of
+ *     threads.
+ */
+auto check_banding(bench::synthetic_settings settings,
+    vis::detect_settings const& detectsettings) -> std::vector<banding>
+{
+    // The frame is large enough for the pool to split it into four bands.
+    settings.width = 320;
+    settings.height = 240;
+    auto const textured = bench::make_textured(settings);
+    auto const& image = textured.image;
+    auto single = par::worker_pool{1};
+    auto banded = par::worker_pool{4};
+    auto detection = vis::detection{};
+    detection.candidates.reserve(vis::blob_detector::maxcandidates);
+
+    auto checks = std::vector<banding>{};
+    for (int i{}; auto const* entry = vis::find_detector(i); ++i) {
+        auto const detect = [&](par::worker_pool& workers) {
+            auto const detector = entry->make(image.cols, image.rows, workers);
+            detector->detect(image, {0, 0, image.cols, image.rows}, detectsettings,
+                detection);
+            return detection.best();
+        };
+        checks.push_back({entry->name, detect(single), detect(banded)});
+    }
+    return checks;
+}
+
+/**
+ * @brief Formats a detection of the banding check.
+ */
+auto format_ball(std::optional<vis::blob> const& ball) -> std::string {
+    if (not ball) return "-";
+    return std::format("{:.2f},{:.2f} r{:.2f}", ball->x, ball->y, ball->radius);
+}
+
+/**
+ * @brief Runs the kernels of a frame, which fill the searched image and its pyramid.
+ * @param[in] kernels Kernels to run.
+ * @param[in] frame Camera frame of the resolution and pixel format of the kernels.
+ * @param[out] images Searched image and the half and quarter resolution images.
+ */
+auto run_kernels(vis::frame_kernels const& kernels, cv::Mat const& frame,
+    std::array<cv::Mat, 3>& images) -> void
+{
+    auto& [image, half, quarter] = images;
+    if (kernels.gray) {
+        kernels.gray(frame.data, frame.cols, 0, image.rows, image.data);
+    } else {
+        frame.copyTo(image);
+    }
+    kernels.half(image.data, image.cols, 0, half.rows, half.data);
+    kernels.quarter(half.data, half.cols, 0, quarter.rows, quarter.data);
+}
+
+/**
+ * @brief Times a specialization of the vision kernels against the generic kernels.
+ * @details Both run on the same frame of noise, alternately, so that either sees the
+ *     same state of the caches. Copying a gray frame into the searched image is part of
+ *     either timing.
+ */
+auto measure(vis::frame_kernels const& kernels) -> kernel_timing {
+    constexpr auto samples = 2'000;
+    auto const color = kernels.format == vis::pixel_format::bgr
+        or kernels.format == vis::pixel_format::rgb;
+    auto const scale = kernels.format == vis::pixel_format::bayer ? 2 : 1;
+    auto frame = cv::Mat{kernels.height, kernels.width, color ? CV_8UC3 : CV_8UC1};
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    auto const make_images = [&] {
+        auto const width = kernels.width / scale;
+        auto const height = kernels.height / scale;
+        return std::array{cv::Mat{height, width, CV_8UC1},
+            cv::Mat{height / 2, width / 2, CV_8UC1},
+            cv::Mat{height / 4, width / 4, CV_8UC1}};
+    };
+    auto specialized = make_images();
+    auto generic = make_images();
+    auto const fallback = vis::generic_kernels(kernels.format);
+    auto specializedtimes = perf::latency_stats{samples};
+    auto generictimes = perf::latency_stats{samples};
+    for (int i{}; i < samples; ++i) {
+        auto t = perf::clock::now();
+        run_kernels(kernels, frame, specialized);
+        specializedtimes.add(perf::elapsed_ms(t));
+        t = perf::clock::now();
+        run_kernels(fallback, frame, generic);
+        generictimes.add(perf::elapsed_ms(t));
+    }
+
+    auto identical = true;
+    for (std::size_t i{}; i < specialized.size(); ++i) {
+        identical = identical and cv::norm(specialized[i], generic[i], cv::NORM_INF) == 0;
+    }
+    return {
+        .kernels = kernels,
+        .generic_p50 = 1'000.0 * generictimes.percentile(50.0),
+        .specialized_p50 = 1'000.0 * specializedtimes.percentile(50.0),
+        .identical = identical};
+}
+
+/**
+ * @brief Formats a result as a row of the table.
+ */
+auto format_row(result const& r) -> std::string {
+    auto const errors = r.errors.empty() ? std::string{"-"} : std::format("{:.2f}/{:.2f}",
+        std::reduce(r.errors.begin(), r.errors.end()) / r.errors.size(),
+        percentile(r.errors, 95.0));
+    return std::format("{:<20} {:>8} {:>3} {:>6.1f}% {:>7.3f} {:>7.3f} {:>7.3f} {:>7.3f}"
+        " {:>8.1f} {:>7.1f} {:>11} {:>5} {:>5}\n", r.set, r.method, r.threads,
+        100.0 * r.found / std::max<std::size_t>(r.frames, 1), r.mean, r.p50, r.p99, r.max,
+        r.throughput, r.allocations, errors, r.misses, r.falsepositives);
+}
+
+/**
+ * @brief Escapes a string for a JSON document.
+ */
+auto escape(std::string_view text) -> std::string {
+    auto escaped = std::string{};
+    for (auto const c : text) {
+        if (c == '"' or c == '\\') escaped += '\\';
+        if (static_cast<unsigned char>(c) >= ' ') escaped += c;
+    }
+    return escaped;
+}
+
+/**
+ * @brief Writes the options and results as a JSON document.
+ */
+auto write_json(std::ostream& out, options const& opts,
+    std::vector<result> const& results, std::vector<overhead> const& overheads,
+    std::vector<kernel_timing> const& kernels) -> void
+{
+    out << std::format("{{\n  \"label\": \"{}\",\n  \"settings\": {{\"min_radius\": {},"
+        " \"max_radius\": {}, \"threshold\": {}, \"edge_threshold\": {}, \"dark\": {},"
+        " \"repeats\": {}}},\n  \"results\": [", escape(opts.label),
+        opts.settings.minradius, opts.settings.maxradius, opts.settings.threshold,
+        opts.settings.edgethreshold, opts.settings.dark, opts.repeats);
+    for (auto separator = ""; auto const& r : results) {
+        out << std::format("{}\n    {{\"set\": \"{}\", \"detector\": \"{}\","
+            " \"threads\": {}, \"frames\": {}, \"found\": {},\n"
+            "     \"latency_ms\": {{\"mean\": {:.4f}, \"p50\": {:.4f}, \"p90\": {:.4f},"
+            " \"p99\": {:.4f}, \"max\": {:.4f}}},\n     \"frames_per_s\": {:.1f},"
+            " \"allocations_per_frame\": {:.3f},\n     \"accuracy\": ", separator,
+            escape(r.set), r.method, r.threads, r.frames, r.found, r.mean, r.p50, r.p90,
+            r.p99, r.max, r.throughput, r.allocations);
+        if (r.labelled == 0) {
+            out << "null}";
+        } else {
+            auto const mean = r.errors.empty() ? 0.0
+                : std::reduce(r.errors.begin(), r.errors.end()) / r.errors.size();
+            auto const max = r.errors.empty() ? 0.0 : std::ranges::max(r.errors);
+            out << std::format("{{\"labelled\": {}, \"hits\": {}, \"misses\": {},"
+                " \"false_positives\": {}, \"error_px\": {{\"mean\": {:.4f},"
+                " \"p95\": {:.4f}, \"max\": {:.4f}}}}}}}", r.labelled, r.errors.size(),
+                r.misses, r.falsepositives, mean, percentile(r.errors, 95.0), max);
+        }
+        separator = ",";
+    }
+    out << "\n  ],\n  \"pool\": [";
+    for (auto separator = ""; auto const& o : overheads) {
+        out << std::format("{}\n    {{\"threads\": {}, \"loop_us\": {{\"p50\": {:.3f},"
+            " \"p99\": {:.3f}}}, \"fork_join_us\": {{\"p50\": {:.3f},"
+            " \"p99\": {:.3f}}}}}", separator, o.threads, o.loop_p50, o.loop_p99,
+            o.fork_p50, o.fork_p99);
+        separator = ",";
+    }
+    out << "\n  ],\n  \"kernels\": [";
+    for (auto separator = ""; auto const& k : kernels) {
+        out << std::format("{}\n    {{\"width\": {}, \"height\": {}, \"format\": \"{}\","
+            " \"generic_us\": {:.3f}, \"specialized_us\": {:.3f}, \"identical\": {}}}",
+            separator, k.kernels.width, k.kernels.height,
+            vis::to_string(k.kernels.format), k.generic_p50, k.specialized_p50,
+            k.identical);
+        separator = ",";
+    }
+    out << "\n  ]\n}\n";
+}
+
+} // namespace
+
+/**
+ * @brief Benchmarks the ball detection methods on recorded and generated frames.
+ * @details See the usage text for the command-line arguments.
+ * @retval EXIT_SUCCESS The benchmark completed.
+ * @retval EXIT_FAILURE The arguments were invalid, a frame set was empty, a detector
+ *     allocated more than allowed, a detector depended on the number of bands, a
+ *     specialized kernel disagreed with the generic one or some exception occurred.
+ */
+auto main(int argc, char* argv[]) -> int {
+    try {
+        auto const opts = parse_options(argc, argv);
+        if (not opts) {
+            std::cerr << usage;
+            return EXIT_FAILURE;
+        }
+
+        auto sets = std::vector<bench::frame_set>{};
+        for (auto const& name : opts->sets) {
+            sets.push_back(name == "synthetic"
+                ? bench::make_synthetic(opts->synthetic)
+                : bench::load_recording(name));
+            if (sets.back().frames.empty()) {
+                std::cerr << std::format("no frames found in {}\n", name);
+                return EXIT_FAILURE;
+            }
+        }
+
+        std::cout << std::format("{} passes, radius {}-{}, threshold {}\n"
+            "{:<20} {:>8} {:>3} {:>7} {:>7} {:>7} {:>7} {:>7} {:>8} {:>7} {:>11} {:>5}"
+            " {:>5}\n", opts->repeats, opts->settings.minradius, opts->settings.maxradius,
+            opts->settings.threshold, "set", "method", "thr", "found", "mean ms",
+            "p50 ms", "p99 ms", "max ms", "frames/s", "allocs", "error px", "miss",
+            "false");
+
+        auto results = std::vector<result>{};
+        auto overheads = std::vector<overhead>{};
+        for (auto const threads : opts->threads) {
+            auto workers = par::worker_pool{threads};
+            overheads.push_back(measure(workers));
+        }
+        for (auto const& set : sets) {
+            auto const frames = std::views::transform(set.frames, &bench::frame::image);
+            auto const width = std::ranges::max(frames, {}, &cv::Mat::cols).cols;
+            auto const height = std::ranges::max(frames, {}, &cv::Mat::rows).rows;
+            for (auto const threads : opts->threads) {
+                auto workers = par::worker_pool{threads};
+                for (int i{}; auto const* entry = vis::find_detector(i); ++i) {
+                    auto const detector = entry->make(width, height, workers);
+                    auto& r = results.emplace_back(run(set, *detector, opts->settings,
+                        opts->repeats));
+                    r.method = entry->name;
+                    r.threads = workers.size();
+                    std::cout << format_row(r);
+                }
+            }
+        }
+
+        std::cout << std::format("\n{:>3} {:>12} {:>12} {:>12} {:>12}\n", "thr",
+            "loop p50 us", "loop p99 us", "fork p50 us", "fork p99 us");
+        for (auto const& o : overheads) {
+            std::cout << std::format("{:>3} {:>12.2f} {:>12.2f} {:>12.2f} {:>12.2f}\n",
+                o.threads, o.loop_p50, o.loop_p99, o.fork_p50, o.fork_p99);
+        }
+
+        auto const bandings = check_banding(opts->synthetic, opts->settings);
+        std::cout << std::format("\n{:>8} {:>22} {:>22} {:>7}\n", "method", "1 band",
+            "4 bands", "agrees");
+        for (auto const& b : bandings) {
+            std::cout << std::format("{:>8} {:>22} {:>22} {:>7}\n", b.method,
+                format_ball(b.whole), format_ball(b.split), b.agrees());
+        }
+
+        auto kernels = std::vector<kernel_timing>{};
+        std::cout << std::format("\n{:>9} {:>6} {:>12} {:>12} {:>8} {:>9}\n", "frame",
+            "format", "generic us", "special us", "speedup", "identical");
+        for (int i{}; auto const* entry = vis::find_kernels(i); ++i) {
+            auto const& k = kernels.emplace_back(measure(*entry));
+            std::cout << std::format("{:>9} {:>6} {:>12.2f} {:>12.2f} {:>7.2f}x {:>9}\n",
+                std::format("{}x{}", entry->width, entry->height),
+                vis::to_string(entry->format), k.generic_p50, k.specialized_p50,
+                k.generic_p50 / std::max(k.specialized_p50, 1e-9), k.identical);
+        }
+
+        if (not opts->json.empty()) {
+            auto output = std::ofstream{opts->json};
+            write_json(output, *opts, results, overheads, kernels);
+            if (not output) {
+                std::cerr << std::format("failed to write {}\n", opts->json.string());
+                return EXIT_FAILURE;
+            }
+        }
+
+        auto allocating = false;
+        for (auto const& r : results) {
+            if (not opts->maxallocations or r.allocations <= *opts->maxallocations) {
+                continue;
+            }
+            std::cerr << std::format("{} with {} threads allocates {:.3f} times per frame"
+                " on {}, above the limit of {}\n", r.method, r.threads, r.allocations,
+                r.set, *opts->maxallocations);
+            allocating = true;
+        }
+        auto const mismatch = std::ranges::any_of(kernels, [](kernel_timing const& k) {
+            return not k.identical;
+        });
+        if (mismatch) {
+            std::cerr << "a specialized kernel disagrees with the generic kernels\n";
+        }
+        auto const banded = std::ranges::all_of(bandings, &banding::agrees);
+        if (not banded) {
+            std::cerr << "a detector depends on the number of bands\n";
+        }
+        return allocating or mismatch or not banded ? EXIT_FAILURE : EXIT_SUCCESS;
+    } catch (std::exception const& error) {
+        std::cerr << std::format("unexpected exception occurred: {}\n", error.what());
+    } catch (...) {
+        std::cerr << "unhandled exception occurred\n";
+    }
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,200 @@
+/**
+ * @file       frames.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the benchmark frame sets.
+ */
+
+#include "frames.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <numbers>
+#include <random>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * @namespace bench
+ * @brief Benchmark related components.
+ */
+namespace bench {
+
+namespace {
+
+/**
+ * @brief Splits a row of comma separated fields.
+ */
+auto split(std::string_view row) -> std::vector<std::string_view> {
+    auto fields = std::vector<std::string_view>{};
+    while (true) {
+        auto const comma = row.find(',');
+        fields.push_back(row.substr(0, comma));
+        if (comma == std::string_view::npos) return fields;
+        row.remove_prefix(comma + 1);
+    }
+}
+
+/**
+ * @brief Parses a number, or returns none if the field does not start with one.
+ */
+auto parse(std::string_view field) -> std::optional<float> {
+    while (field.starts_with(' ')) field.remove_prefix(1);
+    auto value = 0.f;
+    auto const [end, error] = std::from_chars(field.data(), field.data() + field.size(),
+        value);
+    if (error != std::errc{}) return std::nullopt;
+    return value;
+}
+
+/**
+ * @brief Reads the labels of a truth file, by file name.
+ */
+auto load_truth(std::filesystem::path const& file)
+    -> std::unordered_map<std::string, std::optional<vis::blob>>
+{
+    auto truth = std::unordered_map<std::string, std::optional<vis::blob>>{};
+    auto input = std::ifstream{file};
+    for (auto row = std::string{}; std::getline(input, row);) {
+        if (not row.empty() and row.back() == '\r') row.pop_back();
+        auto const fields = split(row);
+        if (fields.front().empty() or fields.front() == "file") continue;
+
+        auto ball = std::optional<vis::blob>{};
+        if (fields.size() >= 4) {
+            auto const x = parse(fields[1]);
+            auto const y = parse(fields[2]);
+            auto const radius = parse(fields[3]);
+            if (x and y and radius) ball = vis::blob{*x, *y, *radius};
+        }
+        truth.insert_or_assign(std::string{fields.front()}, ball);
+    }
+    return truth;
+}
+
+} // namespace
+
+/**
+ * @copydoc load_recording
+ */
+auto load_recording(std::filesystem::path const& directory) -> frame_set {
+    auto files = std::vector<std::filesystem::path>{};
+    for (auto const& entry : std::filesystem::directory_iterator{directory}) {
+        if (entry.path().extension() == ".png") {
+            files.push_back(entry.path());
+        }
+    }
+    std::ranges::sort(files);
+
+    auto const truthfile = directory / "truth.csv";
+    auto const truth = std::filesystem::exists(truthfile)
+        ? load_truth(truthfile)
+        : std::unordered_map<std::string, std::optional<vis::blob>>{};
+
+    auto set = frame_set{.name = directory.filename().string()};
+    if (set.name.empty()) set.name = directory.parent_path().filename().string();
+    set.frames.reserve(files.size());
+    for (auto const& file : files) {
+        auto image = cv::imread(file.string(), cv::IMREAD_GRAYSCALE);
+        if (image.empty()) continue;
+        auto const label = truth.find(file.filename().string());
+        set.frames.push_back({
+            .image = std::move(image),
+            .labelled = label != truth.end(),
+            .ball = label != truth.end() ? label->second : std::nullopt});
+    }
+    return set;
+}
+
+/**
+ * @copydoc make_synthetic
+ */
+auto make_synthetic(synthetic_settings const& settings) -> frame_set {
+    // The periods have no common divisor, so the path does not repeat within a set.
+    constexpr auto xperiod = 173.0;
+    constexpr auto yperiod = 97.0;
+    constexpr auto absent = 25;
+    constexpr auto plate = 80;
+    constexpr auto gradient = 12;
+    constexpr auto subsamples = 4;
+
+    auto const width = std::max(settings.width, 1);
+    auto const height = std::max(settings.height, 1);
+    auto const r = settings.radius;
+    auto const foreground = settings.dark ? 20.f : 200.f;
+    auto random = std::mt19937{settings.seed};
+    auto noise = std::uniform_int_distribution{-settings.noise, settings.noise};
+
+    auto set = frame_set{.name = std::format("synthetic {}x{}", width, height)};
+    set.frames.reserve(std::max(settings.frames, 0));
+    for (int i{}; i < settings.frames; ++i) {
+        auto const phase = 2.0 * std::numbers::pi * i;
+        auto const ball = vis::blob{
+            static_cast<float>(width / 2.0 + (width / 2.0 - r - 2.0)
+                * std::sin(phase / xperiod)),
+            static_cast<float>(height / 2.0 + (height / 2.0 - r - 2.0)
+                * std::sin(phase / yperiod + 0.5)),
+            r};
+        auto const present = i % absent != absent - 1;
+
+        auto image = cv::Mat(height, width, CV_8UC1);
+        for (int y{}; y < height; ++y) {
+            auto* const row = image.ptr(y);
+            for (int x{}; x < width; ++x) {
+                auto value = static_cast<float>(plate + gradient * x / width);
+                auto const d = std::hypot(x - ball.x, y - ball.y);
+                if (present and d < r + 1.f) {
+                    // Coverage of the pixel, supersampled near the edge only.
+                    auto coverage = 1.f;
+                    if (d > r - 1.f) {
+                        auto inside = 0;
+                        for (int sy{}; sy < subsamples; ++sy) {
+                            for (int sx{}; sx < subsamples; ++sx) {
+                                auto const px = x + (sx + 0.5f) / subsamples - 0.5f;
+                                auto const py = y + (sy + 0.5f) / subsamples - 0.5f;
+                                inside += std::hypot(px - ball.x, py - ball.y) <= r;
+                            }
+                        }
+                        coverage = static_cast<float>(inside)
+                            / (subsamples * subsamples);
+                    }
+                    value += coverage * (foreground - value);
+                }
+                value += static_cast<float>(noise(random));
+                row[x] = static_cast<unsigned char>(std::clamp(value, 0.f, 255.f));
+            }
+        }
+        set.frames.push_back({
+            .image = std::move(image),
+            .labelled = true,
+            .ball = present ? std::optional{ball} : std::nullopt});
+    }
+    return set;
+}
+
+/**
+ * @copydoc make_textured
+ */
+auto make_textured(synthetic_settings const& settings) -> frame {
+    auto first = settings;
+    first.frames = 1;
+    auto textured = std::move(make_synthetic(first).frames.front());
+    auto const plate = 80;
+    auto const foreground = settings.dark ? 20 : 200;
+    for (int y{}; y < textured.image.rows / 12; ++y) {
+        auto* const row = textured.image.ptr(y);
+        for (int x{}; x < textured.image.cols; ++x) {
+            row[x] = static_cast<unsigned char>((x + y) % 2 ? foreground : plate);
+        }
+    }
+    return textured;
+}
+
+} // namespace bench
@@ -0,0 +1,97 @@
+/**
+ * @file       frames.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Frame sets to benchmark the ball detectors on.
+ */
+
+#ifndef BENCH_FRAMES_H
+#define BENCH_FRAMES_H
+
+#include "vision.h"
+
+#include <opencv.hpp>
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @namespace bench
+ * @brief Benchmark related components.
+ */
+namespace bench {
+
+/**
+ * @struct frame
+ * @brief Grayscale frame with its ground truth, if known.
+ */
+struct frame {
+    cv::Mat image;                 /**< Grayscale image. */
+    bool labelled;                 /**< Whether the ground truth is known. */
+    std::optional<vis::blob> ball; /**< Actual ball, or none if it is absent. */
+};
+
+/**
+ * @struct frame_set
+ * @brief Named sequence of frames.
+ */
+struct frame_set {
+    std::string name;          /**< Name to report the set by. */
+    std::vector<frame> frames; /**< Frames in order of capture. */
+};
+
+/**
+ * @struct synthetic_settings
+ * @brief Parameters of a generated frame set.
+ */
+struct synthetic_settings {
+    int width{320};     /**< Width of the frames. */
+    int height{240};    /**< Height of the frames. */
+    int frames{500};    /**< Number of frames. */
+    float radius{12.f}; /**< Radius of the ball. */
+    int noise{8};       /**< Amplitude of the uniform sensor noise. */
+    bool dark{false};   /**< Whether the ball is darker than the plate. */
+    unsigned seed{1};   /**< Seed of the noise, so that sets can be reproduced. */
+};
+
+/**
+ * @brief Loads a recording of the ball-tracking application.
+ * @details Loads all PNG images in the directory as grayscale frames, sorted by name.
+ *     If the directory contains a truth.csv file, its rows of file,x,y,radius label the
+ *     frames with the given file names. Leaving the position empty labels a frame
+ *     without a ball. A header row is allowed.
+ * @param[in] directory Directory of the recording.
+ */
+[[nodiscard]]
+auto load_recording(std::filesystem::path const& directory) -> frame_set;
+
+/**
+ * @brief Generates a labelled frame set.
+ * @details Renders an anti-aliased ball moving along a Lissajous curve over a plate with
+ *     a gradient and sensor noise. Every 25th frame leaves out the ball, to count false
+ *     positives.
+ * @param[in] settings Parameters of the set.
+ */
+[[nodiscard]]
+auto make_synthetic(synthetic_settings const& settings) -> frame_set;
+
+/**
+ * @brief Generates a labelled frame whose top rows are covered by a checkerboard.
+ * @details The first frame of a synthetic set, of which the top twelfth is replaced by
+ *     a checkerboard of single pixels in the colors of the plate and the ball. Its runs
+ *     and edges fit within the capacity of the detectors for the frame, but not within
+ *     the share of a single band once the frame is split into four or more bands.
+ * @param[in] settings Parameters of the set, of which the number of frames is ignored.
+ */
+[[nodiscard]]
+auto make_textured(synthetic_settings const& settings) -> frame;
+
+} // namespace bench
+
+#endif
@@ -16,10 +16,19 @@
 
 #include <algorithm>
 #include <cctype>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
 #include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <numbers>
 #include <numeric>
+#include <string_view>
+#include <system_error>
 #include <vector>
 
 /**
@@ -32,23 +41,88 @@ namespace of {
  * @copydoc app::setup
  */
 auto app::setup() -> void {
+    apply_scheduling("ui", appcfg->pipeline.ui);
+    if (auto const megabytes = appcfg->pipeline.lockmemory.to<int>(); megabytes > 0) {
+        auto const locked = par::lock_memory(static_cast<std::size_t>(megabytes) << 20);
+        std::cout << std::format("memory: {} MB {}\n", megabytes,
+            locked ? "locked" : "not locked");
+    }
+    cam::ps3cam::setTransferThreadInit(
+        [this]{ apply_scheduling("usb", appcfg->pipeline.usb); });
+    cam::ps3cam::setBufferAllocator(
+        [this](std::size_t bytes) { return allocate_resident(bytes); });
     camera = cam::get_device();
     cam::start_camera(*camera, appcfg->cam);
+    make_shutter();
     auto const framesize = appcfg->cam.frame.size(camera->getOutputBytesPerPixel());
-    camframe = std::make_unique_for_overwrite<std::uint8_t[]>(framesize);
+    framememory = allocate_resident(frames.size() * framesize);
+    if (not framememory) {
+        auto const heap = std::make_shared_for_overwrite<uint8[]>(
+            frames.size() * framesize);
+        framememory = {heap, heap.get()};
+    }
+    for (std::size_t i{}; i < frames.size(); ++i) {
+        frames[i] = framememory.get() + i * framesize;
+    }
+    if (appcfg->pipeline.resident) {
+        std::cout << std::format("resident buffers: {} of {} on large pages, {} locked\n",
+            resident.huge, resident.buffers, resident.locked);
+    }
     frame = cv::Mat{
         appcfg->cam.frame.height.to<int>(),
         appcfg->cam.frame.width.to<int>(),
-        CV_8UC1, camframe.get()};
+        CV_8UC(camera->getOutputBytesPerPixel()), frames[0]};
+    switch (static_cast<cam::format>(appcfg->cam.format.to<int>())) {
+    case cam::format::Bayer:
+        quadframe = cv::Mat{frame.rows / 2, frame.cols / 2, CV_8UC1};
+        break;
+    case cam::format::RGB:
+        colormask = cv::Mat{frame.rows, frame.cols, CV_8UC1};
+        [[fallthrough]];
+    case cam::format::BGR:
+        grayframe = cv::Mat{frame.rows, frame.cols, CV_8UC1};
+        break;
+    default:
+        break;
+    }
+    kernels = vis::select_kernels(frame.cols, frame.rows,
+        static_cast<vis::pixel_format>(appcfg->cam.format.to<int>()));
+    std::cout << std::format("vision kernels: {} for {}x{} {}\n",
+        kernels.specialized() ? "specialized" : "generic", frame.cols, frame.rows,
+        vis::to_string(kernels.format));
+    workers = std::make_unique<par::worker_pool>(appcfg->vision.threads.to<int>(),
+        appcfg->pipeline.vision.settings());
+    detection.candidates.reserve(vis::blob_detector::maxcandidates);
+    observations.reserve(vis::blob_detector::maxcandidates);
+    if (not colormask.empty()) {
+        colordetector = std::make_unique<vis::threshold_detector>(frame.cols, frame.rows,
+            *workers);
+    }
+    make_detectors();
+    make_governor();
+    make_undistortion();
+    auto const& image = quadframe.empty() ? frame : quadframe;
+    roitracker = vis::roi_tracker{image.cols, image.rows};
+    background = vis::background_model{image.cols, image.rows};
+    fgmask = cv::Mat{image.rows, image.cols, CV_8UC1, cv::Scalar{0}};
+    pyramid[0] = cv::Mat{image.rows / 2, image.cols / 2, CV_8UC1};
+    pyramid[1] = cv::Mat{image.rows / 4, image.cols / 4, CV_8UC1};
+    make_plate_mask();
     ballradius.min = appcfg->vision.ballradius.min;
     ballradius.max = appcfg->vision.ballradius.max;
+    make_flow();
     pid.kp = appcfg->pid.kp;
     pid.ki = appcfg->pid.ki;
     pid.kd = appcfg->pid.kd;
+    make_tracks();
     if (appcfg->serial.enabled) {
         start_serial();
     }
     make_menu();
+    if (appcfg->cam.probe.onstart) {
+        start_probe();
+    }
+    startfaults = par::count_page_faults();
 }
 
 /**
@@ -70,13 +144,47 @@ auto app::make_menu() noexcept -> void {
 
     cfgmenu.add('v', appcfg->vision.displaydebug);
     cfgmenu.add('l', appcfg->vision.trackball);
+    cfgmenu.add('o', appcfg->vision.colortolerance,
+        [this]{ colortable.rebuild(appcfg->vision.colortolerance); });
+    cfgmenu.add('j', appcfg->vision.method, [this]{ make_detectors(); });
+    cfgmenu.add('t', appcfg->vision.threshold);
+    cfgmenu.add('E', appcfg->vision.edgethreshold);
+    cfgmenu.add('k', appcfg->vision.darkball);
+    cfgmenu.add('x', appcfg->vision.roitracking, [this]{ roitracker.reset(); });
+    cfgmenu.add('f', appcfg->vision.background.enabled, [this]{ background.relearn(); });
+    cfgmenu.add('m', appcfg->vision.pyramid);
+    cfgmenu.add('q', appcfg->vision.threads, [this]{
+        workers = std::make_unique<par::worker_pool>(appcfg->vision.threads.to<int>(),
+            appcfg->pipeline.vision.settings());
+        make_detectors();
+    });
+    cfgmenu.add('1', appcfg->vision.shadow.method, [this]{ make_detectors(); });
+    cfgmenu.add('2', appcfg->vision.shadow.tolerance, [this]{
+        if (shadow) shadow->set_tolerance(appcfg->vision.shadow.tolerance.to<double>());
+    });
+    cfgmenu.add('3', appcfg->cam.lens.undistort, [this]{
+        make_undistortion();
+        recalibrate();
+    });
+    cfgmenu.add('4', appcfg->vision.plate.enabled, [this]{ make_plate_mask(); });
+    cfgmenu.add('5', appcfg->vision.plate.margin, [this]{ make_plate_mask(); });
+    cfgmenu.add('6', appcfg->vision.governor.enabled, [this]{ make_governor(); });
+    cfgmenu.add('7', appcfg->vision.governor.budget, [this]{ make_governor(); });
+    cfgmenu.add('8', appcfg->vision.governor.method, [this]{ make_detectors(); });
+    cfgmenu.add('9', appcfg->vision.flow.enabled, [this]{ ballflow.reset(); });
+    cfgmenu.add('0', appcfg->vision.flow.margin, [this]{ make_flow(); });
+    cfgmenu.add('G', appcfg->filter.gate, [this]{ make_tracks(); });
+    cfgmenu.add('T', appcfg->filter.tracks, [this]{ make_tracks(); });
     cfgmenu.add('z', appcfg->vision.ballradius.min,
         [this]{ ballradius.min = appcfg->vision.ballradius.min; });
-    cfgmenu.add('y', appcfg->vision.ballradius.max,
-        [this]{ ballradius.max = appcfg->vision.ballradius.max; });
+    cfgmenu.add('y', appcfg->vision.ballradius.max, [this]{
+        ballradius.max = appcfg->vision.ballradius.max;
+        make_flow();
+    });
 
     cfgmenu.add('s', appcfg->serial.enabled,
         [this]{ appcfg->serial.enabled ? start_serial() : serial.close(); });
+    cfgmenu.add('P', appcfg->pipeline.threaded);
 
     cfgmenu.add('h', appcfg->cam.sharpness,
         [this]{ camera->setSharpness(appcfg->cam.sharpness); });
@@ -108,6 +216,7 @@ auto app::make_menu() noexcept -> void {
  */
 auto app::exit() -> void {
     if (not camera) return;
+    stop_pipeline();
     camera->stop();
 }
 
@@ -117,16 +226,345 @@ auto app::exit() -> void {
 auto app::update() -> void {
     if (not camera) return;
 
-    camera->getFrame(camframe.get());
-    updateSetPoint();
+    // Probing and lens calibration restart the camera and save the configuration, so
+    // they run synchronously.
+    auto const threaded = appcfg->pipeline.threaded
+        and appmode != appstate::probing and appmode != appstate::lens;
+    if (threaded and not visionthread.joinable()) {
+        start_pipeline();
+    } else if (not threaded) {
+        stop_pipeline();
+        camera->getFrame(frame.data);
+        frametime = perf::clock::now();
+        shutter.update(camera->getFramePTS(), camera->getFrameArrival());
+        control_ball(process_frame());
+        // The vision time of a probe covers the control of the ball as well.
+        if (appmode == appstate::probing) {
+            update_probe({
+                .convert_ms = camera->getConversionTime() * 0.001,
+                .vision_ms = perf::elapsed_ms(visiontime),
+                .dropped = camera->getDroppedFrames()});
+        }
+    }
+    display.acquire();
+    status.acquire();
+    controlled.acquire();
+}
+
+/**
+ * @copydoc app::start_pipeline
+ */
+auto app::start_pipeline() -> void {
+    for (auto* const buffer : frames) {
+        if (buffer != frame.data) {
+            static_cast<void>(freeframes.try_push(buffer));
+        }
+    }
+    capturetrip.rearm();
+    visiontrip.rearm();
+    controltrip.rearm();
+    controlthread = std::jthread{[this](std::stop_token stop) { control_frames(stop); }};
+    visionthread = std::jthread{[this](std::stop_token stop) { process_frames(stop); }};
+    capturethread = std::jthread{[this](std::stop_token stop) { capture_frames(stop); }};
+}
+
+/**
+ * @copydoc app::stop_pipeline
+ */
+auto app::stop_pipeline() -> void {
+    if (not visionthread.joinable()) return;
+    capturethread.request_stop();
+    visionthread.request_stop();
+    controlthread.request_stop();
+    freeframes.interrupt();
+    fullframes.interrupt();
+    samples.interrupt();
+    // The capture stage finishes the frame that it waits for.
+    capturethread.join();
+    visionthread.join();
+    controlthread.join();
+
+    auto buffer = static_cast<uint8*>(nullptr);
+    auto captured = captured_frame{};
+    auto sample = control_sample{};
+    while (freeframes.try_pop(buffer)) {}
+    while (fullframes.try_pop(captured)) {}
+    while (samples.try_pop(sample)) {}
+}
+
+/**
+ * @copydoc app::capture_frames
+ */
+auto app::capture_frames(std::stop_token stop) -> void {
+    apply_scheduling("capture", appcfg->pipeline.capture);
+    auto buffer = static_cast<uint8*>(nullptr);
+    while (freeframes.pop(buffer, stop)) {
+        capturetrip.begin();
+        camera->getFrame(buffer);
+        // The queue holds more frames than there are buffers, so it never overflows.
+        static_cast<void>(fullframes.try_push({
+            .data = buffer,
+            .time = perf::clock::now(),
+            .pts = camera->getFramePTS(),
+            .arrival = camera->getFrameArrival()}));
+        capturetrip.end();
+    }
+}
+
+/**
+ * @copydoc app::process_frames
+ */
+auto app::process_frames(std::stop_token stop) -> void {
+    apply_scheduling("vision", appcfg->pipeline.vision);
+    auto captured = captured_frame{};
+    auto newer = captured_frame{};
+    while (fullframes.pop(captured, stop)) {
+        while (fullframes.try_pop(newer)) {
+            static_cast<void>(freeframes.try_push(captured.data));
+            captured = newer;
+        }
+        auto const lock = std::scoped_lock{visionmutex};
+        static_cast<void>(freeframes.try_push(frame.data));
+        frame = cv::Mat{frame.rows, frame.cols, frame.type(), captured.data};
+        frametime = captured.time;
+        shutter.update(captured.pts, captured.arrival);
+        // A full queue means that the control stage fell behind, which drops the sample.
+        static_cast<void>(samples.try_push(process_frame()));
+    }
+}
+
+/**
+ * @copydoc app::control_frames
+ */
+auto app::control_frames(std::stop_token stop) -> void {
+    apply_scheduling("control", appcfg->pipeline.control);
+    auto sample = control_sample{};
+    while (samples.pop(sample, stop)) {
+        auto const lock = std::scoped_lock{controlmutex};
+        control_ball(sample);
+    }
+}
+
+/**
+ * @copydoc app::process_frame
+ */
+auto app::process_frame() -> control_sample {
+    visiontime = perf::clock::now();
+    visiontrip.begin();
+    // Lens calibration keeps the views that it sees, so it allocates.
+    if (appmode == appstate::lens) {
+        visiontrip.rearm();
+    }
     camstats.update();
-    if (appcfg->vision.trackball) {
-        track_ball();
+    auto sample = control_sample{.time = frametime};
+    if (appmode == appstate::lens) {
+        update_lens_calibration();
+    } else if (appcfg->vision.trackball) {
+        sample = track_ball();
+        if (appmode != appstate::probing) {
+            govern_quality();
+        }
     }
-    if (appmode == appstate::calibration and appcfg->serial.enabled) {
-        constexpr auto servopos = std::string_view{"45.0 45.0 45.0 \n"};
-        serial.writeBytes(servopos.data(), servopos.size());
+
+    (quadframe.empty() ? frame : quadframe).copyTo(display.back());
+    if (appmode != appstate::lens and appcfg->vision.trackball) {
+        mark_tracks();
     }
+    display.publish();
+    auto const image = quadframe.empty() ? frame.size() : quadframe.size();
+    auto& shown = status.back();
+    shown.camfps = camstats.fps();
+    shown.searcharea = static_cast<double>(searchwindow.width) * searchwindow.height
+        / std::max(image.area(), 1);
+    shown.platearea = platemask->coverage();
+    shown.reacquisitions = roitracker.reacquisitions();
+    shown.threads = workers->size();
+    shown.detector = vis::find_detector(static_cast<int>(detector->kind()))->name;
+    shown.detect_ms = detection.elapsed_ms;
+    shown.tracks = balltracks.tracks().size();
+    shown.target = balltracks.target_id();
+    shown.readout_ms = 1'000.0 * shutter.readout_time();
+    shown.latency_ms = std::chrono::duration<double, std::milli>{
+        frametime - shutter.frame_time()}.count();
+    shown.synchronized = shutter.synchronized();
+    shown.flow = flowvelocity;
+    shown.quality = governor.level();
+    shown.governed = governor.summary();
+    shown.governed_ms = governor.average_ms();
+    shown.shadow = shadow ? shadow->name() : std::string_view{};
+    shown.compared = shadow ? shadow->summary() : vis::shadow_summary{};
+    status.publish();
+    visiontrip.end();
+    return sample;
+}
+
+/**
+ * @copydoc app::apply_scheduling
+ */
+auto app::apply_scheduling(std::string_view role, cfg::threadcfg const& settings)
+    -> void
+{
+    auto const requested = settings.settings();
+    std::cout << par::describe(role, requested, par::schedule_thread(requested));
+}
+
+/**
+ * @copydoc app::allocate_resident
+ */
+auto app::allocate_resident(std::size_t bytes) -> std::shared_ptr<uint8> {
+    if (not appcfg->pipeline.resident) return nullptr;
+    auto const buffer = std::make_shared<par::resident_buffer>(bytes);
+    if (not buffer->data()) {
+        std::cout << std::format("resident buffer of {} bytes: not mapped\n", bytes);
+        return nullptr;
+    }
+    ++resident.buffers;
+    resident.huge += buffer->huge();
+    resident.locked += buffer->locked();
+    if (not buffer->locked()) {
+        std::cout << std::format("resident buffer of {} bytes: not locked\n", bytes);
+    }
+    // The pointer shares the ownership of the buffer that holds the memory.
+    return {buffer, buffer->data()};
+}
+
+/**
+ * @copydoc app::restart_camera
+ */
+auto app::restart_camera(int rate) -> void {
+    auto camcfg = appcfg->cam;
+    camcfg.frame.rate.set(rate);
+    camera->stop();
+    cam::start_camera(*camera, camcfg);
+    make_shutter();
+}
+
+/**
+ * @copydoc app::make_shutter
+ */
+auto app::make_shutter() -> void {
+    shutter = cam::rolling_shutter{{
+        .rate = static_cast<double>(camera->getFrameRate()),
+        .rows = static_cast<int>(camera->getHeight()),
+        .readout = appcfg->cam.shutter.readout}};
+}
+
+/**
+ * @copydoc app::capture_time
+ */
+auto app::capture_time(double row) const noexcept -> perf::clock::time_point {
+    return appcfg->cam.shutter.enabled ? shutter.row_time(row) : frametime;
+}
+
+/**
+ * @copydoc app::start_probe
+ */
+auto app::start_probe() -> void {
+    if (appmode == appstate::probing) return;
+
+    probe = perf::capacity_probe{
+        appcfg->cam.frame.width, appcfg->cam.frame.height,
+        cam::ps3cam::getFrameRates(camera->getWidth()),
+        appcfg->cam.probe.frames, appcfg->cam.probe.warmup};
+    if (probe.done()) return;
+
+    resumemode = appmode;
+    appmode = appstate::probing;
+    // The capacity is measured at full quality.
+    make_governor();
+    restart_camera(probe.rate());
+}
+
+/**
+ * @copydoc app::update_probe
+ */
+auto app::update_probe(perf::probe_sample const& sample) -> void {
+    if (not probe.record(sample)) return;
+    if (probe.done()) return finish_probe();
+    restart_camera(probe.rate());
+}
+
+/**
+ * @copydoc app::finish_probe
+ */
+auto app::finish_probe() -> void {
+    auto const report = probe.report();
+    std::cout << report;
+    std::ofstream{appcfg->cam.probe.filename} << report;
+
+    appcfg->cam.frame.rate.set(static_cast<int>(probe.best()));
+    appcfg->savexml();
+    restart_camera(appcfg->cam.frame.rate);
+    appmode = resumemode;
+}
+
+/**
+ * @copydoc app::start_lens_calibration
+ */
+auto app::start_lens_calibration() -> void {
+    if (appmode == appstate::probing) return;
+    if (appmode == appstate::lens) {
+        appmode = resumemode;
+        return;
+    }
+    auto const& board = appcfg->cam.lens.board;
+    lenscalibrator = cam::lens_calibrator{board.columns, board.rows, board.views};
+    resumemode = appmode;
+    appmode = appstate::lens;
+}
+
+/**
+ * @copydoc app::update_lens_calibration
+ */
+auto app::update_lens_calibration() -> void {
+    static_cast<void>(lenscalibrator.add(gray_image(), quadframe.empty() ? 1 : 2));
+    if (lenscalibrator.done()) {
+        finish_lens_calibration();
+    }
+}
+
+/**
+ * @copydoc app::finish_lens_calibration
+ */
+auto app::finish_lens_calibration() -> void {
+    auto const fit = lenscalibrator.solve(frame.cols, frame.rows);
+    auto& lens = appcfg->cam.lens;
+    lens.width.set(fit.lens.width);
+    lens.fx.set(fit.lens.fx);
+    lens.fy.set(fit.lens.fy);
+    lens.cx.set(fit.lens.cx);
+    lens.cy.set(fit.lens.cy);
+    lens.k1.set(fit.lens.distortion[0]);
+    lens.k2.set(fit.lens.distortion[1]);
+    lens.p1.set(fit.lens.distortion[2]);
+    lens.p2.set(fit.lens.distortion[3]);
+    lens.k3.set(fit.lens.distortion[4]);
+    appcfg->savexml();
+    std::cout << std::format("calibrated the lens from {} views with an error of"
+        " {:.3f} px\n", lenscalibrator.views(), fit.error);
+
+    // The servo calibration points were clicked in the previous geometry.
+    make_undistortion();
+    recalibrate();
+}
+
+/**
+ * @copydoc app::make_undistortion
+ */
+auto app::make_undistortion() -> void {
+    auto const& lens = appcfg->cam.lens;
+    if (not lens.undistort) {
+        undistortion = {};
+        return;
+    }
+    undistortion = cam::undistort_map{{
+        .width = lens.width,
+        .fx = lens.fx,
+        .fy = lens.fy,
+        .cx = lens.cx,
+        .cy = lens.cy,
+        .distortion{lens.k1, lens.k2, lens.p1, lens.p2, lens.k3}},
+        frame.cols, frame.rows};
 }
 
 /**
@@ -142,9 +580,10 @@ auto app::updateSetPoint() -> void {
     t = t / moveTimeSec * 1.0;
     setPoint = oldSetPoint * (1.f - cosineInterpolate(0.0, 1.0, t))
         + newSetPoint * cosineInterpolate(0.0, 1.0, t);
+    auto const target = undistortion.apply({setPoint.x, setPoint.y});
     for (int i{}; i < 3; i++) {
-        setPointPerAxis[i] = (setPoint.x - centerPoint.x) * transMatrices[i].x
-            + (setPoint.y - centerPoint.y) * transMatrices[i].y;
+        setPointPerAxis[i] = (target.x - centerPoint.x) * transMatrices[i].x
+            + (target.y - centerPoint.y) * transMatrices[i].y;
     }
 }
 
@@ -159,57 +598,595 @@ auto app::setSetPoint(int x, int y) -> void {
     moveTimeSec = std::sqrt(std::pow(v.x, 2) + std::pow(v.y, 2)) / 120.0f;
 }
 
+/**
+ * @copydoc app::make_plate_mask
+ */
+auto app::make_plate_mask() -> void {
+    auto const& image = quadframe.empty() ? frame : quadframe;
+    if (not appcfg->vision.plate.enabled or pointsCalibrated < 3) {
+        platemask = std::make_shared<vis::plate_mask const>(image.cols, image.rows);
+    } else {
+        auto const scale = quadframe.empty() ? 1 : 2;
+        auto corners = std::array<cv::Point2f, 3>{};
+        for (std::size_t i{}; i < corners.size(); ++i) {
+            auto const& click = calibrationClicks[i];
+            corners[i] = scale == 1 ? cv::Point2f{click.x, click.y} : cv::Point2f{
+                vis::frame_to_quad(click.x), vis::frame_to_quad(click.y)};
+        }
+        auto const margin = static_cast<float>(appcfg->vision.plate.margin) / scale;
+        // The plate is round, so the triangle of the servo points would cut off its rim.
+        auto const rim = vis::circumcircle(corners[0], corners[1], corners[2]);
+        platemask = rim ? std::make_shared<vis::plate_mask const>(image.cols,
+            image.rows, *rim, margin)
+            : std::make_shared<vis::plate_mask const>(image.cols, image.rows);
+    }
+    // Masked passes leave the excluded pixels untouched, so they start out as background.
+    fgmask.setTo(cv::Scalar{0});
+    if (not colormask.empty()) {
+        colormask.setTo(cv::Scalar{0});
+    }
+    background.relearn();
+}
+
 /**
  * @copydoc app::track_ball
  */
-auto app::track_ball() -> void {
-    std::vector<cv::Vec3f> circles;
-    cv::HoughCircles(frame, circles, cv::HOUGH_GRADIENT, 1, 1000, 200, 20,
-        ballradius.min, ballradius.max);
-    if (circles.size() == 0) return;
-    cv::Vec3i c = circles[0];
-    cv::Point center = cv::Point(c[0], c[1]);
-    cv::circle(frame, center, 1, cv::Scalar(0, 100, 100), 3, cv::LINE_AA);
-    int radius = c[2];
-    cv::circle(frame, center, radius, cv::Scalar(255, 0, 255), 3, cv::LINE_AA);
-    if (appmode == appstate::running) {
-        ballPos = {float(center.x), float(center.y)};
+auto app::track_ball() -> control_sample {
+    // The tracks weigh every candidate of the detection, not only the best one.
+    static_cast<void>(detect_ball());
+    balltracks.update(capture_time(0.5 * frame.rows), observations);
+    auto const* const target = balltracks.target();
+    if (target and target->observed) {
+        measure_flow(*target);
+    } else {
+        ballflow.reset();
+        flowvelocity.reset();
+        if (not target or not target->filter.tracking(frametime)) {
+            return {.time = frametime, .tracking = false};
+        }
+    }
+    return {
+        .time = frametime,
+        .tracking = true,
+        .position = target->filter.predict(frametime),
+        .velocity = target->filter.velocity()};
+}
+
+/**
+ * @copydoc app::control_ball
+ */
+auto app::control_ball(control_sample const& sample) -> void {
+    controltrip.begin();
+    updateSetPoint();
+    if (appmode == appstate::calibration and appcfg->serial.enabled) {
+        constexpr auto servopos = std::string_view{"45.0 45.0 45.0 \n"};
+        serial.writeBytes(servopos.data(), servopos.size());
+    } else if (appmode != appstate::calibration and sample.tracking) {
+        // The velocity is undistorted through the position a short time ahead.
+        constexpr auto lookahead = 0.01;
+        auto const& position = sample.position;
+        auto const& velocity = sample.velocity;
+        auto const here = undistortion.apply({float(position.x), float(position.y)});
+        auto const ahead = undistortion.apply({
+            float(position.x + velocity.x * lookahead),
+            float(position.y + velocity.y * lookahead)});
+        ballPos = {here.x, here.y};
+        ballVel = {
+            float((ahead.x - here.x) / lookahead), float((ahead.y - here.y) / lookahead)};
         for (int j{}; j < 3; j++) {
             ballPosPerAxis[j] = (ballPos.x - centerPoint.x) * transMatrices[j].x
                 + (ballPos.y - centerPoint.y) * transMatrices[j].y;
         }
-        control_pid();
+        control_pid(sample.time);
+    }
+    controlled.back() = {ballPos, setPoint, setPointPerAxis};
+    controlled.publish();
+    controltrip.end();
+}
+
+/**
+ * @copydoc app::make_tracks
+ */
+auto app::make_tracks() -> void {
+    balltracks = est::multi_tracker{{
+        .filter{
+            .accelnoise = appcfg->filter.accelnoise,
+            .measnoise = appcfg->filter.measnoise,
+            .maxcoast = appcfg->filter.coast},
+        .gate = appcfg->filter.gate,
+        .confirmations = appcfg->filter.confirm.to<int>(),
+        .maxtracks = appcfg->filter.tracks.to<int>(),
+        .maxobservations = vis::blob_detector::maxcandidates}};
+}
+
+/**
+ * @copydoc app::make_flow
+ */
+auto app::make_flow() -> void {
+    ballflow = vis::patch_flow{ballradius.max, appcfg->vision.flow.margin.to<int>()};
+    flowvelocity.reset();
+}
+
+/**
+ * @copydoc app::measure_flow
+ */
+auto app::measure_flow(est::track const& target) -> void {
+    flowvelocity.reset();
+    auto const segmented = not colormask.empty() and not colortable.empty();
+    if (target.id != flowtarget) {
+        ballflow.reset();
+        flowtarget = target.id;
+    }
+    if (not appcfg->vision.flow.enabled or segmented) {
+        ballflow.reset();
+        return;
+    }
+    auto const ball = vis::blob{float(target.measured.x), float(target.measured.y),
+        float(target.radius)};
+    auto const scale = quadframe.empty() ? 1 : 2;
+    auto const& image = scale == 2 ? quadframe : grayframe.empty() ? frame : grayframe;
+    auto const patch = scale == 1 ? ball : vis::blob{vis::frame_to_quad(ball.x),
+        vis::frame_to_quad(ball.y), ball.radius / scale};
+    auto const measured = ballflow.measure(image.data, static_cast<int>(image.step),
+        image.cols, image.rows, patch, {
+            .margin = std::max(appcfg->vision.flow.margin.to<int>() / scale, 1),
+            .iterations = 10,
+            .epsilon = 0.01f});
+    auto const dt = std::chrono::duration<double>{target.time - flowtime}.count();
+    flowtime = target.time;
+    if (not measured or dt <= 0.0) return;
+
+    // A quad spans two frame pixels along either axis.
+    auto const speed = scale / dt;
+    auto const noise = static_cast<double>(appcfg->vision.flow.noise);
+    auto const variance = noise * noise / (dt * dt);
+    flowvelocity = est::vec2{measured->dx * speed, measured->dy * speed};
+    balltracks.update_velocity(*flowvelocity, {
+        measured->xx * speed * speed + variance,
+        measured->yy * speed * speed + variance});
+}
+
+/**
+ * @copydoc app::gray_image
+ */
+auto app::gray_image() -> cv::Mat const& {
+    if (not quadframe.empty()) {
+        auto const bands = workers->bands(quadframe.cols, quadframe.rows);
+        workers->for_bands(0, quadframe.rows, bands, [&](int, int first, int last) {
+            kernels.gray(frame.data, frame.cols, first, last, quadframe.data);
+        });
+        return quadframe;
+    }
+    if (grayframe.empty()) return frame;
+    kernels.gray(frame.data, frame.cols, 0, grayframe.rows, grayframe.data);
+    return grayframe;
+}
+
+/**
+ * @copydoc app::detect_ball
+ */
+auto app::detect_ball() -> std::optional<vis::blob> {
+    observations.clear();
+    auto const scale = quadframe.empty() ? 1 : 2;
+    searchwindow = platemask->bounds();
+    auto const* const tracked = balltracks.target();
+    if (appcfg->vision.roitracking and tracked and tracked->filter.tracking(frametime)) {
+        auto const exposure = capture_time(0.5 * frame.rows);
+        // A narrowed window trusts the prediction more, at the risk of losing the ball.
+        auto const narrow = governor.degraded(perf::quality::smallroi) ? 2.f : 1.f;
+        // Every confirmed track keeps being observed, so the window spans the predicted
+        // windows of all of them rather than only the one of the target.
+        auto merged = vis::region{};
+        for (auto const& track : balltracks.tracks()) {
+            if ((not track.confirmed and &track != tracked)
+                or not track.filter.tracking(frametime)) continue;
+            auto const position = track.filter.predict(exposure);
+            auto const spread = track.filter.spread(exposure);
+            auto x = static_cast<float>(position.x);
+            auto y = static_cast<float>(position.y);
+            if (scale == 2) {
+                x = vis::frame_to_quad(x);
+                y = vis::frame_to_quad(y);
+            }
+            auto const window = platemask->clip(roitracker.window(x, y,
+                static_cast<float>(spread.x) / (scale * narrow),
+                static_cast<float>(spread.y) / (scale * narrow), ballradius.max / scale));
+            if (window.empty()) continue;
+            if (merged.empty()) {
+                merged = window;
+                continue;
+            }
+            auto const x0 = std::min(merged.x, window.x);
+            auto const y0 = std::min(merged.y, window.y);
+            auto const x1 = std::max(merged.x + merged.width, window.x + window.width);
+            auto const y1 = std::max(merged.y + merged.height, window.y + window.height);
+            merged = {x0, y0, x1 - x0, y1 - y0};
+        }
+        if (not merged.empty()) {
+            searchwindow = merged;
+        }
+    }
+
+    if (not colormask.empty() and not colortable.empty()) {
+        // Color frames are never binned, so the mask matches the frame and the window.
+        auto const window = searchwindow;
+        auto const bands = workers->bands(window.width, window.height);
+        workers->for_bands(window.y, window.y + window.height, bands,
+            [&](int, int first, int last) {
+                for (auto y = first; y < last; ++y) {
+                    auto const columns = platemask->columns(y, window.x,
+                        window.x + window.width);
+                    if (columns.empty()) continue;
+                    colortable.classify(frame.ptr(y) + 3 * columns.first,
+                        columns.last - columns.first, 1,
+                        colormask.ptr(y) + columns.first);
+                }
+            });
+        // The mask holds 0 and 255 like a foreground mask, so it is searched as one.
+        auto const ball = find_ball(colormask, window, 1, true);
+        roitracker.update(ball.has_value());
+        return ball;
+    }
+
+    auto const& image = gray_image();
+    if (recording) {
+        record_frame(image);
+    }
+
+    auto const usebackground = appcfg->vision.background.enabled
+        and not background.learning();
+    auto const settings = vis::background_settings{
+        .rate = appcfg->vision.background.rate,
+        .interval = appcfg->vision.background.interval,
+        .gain = appcfg->vision.background.gain,
+        .minimum = appcfg->vision.background.minimum,
+        .plate = platemask.get()};
+    if (usebackground) {
+        background.segment(image.data, static_cast<int>(image.step), searchwindow,
+            settings, fgmask.data, *workers);
+    }
+
+    auto const& target = usebackground ? fgmask : image;
+    auto ball = governor.degraded(perf::quality::binned)
+        ? search_binned(target, scale, usebackground)
+        : search_ball(target, scale, usebackground);
+    if (shadow) {
+        static_cast<void>(shadow->submit(searchimage, searchregion, searchsettings,
+            detection));
+    }
+    if (appcfg->vision.background.enabled
+        and not governor.degraded(perf::quality::background))
+    {
+        auto region = vis::region{};
+        if (ball) {
+            auto const margin = static_cast<int>(ball->radius * 1.5f) + 2;
+            region = {
+                static_cast<int>(ball->x) - margin, static_cast<int>(ball->y) - margin,
+                2 * margin + 1, 2 * margin + 1};
+        }
+        background.update(image.data, static_cast<int>(image.step), settings, region,
+            *workers);
+    }
+    roitracker.update(ball.has_value());
+    if (not ball or scale == 1) return ball;
+    return vis::blob{vis::quad_to_frame(ball->x), vis::quad_to_frame(ball->y),
+        ball->radius * scale};
+}
+
+/**
+ * @copydoc app::search_ball
+ */
+auto app::search_ball(cv::Mat const& image, int scale, bool foreground)
+    -> std::optional<vis::blob>
+{
+    auto const plate = platemask->bounds();
+    auto const fullframe = searchwindow == plate;
+    auto const coarse_to_fine = appcfg->vision.pyramid
+        or governor.degraded(perf::quality::smallroi);
+    if (not coarse_to_fine or not fullframe) {
+        return find_ball(image, searchwindow, scale, foreground);
+    }
+
+    // Each level averages 2x2 pixels, so a coarse pixel at c covers the image pixels
+    // centered at 4c + 1.5.
+    constexpr auto factor = 4;
+    auto& half = pyramid[0];
+    auto& quarter = pyramid[1];
+    kernels.half(image.data, image.cols, 0, half.rows, half.data);
+    kernels.quarter(half.data, half.cols, 0, quarter.rows, quarter.data);
+    auto const left = plate.x / factor;
+    auto const top = plate.y / factor;
+    auto const right = std::min(
+        (plate.x + plate.width + factor - 1) / factor, quarter.cols);
+    auto const bottom = std::min(
+        (plate.y + plate.height + factor - 1) / factor, quarter.rows);
+    auto const coarse = find_ball(quarter, {left, top, right - left, bottom - top},
+        scale * factor, foreground);
+    if (not coarse) return std::nullopt;
+
+    auto const x = static_cast<int>(coarse->x * factor + 1.5f);
+    auto const y = static_cast<int>(coarse->y * factor + 1.5f);
+    auto const reach = static_cast<int>(coarse->radius * factor) + 2 * factor;
+    auto const x0 = std::clamp(x - reach, 0, image.cols);
+    auto const y0 = std::clamp(y - reach, 0, image.rows);
+    auto const x1 = std::clamp(x + reach + 1, 0, image.cols);
+    auto const y1 = std::clamp(y + reach + 1, 0, image.rows);
+    searchwindow = platemask->clip({x0, y0, x1 - x0, y1 - y0});
+    return find_ball(image, searchwindow, scale, foreground);
+}
+
+/**
+ * @copydoc app::find_ball
+ */
+auto app::find_ball(cv::Mat const& image, vis::region window, int scale, bool foreground)
+    -> std::optional<vis::blob>
+{
+    auto const minradius = std::max(ballradius.min / scale, 1);
+    auto const maxradius = std::max(ballradius.max / scale, minradius + 1);
+    searchimage = image;
+    searchregion = window;
+    searchsettings = {
+        .minradius = minradius,
+        .maxradius = maxradius,
+        // A foreground mask only holds 0 and 255, so any threshold in between works.
+        .threshold = foreground ? 128 : appcfg->vision.threshold.to<int>(),
+        .dark = not foreground and appcfg->vision.darkball,
+        // The steps of a foreground mask are all alike, which suits the adaptive choice.
+        .edgethreshold = foreground ? 0 : appcfg->vision.edgethreshold.to<int>(),
+        // The mask only matches images at the resolution that it was derived for.
+        .plate = scale == (quadframe.empty() ? 1 : 2) ? platemask : nullptr};
+    auto* active = detector.get();
+    if (not colormask.empty() and not colortable.empty()) {
+        active = colordetector.get();
+    } else if (governor.degraded(perf::quality::detector) and cheapdetector) {
+        active = cheapdetector.get();
+    }
+    active->detect(image, window, searchsettings, detection);
+    // Image pixel c covers the frame pixels centered at scale * c + (scale - 1) / 2.
+    auto const offset = (scale - 1) / 2.0;
+    observations.clear();
+    for (auto const& candidate : detection.candidates) {
+        auto const x = candidate.ball.x * scale + offset;
+        auto const y = candidate.ball.y * scale + offset;
+        observations.push_back({{x, y}, double(candidate.ball.radius) * scale,
+            capture_time(y)});
     }
+    return detection.best();
+}
+
+/**
+ * @copydoc app::search_binned
+ */
+auto app::search_binned(cv::Mat const& image, int scale, bool foreground)
+    -> std::optional<vis::blob>
+{
+    auto& half = pyramid[0];
+    auto const x0 = searchwindow.x / 2;
+    auto const y0 = searchwindow.y / 2;
+    auto const x1 = std::min((searchwindow.x + searchwindow.width + 1) / 2, half.cols);
+    auto const y1 = std::min((searchwindow.y + searchwindow.height + 1) / 2, half.rows);
+    if (x1 <= x0 or y1 <= y0) return std::nullopt;
+
+    vis::downsample(image.ptr(2 * y0) + 2 * x0, 2 * (x1 - x0), 2 * (y1 - y0),
+        static_cast<int>(image.step), half.ptr(y0) + x0, static_cast<int>(half.step));
+    auto const ball = find_ball(half, {x0, y0, x1 - x0, y1 - y0}, scale * 2, foreground);
+    if (not ball) return std::nullopt;
+    // A binned pixel relates to the image the way a quad relates to the frame.
+    return vis::blob{vis::quad_to_frame(ball->x), vis::quad_to_frame(ball->y),
+        ball->radius * 2};
+}
+
+/**
+ * @copydoc app::make_detectors
+ */
+auto app::make_detectors() -> void {
+    auto const* active = vis::find_detector(appcfg->vision.method.to<int>());
+    if (not active) {
+        active = vis::find_detector(0);
+    }
+    detector = active->make(frame.cols, frame.rows, *workers);
+
+    cheapdetector.reset();
+    auto const* cheapest = vis::find_detector(appcfg->vision.governor.method.to<int>());
+    if (cheapest and cheapest != active) {
+        cheapdetector = cheapest->make(frame.cols, frame.rows, *workers);
+    }
+
+    shadow.reset();
+    auto const* candidate = vis::find_detector(appcfg->vision.shadow.method.to<int>());
+    if (not candidate) return;
+    shadow = std::make_unique<vis::shadow_detector>(*candidate, frame.cols, frame.rows,
+        appcfg->vision.shadow.tolerance.to<double>(), appcfg->vision.shadow.filename);
+}
+
+/**
+ * @copydoc app::make_governor
+ */
+auto app::make_governor() -> void {
+    if (not appcfg->vision.governor.enabled) {
+        governor = {};
+        return;
+    }
+    governor = perf::quality_governor{{
+        .budget = appcfg->vision.governor.budget,
+        .headroom = appcfg->vision.governor.headroom,
+        .patience = appcfg->vision.governor.patience,
+        .recovery = appcfg->vision.governor.recovery},
+        appcfg->vision.governor.filename};
+}
+
+/**
+ * @copydoc app::govern_quality
+ */
+auto app::govern_quality() -> void {
+    auto const narrowed = governor.degraded(perf::quality::smallroi);
+    auto const period_ms = 1'000.0 / std::max(appcfg->cam.frame.rate.to<int>(), 1);
+    if (not governor.update(perf::elapsed_ms(visiontime), period_ms)) return;
+
+    // Formats straight into the stream, which leaves the heap alone.
+    std::format_to(std::ostreambuf_iterator<char>{std::cout},
+        "vision quality: {} at {:.2f} of {:.2f} ms\n",
+        perf::to_string(governor.level()), governor.average_ms(), period_ms);
+    if (narrowed and not governor.degraded(perf::quality::smallroi)) {
+        roitracker.reset();
+    }
+}
+
+/**
+ * @copydoc app::toggle_recording
+ */
+auto app::toggle_recording() -> void {
+    if (recording) return save_recording();
+    if (saving.load(std::memory_order_acquire)) {
+        std::cout << "still saving the previous recording\n";
+        return;
+    }
+    // The searched image is the quad frame, the grayscale frame or the gray frame.
+    auto const& image = not quadframe.empty() ? quadframe
+        : not grayframe.empty() ? grayframe : frame;
+    recorded.resize(std::max(appcfg->vision.record.frames.to<int>(), 1));
+    for (auto& buffer : recorded) {
+        buffer.create(image.rows, image.cols, image.type());
+    }
+    recordedframes = 0;
+    recording = true;
+}
+
+/**
+ * @copydoc app::record_frame
+ */
+auto app::record_frame(cv::Mat const& image) -> void {
+    image.copyTo(recorded[recordedframes++]);
+    if (recordedframes >= std::ssize(recorded)) {
+        save_recording();
+    }
+}
+
+/**
+ * @copydoc app::save_recording
+ */
+auto app::save_recording() -> void {
+    recording = false;
+    // Starting the writer allocates once on the thread that stops the recording.
+    visiontrip.rearm();
+    recorded.resize(recordedframes);
+    saving.store(true, std::memory_order_release);
+    // The previous writer has finished, since no recording starts while it saves.
+    recordwriter = std::jthread{[this, frames = std::move(recorded),
+        directory = std::filesystem::path{appcfg->vision.record.directory},
+        scheduling = appcfg->pipeline.recorder] {
+        apply_scheduling("recorder", scheduling);
+        auto error = std::error_code{};
+        std::filesystem::create_directories(directory, error);
+        // Every frame is compressed on its own, so the frames are spread over a pool of
+        // the writer that shares its scheduling and leaves the vision workers alone.
+        auto compressors = par::worker_pool{0, scheduling.settings()};
+        auto saved = std::atomic<std::size_t>{};
+        compressors.run(static_cast<int>(frames.size()), [&](int i) {
+            auto const filename = directory / std::format("frame-{:05}.png", i);
+            // Tasks of the pool are required not to throw, so a failed frame is skipped.
+            try {
+                if (cv::imwrite(filename.string(), frames[i])) {
+                    saved.fetch_add(1, std::memory_order_relaxed);
+                }
+            } catch (cv::Exception const&) {}
+        });
+        std::cout << std::format("saved {} of {} frames to {}\n", saved.load(),
+            frames.size(), directory.string());
+        saving.store(false, std::memory_order_release);
+    }};
+    recorded = {};
+}
+
+/**
+ * @copydoc app::mark_tracks
+ */
+auto app::mark_tracks() -> void {
+    auto const* const target = balltracks.target();
+    for (auto const& track : balltracks.tracks()) {
+        if (track.confirmed and track.observed and &track != target) {
+            mark_ball({float(track.measured.x), float(track.measured.y),
+                float(track.radius)}, false);
+        }
+    }
+    if (target and target->observed) {
+        mark_ball({float(target->measured.x), float(target->measured.y),
+            float(target->radius)});
+    }
+}
+
+/**
+ * @copydoc app::mark_ball
+ */
+auto app::mark_ball(vis::blob const& ball, bool target) -> void {
+    auto const scale = quadframe.empty() ? 1 : 2;
+    auto& image = display.back();
+    cv::Point center = cv::Point(int(ball.x) / scale, int(ball.y) / scale);
+    // Thick or antialiased circles are drawn as polygons that OpenCV allocates, while
+    // thin and filled ones are rasterized in place, so the outline is drawn thin thrice.
+    cv::circle(image, center, 2, cv::Scalar(0, 100, 100), cv::FILLED, cv::LINE_8);
+    int radius = int(ball.radius) / scale;
+    auto const color = target ? cv::Scalar(255, 0, 255) : cv::Scalar(0, 255, 255);
+    for (auto r = std::max(radius - 1, 0); r <= radius + 1; ++r) {
+        cv::circle(image, center, r, color, 1, cv::LINE_8);
+    }
+}
+
+/**
+ * @copydoc app::sample_color
+ */
+auto app::sample_color(int x, int y) -> void {
+    if (colormask.empty()) return;
+
+    constexpr auto size = 5;
+    auto const region = cv::Rect{x - size / 2, y - size / 2, size, size}
+        & cv::Rect{0, 0, frame.cols, frame.rows};
+    if (region.empty()) return;
+
+    auto const rgb = cv::mean(frame(region));
+    colortable.add(cv::saturate_cast<uint8>(rgb[0]), cv::saturate_cast<uint8>(rgb[1]),
+        cv::saturate_cast<uint8>(rgb[2]), appcfg->vision.colortolerance);
 }
 
 /**
  * @copydoc app::control_pid
  */
-auto app::control_pid() -> void {
-    std::string output;
+auto app::control_pid(perf::clock::time_point time) -> void {
+    auto const frameperiod = 1.0 / std::max(appcfg->cam.frame.rate.to<int>(), 1);
+    auto const elapsed = std::chrono::duration<double>{time - controltime}.count();
+    auto const period = elapsed > 0.25 * frameperiod and elapsed < 4.0 * frameperiod
+        ? elapsed : frameperiod;
+    controltime = time;
+    // The angles lie within [35, 90], so the three of them with their spaces and the
+    // newline take at most 28 characters.
+    auto output = std::array<char, 32>{};
+    auto* end = output.data();
     for (int i{}; i < 3; i++) {
         double error = setPointPerAxis[i] - ballPosPerAxis[i];
+        double velocity = ballVel.x * transMatrices[i].x + ballVel.y * transMatrices[i].y;
+        double dError = (setPointPerAxis[i] - prevSetPointPerAxis[i]) - velocity * period;
         iError[i] += error * pid.ki;
         iError[i] = std::clamp(iError[i], -10.0, 10.0);
-        servoAction[i][servoActI] = pid.kp * error + iError[i]
-            + pid.kd * (error - prevError[i]);
+        servoAction[i][servoActI] = pid.kp * error + iError[i] + pid.kd * dError;
         servoAction[i][servoActI] = std::clamp(servoAction[i][servoActI], -10.0, 45.0);
         double action;
-        if (error - prevError[i] < 1.75) {
+        if (dError < 1.75) {
             action = std::reduce(
                 servoAction[i].begin(), servoAction[i].end()) / servoAction[i].size();
         } else {
             action = servoAction[i][servoActI];
         }
-        prevError[i] = error;
-        output += std::format("{:.5f} ", action + 45.0);
+        prevSetPointPerAxis[i] = setPointPerAxis[i];
+        end = std::to_chars(end, output.data() + output.size(), action + 45.0,
+            std::chars_format::fixed, 5).ptr;
+        *end++ = ' ';
     }
     servoActI++;
     servoActI %= servoAction[0].size();
-    output += "\n";
+    *end++ = '\n';
 
     if (appmode == appstate::running and appcfg->serial.enabled) {
-        serial.writeBytes(output.data(), output.size());
+        serial.writeBytes(output.data(), static_cast<std::size_t>(end - output.data()));
     }
 }
 
@@ -227,7 +1204,12 @@ auto app::draw() -> void {
  * @copydoc app::draw_camera
  */
 auto app::draw_camera(float x, float y) const -> void {
-    ofxCv::drawMat(frame, 0, 0, GL_R8);
+    // The frame itself belongs to the vision stage, which may be processing it.
+    auto const& image = display.front();
+    if (not image.empty()) {
+        ofxCv::drawMat(image, 0, 0, appcfg->cam.frame.width.to<int>(),
+            appcfg->cam.frame.height.to<int>(), image.channels() == 3 ? GL_RGB8 : GL_R8);
+    }
 
     if (appcfg->vision.displaydebug) {
         draw_debug();
@@ -237,6 +1219,14 @@ auto app::draw_camera(float x, float y) const -> void {
         return ofDrawBitmapString(std::format(
             "Please click calibration point {}",
             pointsCalibrated + 1), 190, 200);
+    case appstate::probing:
+        return ofDrawBitmapString(std::format(
+            "Probing pipeline capacity at {} fps",
+            probe.rate()), 190, 200);
+    case appstate::lens:
+        return ofDrawBitmapString(std::format(
+            "Move the checkerboard through the view: {} of {} views",
+            lenscalibrator.views(), appcfg->cam.lens.board.views.to<int>()), 190, 200);
     default:
         return;
     }
@@ -246,9 +1236,44 @@ auto app::draw_camera(float x, float y) const -> void {
  * @copydoc app::draw_fps
  */
 auto app::draw_fps(float x, float y) const -> void {
-    ofDrawBitmapString(std::format(
-        "app fps: {:.2f}\ncam fps: {:.2f}",
-        ofGetFrameRate(), camstats.fps()), x, y);
+    auto const& shown = status.front();
+    auto text = std::format(
+        "app fps: {:.2f}\ncam fps: {:.2f}\nsearch area: {:.1f}%\nplate area: {:.1f}%"
+        "\nreacquisitions: {}\nvision threads: {}\ndetector: {} {:.2f} ms",
+        ofGetFrameRate(), shown.camfps, 100.0 * shown.searcharea,
+        100.0 * shown.platearea, shown.reacquisitions, shown.threads, shown.detector,
+        shown.detect_ms);
+    text += std::format("\ntracks: {}, target: #{}", shown.tracks, shown.target);
+    auto const faults = par::count_page_faults();
+    text += std::format("\npage faults: {} minor, {} major",
+        faults.minor - startfaults.minor, faults.major - startfaults.major);
+    if (appcfg->cam.shutter.enabled) {
+        text += std::format("\nshutter: {:.1f} ms readout, {:.1f} ms latency{}",
+            shown.readout_ms, shown.latency_ms,
+            shown.synchronized ? "" : " (unsynced)");
+    }
+    if (shown.flow) {
+        text += std::format("\nflow: {:.0f}, {:.0f} px/s", shown.flow->x,
+            shown.flow->y);
+    }
+    if (appcfg->vision.governor.enabled) {
+        text += std::format("\nquality: {} ({} down, {} up, {:.2f} ms)",
+            perf::to_string(shown.quality), shown.governed.degrades,
+            shown.governed.restores, shown.governed_ms);
+    }
+    if constexpr (perf::counting_allocations) {
+        text += std::format("\nallocating frames: {} capture, {} vision, {} control",
+            capturetrip.trips(), visiontrip.trips(), controltrip.trips());
+    }
+    if (not shown.shadow.empty()) {
+        auto const& summary = shown.compared;
+        text += std::format("\nshadow: {} {}/{} disagree, {} skipped"
+            "\nshadow p50/p99: {:.2f}/{:.2f} ms vs {:.2f}/{:.2f} ms",
+            shown.shadow, summary.disagreements, summary.compared, summary.skipped,
+            summary.shadow_p50, summary.shadow_p99, summary.active_p50,
+            summary.active_p99);
+    }
+    ofDrawBitmapString(text, x, y);
 }
 
 /**
@@ -263,6 +1288,8 @@ auto app::draw_menu(float x, float y) const -> void {
  * @copydoc app::draw_debug
  */
 auto app::draw_debug() const -> void {
+    // The ball and setpoint belong to the control stage, which may be updating them.
+    auto const& controls = controlled.front();
     for (int i{0}; i < debugLines.size(); i++) {
         ofSetColor(debugLineColors[i]);
         debugLines[i].draw();
@@ -270,15 +1297,13 @@ auto app::draw_debug() const -> void {
     if (appmode == appstate::running) {
         for (int i{0}; i < transMatrices.size(); i++) {
 
-            float result = (ballPos.x - centerPoint.x) * transMatricesPreScale[i].x
-                + (ballPos.y - centerPoint.y) * transMatricesPreScale[i].y;
+            float result = (controls.ball.x - centerPoint.x) * transMatricesPreScale[i].x
+                + (controls.ball.y - centerPoint.y) * transMatricesPreScale[i].y;
 
             ofPoint v = calibrationPoints[i] - centerPoint;
             float mV = std::sqrt(std::pow(v.x, 2) + std::pow(v.y, 2));
             ofPoint resPos = (v / mV) * result;
 
-            ofPolyline resLine;
-            resLine.addVertices({ballPos, resPos + centerPoint});
             ofColor color;
             switch (i) {
             case 0: color = {255,255,0}; break;
@@ -286,46 +1311,36 @@ auto app::draw_debug() const -> void {
             case 2: color = {255,0,255}; break;
             }
             ofSetColor(color);
-            resLine.draw();
+            // Single lines are drawn directly, which spares a polyline per frame.
+            ofDrawLine(controls.ball, resPos + centerPoint);
 
             // Scaled output shown as sliders:
 
-            float scaledRes = (ballPos.x - centerPoint.x) * transMatrices[i].x
-                + (ballPos.y - centerPoint.y) * transMatrices[i].y;
+            float scaledRes = (controls.ball.x - centerPoint.x) * transMatrices[i].x
+                + (controls.ball.y - centerPoint.y) * transMatrices[i].y;
 
             ofPoint displayPos{650.f, 50.f + 30.f * i};
 
-            ofPolyline scale;
-            scale.addVertices({displayPos, displayPos + ofPoint{targetScale * 2.f, 0}});
-            ofPolyline pointer;
-            pointer.addVertices({displayPos + ofPoint{scaledRes + targetScale, -5},
-                displayPos + ofPoint{scaledRes + targetScale, 5}});
-            ofPolyline center;
-            center.addVertices({displayPos + ofPoint{targetScale, -3},
-                displayPos + ofPoint{targetScale, 3}});
-            scale.draw();
-            pointer.draw();
-            center.draw();
+            ofDrawLine(displayPos, displayPos + ofPoint{targetScale * 2.f, 0});
+            ofDrawLine(displayPos + ofPoint{scaledRes + targetScale, -5},
+                displayPos + ofPoint{scaledRes + targetScale, 5});
+            ofDrawLine(displayPos + ofPoint{targetScale, -3},
+                displayPos + ofPoint{targetScale, 3});
 
             std::string str = std::format("{:.2f}", scaledRes);
             ofDrawBitmapString(str, displayPos + ofPoint{targetScale * 2.f + 10, 0});
 
             color.a = 128;
             ofSetColor(color);
-            ofPolyline helper;
-            helper.addVertices({resPos + centerPoint, centerPoint});
-            helper.draw();
+            ofDrawLine(resPos + centerPoint, centerPoint);
 
             ofSetColor({255, 128, 128});
-            ofPolyline setpointer;
-            setpointer.addVertices(
-                {displayPos + ofPoint{setPointPerAxis[i] + targetScale, -5},
-                displayPos + ofPoint{setPointPerAxis[i] + targetScale, 5}});
-            setpointer.draw();
+            ofDrawLine(displayPos + ofPoint{controls.setpoints[i] + targetScale, -5},
+                displayPos + ofPoint{controls.setpoints[i] + targetScale, 5});
         }
     }
     ofSetColor({255, 128, 128});
-    ofDrawCircle(setPoint, 5.f);
+    ofDrawCircle(controls.setpoint, 5.f);
     ofSetColor({255,255,255});
 }
 
@@ -357,6 +1372,7 @@ auto app::finishCalibration() -> void {
 
     debugLines.erase(debugLines.begin(), debugLines.begin() + 3);
     debugLineColors.erase(debugLineColors.begin(), debugLineColors.begin() + 3);
+    make_plate_mask();
 
     float targetSideSize = 250;
     float targetHeight = std::sqrt(std::pow(targetSideSize, 2)
@@ -400,6 +1416,14 @@ auto app::genTransMatrix(int axis) -> void {
  * @copydoc app::keyPressed
  */
 auto app::keyPressed(int key) -> void {
+    // Probing and lens calibration run synchronously, so the pipeline stops first.
+    if (inputmode == inputstate::app and (key == OF_KEY_F5 or key == OF_KEY_F7)) {
+        stop_pipeline();
+    }
+    auto const lock = std::scoped_lock{visionmutex, controlmutex};
+    // Any input may change the configuration, after which the stages reallocate.
+    visiontrip.rearm();
+    controltrip.rearm();
     switch (inputmode) {
     case inputstate::app:   return handle_key_event(key);
     case inputstate::menu:  return handle_menu_event(key);
@@ -411,10 +1435,14 @@ auto app::keyPressed(int key) -> void {
 /**
  * @copydoc app::handle_key_event
  */
-auto app::handle_key_event(int key) noexcept -> void {
+auto app::handle_key_event(int key) -> void {
     switch (key) {
     case OF_KEY_TAB:     return show_menu();
     case OF_KEY_CONTROL: return recalibrate();
+    case OF_KEY_F5:      return start_probe();
+    case OF_KEY_F7:      return start_lens_calibration();
+    case OF_KEY_F9:      return toggle_recording();
+    case OF_KEY_DEL:     return colortable.clear();
     default:             return;
     }
 }
@@ -431,9 +1459,11 @@ auto app::show_menu() noexcept -> void {
  * @copydoc app::recalibrate
  */
 auto app::recalibrate() -> void {
+    background.relearn();
     debugLines.clear();
     debugLineColors.clear();
     pointsCalibrated = 0;
+    make_plate_mask();
     appmode = appstate::calibration;
 }
 
@@ -509,8 +1539,12 @@ auto app::add_input_value(unsigned char key) noexcept -> void {
  * @copydoc app::mousePressed
  */
 auto app::mousePressed(int x, int y, int button) -> void {
+    auto const lock = std::scoped_lock{visionmutex, controlmutex};
+    visiontrip.rearm();
+    controltrip.rearm();
     switch (button) {
     case 0:  return handle_mouse_event(x, y);
+    case 2:  return sample_color(x, y);
     default: return;
     }
 }
@@ -522,6 +1556,8 @@ auto app::handle_mouse_event(int x, int y) -> void {
     switch (appmode) {
     case appstate::running:     return setSetPoint(x, y);
     case appstate::calibration: return calibrate(x ,y);
+    case appstate::probing:     return;
+    case appstate::lens:        return;
     default:                    return;
     }
 }
@@ -530,7 +1566,9 @@ auto app::handle_mouse_event(int x, int y) -> void {
  * @copydoc app::calibrate
  */
 auto app::calibrate(int x, int y) -> void {
-    calibrationPoints[pointsCalibrated] = {float(x), float(y)};
+    auto const point = undistortion.apply({float(x), float(y)});
+    calibrationPoints[pointsCalibrated] = {point.x, point.y};
+    calibrationClicks[pointsCalibrated] = {float(x), float(y)};
     pointsCalibrated++;
     ofPolyline line;
     line.addVertex(ofPoint{640 / 2.f, 480 / 2.f});
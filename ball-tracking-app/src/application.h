@@ -12,11 +12,30 @@
 #ifndef OF_APPLICATION_H
 #define OF_APPLICATION_H
 
+#include "background.h"
+#include "blob.h"
 #include "camera.h"
 #include "config.h"
+#include "detector.h"
+#include "estimate.h"
+#include "flow.h"
+#include "governor.h"
+#include "kernels.h"
+#include "lens.h"
 #include "menu.h"
+#include "plate.h"
+#include "pool.h"
+#include "probe.h"
+#include "queue.h"
+#include "realtime.h"
+#include "shadow.h"
+#include "shutter.h"
+#include "track.h"
+#include "tracks.h"
+#include "tripwire.h"
 #include "types.h"
 #include "utility.h"
+#include "vision.h"
 
 #include <ofMain.h>
 #include <ofBaseApp.h>
@@ -24,10 +43,17 @@
 #include <opencv.hpp>
 
 #include <array>
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
+#include <stop_token>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 /**
  * @namespace of
@@ -87,6 +113,73 @@ public:
     /** @} */
 
 private:
+    /**
+     * @struct captured_frame
+     * @brief Camera frame handed from the capture to the vision stage.
+     */
+    struct captured_frame {
+        uint8* data;                     /**< Pixels of the frame. */
+        perf::clock::time_point time;    /**< Arrival time of the frame. */
+        uint32 pts;                      /**< Presentation timestamp of the frame. */
+        perf::clock::time_point arrival; /**< Arrival time of the last USB packet. */
+    };
+
+    /**
+     * @struct control_sample
+     * @brief State of the target handed from the vision to the control stage.
+     */
+    struct control_sample {
+        perf::clock::time_point time; /**< Arrival time of the frame. */
+        bool tracking;                /**< Whether the target is tracked. */
+        est::vec2 position;           /**< Position predicted for the frame arrival. */
+        est::vec2 velocity;           /**< Velocity in pixels per second. */
+    };
+
+    /**
+     * @struct vision_status
+     * @brief Statistics of the vision stage that the user interface shows.
+     */
+    struct vision_status {
+        float camfps;                    /**< Frame rate of the camera. */
+        double searcharea;               /**< Share of the image searched. */
+        double platearea;                /**< Share of the image on the plate. */
+        std::size_t reacquisitions;      /**< Searches of the full frame. */
+        int threads;                     /**< Number of vision threads. */
+        std::string_view detector;       /**< Name of the active detector. */
+        double detect_ms;                /**< Duration of the last detection. */
+        std::size_t tracks;              /**< Number of tracks. */
+        int target;                      /**< Identifier of the target. */
+        double readout_ms;               /**< Readout time of a frame. */
+        double latency_ms;               /**< Middle row to frame arrival. */
+        bool synchronized;               /**< Whether the camera clock is used. */
+        std::optional<est::vec2> flow;   /**< Velocity measured by flow. */
+        perf::quality quality;           /**< Vision quality level. */
+        perf::governor_summary governed; /**< Quality level transitions. */
+        double governed_ms;              /**< Average vision stage duration. */
+        std::string_view shadow;         /**< Name of the shadow detector. */
+        vis::shadow_summary compared;    /**< Comparison with the shadow. */
+    };
+
+    /**
+     * @struct control_status
+     * @brief State of the control stage that the debug view draws.
+     */
+    struct control_status {
+        ofPoint ball;                   /**< Undistorted ball position. */
+        ofPoint setpoint;               /**< Setpoint position. */
+        std::array<float, 3> setpoints; /**< Setpoint position per servo axis. */
+    };
+
+    /**
+     * @struct residency
+     * @brief Buffers of the camera pipeline that were backed by resident memory.
+     */
+    struct residency {
+        std::size_t buffers{}; /**< Number of resident buffers. */
+        std::size_t huge{};    /**< Buffers on large pages. */
+        std::size_t locked{};  /**< Buffers that are locked. */
+    };
+
     /**
      * @brief Drawing mechanics.
      * @param[in] x Window coordinate along the x-axis.
@@ -115,7 +208,7 @@ private:
      * @param[in] y Mouse position along the y-axis.
      * @{
      */
-    auto handle_key_event(int key) noexcept -> void;
+    auto handle_key_event(int key) -> void;
     auto handle_menu_event(int key) noexcept -> void;
     auto handle_input_event(int key) -> void;
     auto handle_mouse_event(int x, int y) -> void;
@@ -143,19 +236,305 @@ private:
      */
     auto start_serial() -> void;
 
+    /**
+     * @brief Pipeline mechanics.
+     * @details Runs the capture, vision and control stages on threads of their own, so
+     *     the servo motors are controlled at the camera rate however slowly the user
+     *     interface draws. The stages hand frames and control samples over through
+     *     bounded queues. The vision stage only processes the newest captured frame and
+     *     returns the skipped ones to the capture stage right away. The user interface
+     *     reads the published snapshots of the displayed frame and the statistics, and
+     *     only locks a stage to change its state.
+     * @param[in] stop Token whose stop request ends the stage.
+     * @{
+     */
+    auto start_pipeline() -> void;
+    auto stop_pipeline() -> void;
+    auto capture_frames(std::stop_token stop) -> void;
+    auto process_frames(std::stop_token stop) -> void;
+    auto control_frames(std::stop_token stop) -> void;
+    /** @} */
+
+    /**
+     * @brief Applies the configured scheduling to the calling thread.
+     * @details Reports the scheduling that the thread actually got on the console.
+     * @param[in] role Role of the thread in the pipeline.
+     * @param[in] settings Configured scheduling of the thread.
+     */
+    auto apply_scheduling(std::string_view role, cfg::threadcfg const& settings) -> void;
+
+    /**
+     * @brief Allocates a buffer of the camera pipeline in resident memory, if configured.
+     * @details Reports buffers that could not be mapped or locked on the console.
+     * @param[in] bytes Size of the buffer.
+     * @return Resident buffer, or null if the buffer is to be taken from the heap.
+     */
+    [[nodiscard]]
+    auto allocate_resident(std::size_t bytes) -> std::shared_ptr<uint8>;
+
+    /**
+     * @brief Restarts the camera at the given frame rate.
+     * @details Leaves the configured frame rate untouched.
+     * @param[in] rate Frame rate to restart the camera at.
+     */
+    auto restart_camera(int rate) -> void;
+
+    /**
+     * @brief Derives the readout timing of the rows from the running frame rate.
+     */
+    auto make_shutter() -> void;
+
+    /**
+     * @brief Returns the point in time at which a row of the current frame was exposed.
+     * @details With the rolling shutter disabled, every row is taken to be exposed at
+     *     the arrival of the frame.
+     * @param[in] row Row of the full-resolution frame, which may be fractional.
+     */
+    [[nodiscard]]
+    auto capture_time(double row) const noexcept -> perf::clock::time_point;
+
+    /**
+     * @brief Pipeline capacity probe mechanics.
+     * @details Runs the processing pipeline at each supported frame rate, from high to
+     *     low, and selects the highest frame rate that the pipeline can sustain. The
+     *     selected frame rate is saved and the report is written to the console and to
+     *     a file.
+     * @param[in] sample Measurements of the last processed frame.
+     * @{
+     */
+    auto start_probe() -> void;
+    auto update_probe(perf::probe_sample const& sample) -> void;
+    auto finish_probe() -> void;
+    /** @} */
+
+    /**
+     * @brief Lens calibration mechanics.
+     * @details Collects views of a checkerboard that is moved through the camera view
+     *     and calibrates the intrinsics of the lens from them. The intrinsics are saved,
+     *     after which the servo motors are recalibrated in the undistorted geometry.
+     *     Starting a calibration while one is running cancels it.
+     * @{
+     */
+    auto start_lens_calibration() -> void;
+    auto update_lens_calibration() -> void;
+    auto finish_lens_calibration() -> void;
+    /** @} */
+
+    /**
+     * @brief Precomputes the undistortion of the configured lens intrinsics.
+     * @details The map is the identity when undistortion is disabled or the lens is
+     *     uncalibrated.
+     */
+    auto make_undistortion() -> void;
+
+    /**
+     * @brief Derives the plate mask from the calibrated servo positions.
+     * @details The mask covers the circle through the clicked positions, grown by the
+     *     configured margin, at the resolution of the searched image. Before the
+     *     calibration is finished, or with the mask disabled, it covers the whole image.
+     *     The background model is relearned, since it does not model the pixels that the
+     *     previous mask excluded.
+     */
+    auto make_plate_mask() -> void;
+
+    /**
+     * @brief Applies the vision stage to the current camera frame.
+     * @details Publishes the displayed frame and the statistics of the frame.
+     * @return State of the target to control on.
+     */
+    [[nodiscard]]
+    auto process_frame() -> control_sample;
+
     /**
      * @brief Tracks the position of the ball.
-     * @details Applies a computer vision algorithm to the camera feed.
+     * @details Applies a computer vision algorithm to the camera feed and associates
+     *     every detected ball with the tracks, so a second ball or a distractor in view
+     *     does not take over from the controlled target. Every detection is filtered at
+     *     the point in time that its row was exposed, and the control acts on the state
+     *     predicted for the arrival of the frame, which covers the readout and transfer
+     *     latency. When the target is missed, the control keeps acting on its predicted
+     *     position for a limited time.
+     * @return State of the target to control on.
+     */
+    [[nodiscard]]
+    auto track_ball() -> control_sample;
+
+    /**
+     * @brief Controls the servo motors on the state of the target.
+     * @details Holds the servo motors level during the calibration. Otherwise, the
+     *     filtered position and velocity are undistorted before they are projected onto
+     *     the servo axes. Publishes the state that the debug view draws.
+     * @param[in] sample State of the target to control on.
+     */
+    auto control_ball(control_sample const& sample) -> void;
+
+    /**
+     * @brief Constructs the multi-target tracker with the configured parameters.
+     * @details Drops every track, so the target is selected anew.
+     */
+    auto make_tracks() -> void;
+
+    /**
+     * @brief Constructs the optical flow for the configured ball radius and margin.
+     */
+    auto make_flow() -> void;
+
+    /**
+     * @brief Measures the velocity of the target by the optical flow of its patch.
+     * @details Aligns the patch around the target in the previous frame with the
+     *     current frame, and corrects the state of the target with the resulting
+     *     velocity and its variance, grown by the configured noise. A new target starts
+     *     from a new patch. Color segmented frames are left to the position measurements,
+     *     since they are not converted to grayscale.
+     * @param[in] target Controlled target, associated with a detection in the current
+     *     frame.
+     */
+    auto measure_flow(est::track const& target) -> void;
+
+    /**
+     * @brief Converts the current camera frame to a grayscale image.
+     * @details Converts color frames to grayscale and reduces Bayer frames to the
+     *     half-resolution quad frame, with the kernels selected for the frames.
+     * @return Grayscale frame, or the quad frame when the camera delivers Bayer frames.
+     */
+    auto gray_image() -> cv::Mat const&;
+
+    /**
+     * @brief Detects the ball in the current camera frame.
+     * @details Classifies the search window by color when the camera delivers RGB
+     *     frames and color samples are available, and searches the resulting mask for
+     *     circular blobs like a foreground mask. Otherwise, applies the configured
+     *     detection method to the grayscale frame or, when the camera delivers Bayer
+     *     frames, to the half-resolution quad frame. With ROI tracking enabled while
+     *     the target is tracked, only the bounding box of the windows around the
+     *     positions predicted for the target and every other confirmed track is
+     *     searched, so that their observations continue. A new ball outside of that box
+     *     is only found once it enters it or the lock on the target is lost. With the
+     *     background model enabled, only the foreground of the frame is searched. Every
+     *     search is restricted to the plate mask. The quality governor can narrow the
+     *     window, bin the image, freeze the background model and switch to the cheapest
+     *     detector.
+     * @return Position and radius of the ball in full-resolution pixel coordinates, if
+     *     found.
+     */
+    [[nodiscard]]
+    auto detect_ball() -> std::optional<vis::blob>;
+
+    /**
+     * @brief Searches the current search window for the ball.
+     * @details With the pyramid search enabled, a search of the full frame first looks
+     *     for the ball at a quarter of the resolution and then refines the result in a
+     *     small window at the resolution of the image, which bounds the time it takes
+     *     to acquire the ball.
+     * @param[in] image Grayscale frame or foreground mask to search.
+     * @param[in] scale Scale of the full-resolution frame relative to the image.
+     * @param[in] foreground Whether the image is a foreground mask.
+     * @return Position and radius of the ball in image coordinates, if found.
+     */
+    [[nodiscard]]
+    auto search_ball(cv::Mat const& image, int scale, bool foreground)
+        -> std::optional<vis::blob>;
+
+    /**
+     * @brief Applies the configured detector to a region of an image.
+     * @details Searches a color mask with the blob detector instead. Remembers the
+     *     search and its outcome, so the shadow detector can be offered the last search
+     *     of the frame, and every candidate in full-resolution pixel coordinates, so the
+     *     tracks can be associated with them.
+     * @param[in] image Grayscale frame, foreground mask or color mask to search.
+     * @param[in] window Region of the image to search.
+     * @param[in] scale Scale of the full-resolution frame relative to the image.
+     * @param[in] foreground Whether the image is a foreground mask.
+     * @return Position and radius of the ball in image coordinates, if found.
+     */
+    [[nodiscard]]
+    auto find_ball(cv::Mat const& image, vis::region window, int scale, bool foreground)
+        -> std::optional<vis::blob>;
+
+    /**
+     * @brief Searches the current search window of a 2x2 binned copy of an image.
+     * @details Only the search window is binned, into the half-resolution pyramid level.
+     * @param[in] image Grayscale frame or foreground mask to search.
+     * @param[in] scale Scale of the full-resolution frame relative to the image.
+     * @param[in] foreground Whether the image is a foreground mask.
+     * @return Position and radius of the ball in image coordinates, if found.
+     */
+    [[nodiscard]]
+    auto search_binned(cv::Mat const& image, int scale, bool foreground)
+        -> std::optional<vis::blob>;
+
+    /**
+     * @brief Constructs the configured active, shadow and cheapest detectors.
+     * @details An unknown active method falls back to the first registered detector. An
+     *     unknown shadow method disables the shadow detector. The cheapest detector is
+     *     only constructed when it differs from the active one.
+     */
+    auto make_detectors() -> void;
+
+    /**
+     * @brief Restarts the quality governor at full quality, which overwrites its log.
+     * @details Without the governor enabled, the default governor keeps full quality.
+     */
+    auto make_governor() -> void;
+
+    /**
+     * @brief Accounts for the time of the vision stage of the current frame.
+     * @details Reports every change of the quality level on the console. Leaving the
+     *     narrowed tracking window drops the lock on the ball, so it is acquired anew.
+     */
+    auto govern_quality() -> void;
+
+    /**
+     * @brief Frame recorder mechanics.
+     * @details Records the frames that the ball is detected in, so the detection methods
+     *     can be benchmarked on real footage. Frames are copied into buffers that are
+     *     allocated when the recording starts, so recording keeps the frame loop off the
+     *     heap. Once the recording stops or the configured number of frames is reached,
+     *     a writer thread, scheduled as the recorder role of the pipeline, saves them as
+     *     PNG images in the background, compressing them in parallel on a worker pool of
+     *     its own. A new recording
+     *     cannot start before the previous one has been saved.
+     * @param[in] image Frame that the ball is detected in.
+     * @{
+     */
+    auto toggle_recording() -> void;
+    auto record_frame(cv::Mat const& image) -> void;
+    auto save_recording() -> void;
+    /** @} */
+
+    /**
+     * @brief Marks the observed balls in the displayed frame.
+     * @details Only the copy that is published for display is drawn on, so the frame
+     *     keeps the colors that the camera captured.
+     */
+    auto mark_tracks() -> void;
+
+    /**
+     * @brief Marks a detected ball in the displayed frame.
+     * @param[in] ball Position and radius of the ball in full-resolution coordinates.
+     * @param[in] target Whether the ball is the controlled target.
+     */
+    auto mark_ball(vis::blob const& ball, bool target = true) -> void;
+
+    /**
+     * @brief Adds a color sample of the ball around the given frame position.
+     * @details Only applies when the camera delivers RGB frames. Averages a small
+     *     neighborhood to suppress sensor noise.
+     * @param[in] x Frame position along the x-axis.
+     * @param[in] y Frame position along the y-axis.
      */
-    auto track_ball() -> void;
+    auto sample_color(int x, int y) -> void;
 
     /**
      * @brief Controls the PID values.
      * @details Calculates the required angles for the servo controller based on the
-     *     current and historic positions of the ball while taking previously applied
-     *     correction into account.
+     *     estimated position and velocity of the ball while taking previously applied
+     *     correction into account. The derivative term acts on the change of the error
+     *     since the previous control, or over a single frame at the configured frame
+     *     rate when that interval is implausible.
+     * @param[in] time Arrival time of the frame that the state was estimated from.
      */
-    auto control_pid() -> void;
+    auto control_pid(perf::clock::time_point time) -> void;
 
     /**
      * @brief Generates transformation matrices for the given servo axis.
@@ -165,8 +544,8 @@ private:
 
     /**
      * @brief Calibration mechanics.
-     * @details Provides a mapping between the coordinates of the camera feed and the
-     *     axes of the servo motors.
+     * @details Provides a mapping between the undistorted coordinates of the camera feed
+     *     and the axes of the servo motors.
      * @param[in] x Mouse position along the x-axis.
      * @param[in] y Mouse position along the y-axis.
      * @{
@@ -179,7 +558,8 @@ private:
     /**
      * @brief Setpoint mechanics.
      * @details Allows the user to define a new setpoint to which the ball should be
-     *     positioned in real time.
+     *     positioned in real time. The setpoint is undistorted before it is projected
+     *     onto the servo axes.
      * @param[in] x Mouse position along the x-axis.
      * @param[in] y Mouse position along the y-axis.
      * @{
@@ -193,8 +573,10 @@ private:
      * @brief Global state of the application.
      */
     enum class appstate {
-        running,    /**< Running the application. */
-        calibration /**< Calibrating the camera and servo motors. */
+        running,     /**< Running the application. */
+        calibration, /**< Calibrating the camera and servo motors. */
+        probing,     /**< Probing the capacity of the processing pipeline. */
+        lens         /**< Calibrating the intrinsics of the camera lens. */
     };
 
     /**
@@ -215,12 +597,69 @@ private:
     template<std::size_t N>
     using matrix_type = std::array<ofPoint, N>;
 
-    util::access_ptr<cfg::config> appcfg; /**< Application configuration. */
-    ofSerial serial;                      /**< Serial connection. */
-    cam::devptr camera;                   /**< PS3 Eye camera. */
-    cam::frame_info camstats;             /**< Camera statistics. */
-    std::unique_ptr<uint8[]> camframe;    /**< Live camera frame. */
-    cv::Mat frame;                        /**< Transformed camera frame. */
+    util::access_ptr<cfg::config> appcfg;  /**< Application configuration. */
+    ofSerial serial;                       /**< Serial connection. */
+    cam::devptr camera;                    /**< PS3 Eye camera. */
+    cam::frame_info camstats;              /**< Camera statistics. */
+    cv::Mat frame;                         /**< Transformed camera frame. */
+    cv::Mat quadframe;                     /**< Half-resolution frame of Bayer quads. */
+    cv::Mat grayframe;                     /**< Grayscale conversion of a color frame. */
+    cv::Mat colormask;                     /**< Color segmentation of the frame. */
+    vis::color_table colortable;           /**< Color classification of the ball. */
+    vis::roi_tracker roitracker;           /**< Search window prediction. */
+    vis::region searchwindow{};            /**< Last searched region. */
+    vis::background_model background;      /**< Background model of the scene. */
+    cv::Mat fgmask;                        /**< Foreground of the frame. */
+    std::array<cv::Mat, 2> pyramid;        /**< Half and quarter resolution images. */
+    vis::frame_kernels kernels{};          /**< Kernels selected for the frames. */
+    est::multi_tracker balltracks;         /**< Tracks of every ball in view. */
+    perf::clock::time_point frametime;     /**< Arrival time of the current frame. */
+    perf::clock::time_point visiontime;    /**< Start of the vision stage. */
+    perf::clock::time_point controltime;   /**< Arrival time of the last control. */
+    cam::rolling_shutter shutter;          /**< Readout timing of the frame rows. */
+    vis::patch_flow ballflow;              /**< Optical flow of the ball patch. */
+    int flowtarget{};                      /**< Target that the patch belongs to. */
+    perf::clock::time_point flowtime;      /**< Capture time of the patch. */
+    std::optional<est::vec2> flowvelocity; /**< Last velocity measured by flow. */
+    std::vector<cv::Mat> recorded;         /**< Buffers of the recorded frames. */
+    int recordedframes{};                  /**< Number of recorded frames. */
+    bool recording{false};                 /**< Whether frames are being recorded. */
+    std::atomic<bool> saving{};            /**< Whether a recording is being saved. */
+    std::jthread recordwriter;             /**< Saves the last recording. */
+    cam::undistort_map undistortion;       /**< Undistortion of frame positions. */
+    cam::lens_calibrator lenscalibrator;   /**< Views of the lens calibration. */
+
+    std::unique_ptr<par::worker_pool> workers;        /**< Vision threads. */
+    std::shared_ptr<vis::plate_mask const> platemask; /**< Searchable pixels. */
+    std::unique_ptr<vis::detector> detector;          /**< Active ball detector. */
+    std::unique_ptr<vis::shadow_detector> shadow;     /**< Detector under comparison. */
+    std::unique_ptr<vis::detector> cheapdetector;     /**< Detector of low quality. */
+    std::unique_ptr<vis::detector> colordetector;     /**< Detector of the color mask. */
+    perf::quality_governor governor;                  /**< Vision quality level. */
+    vis::detection detection;                         /**< Last detection. */
+    std::vector<est::observation> observations;       /**< Balls in the frame. */
+    cv::Mat searchimage;                              /**< Last searched image. */
+    vis::region searchregion{};                       /**< Region of the last search. */
+    vis::detect_settings searchsettings{};            /**< Last search settings. */
+
+    std::shared_ptr<uint8> framememory;               /**< Memory of the frames. */
+    std::array<uint8*, 3> frames{};                   /**< Camera frames in flight. */
+    residency resident;                               /**< Resident buffers. */
+    par::page_faults startfaults;                     /**< Page faults before running. */
+    par::spsc_queue<uint8*, 4> freeframes;            /**< Frames to capture into. */
+    par::spsc_queue<captured_frame, 4> fullframes;    /**< Frames to process. */
+    par::spsc_queue<control_sample, 4> samples;       /**< States to control on. */
+    par::snapshot<cv::Mat> display;                   /**< Frame to draw. */
+    par::snapshot<vision_status> status;              /**< Statistics to show. */
+    par::snapshot<control_status> controlled;         /**< Control state to draw. */
+    std::mutex visionmutex;                           /**< Guards the vision stage. */
+    std::mutex controlmutex;                          /**< Guards the control stage. */
+    std::jthread capturethread;                       /**< Capture stage. */
+    std::jthread visionthread;                        /**< Vision stage. */
+    std::jthread controlthread;                       /**< Control stage. */
+    perf::allocation_tripwire capturetrip{"capture"}; /**< Allocations of capture. */
+    perf::allocation_tripwire visiontrip{"vision"};   /**< Allocations of vision. */
+    perf::allocation_tripwire controltrip{"control"}; /**< Allocations of control. */
 
     ui::menu<cfg::cfgitem, std::function<void()>> cfgmenu; /**< Configuration menu. */
     inputstate inputmode{inputstate::app}; /**< User input mode. */
@@ -240,9 +679,12 @@ private:
     } ballradius; /**< Ball radius values. */
 
     appstate appmode = appstate::calibration; /**< Global application state. */
+    appstate resumemode{};                    /**< Application state to resume. */
+    perf::capacity_probe probe;               /**< Pipeline capacity probe. */
     int pointsCalibrated{0};                  /**< Calibrated points counter. */
 
     matrix_type<3> calibrationPoints;     /**< Servo positions. */
+    matrix_type<3> calibrationClicks;     /**< Clicked servo positions in the frame. */
     matrix_type<3> transMatricesPreScale; /**< Transformation matrices pre-scaling. */
     matrix_type<3> transMatrices;         /**< Transformation matrices post-scaling. */
 
@@ -251,6 +693,7 @@ private:
     ofPoint centerPoint;  /**< Center of the calibration points. */
 
     ofPoint ballPos;         /**< Ball position. */
+    ofPoint ballVel;         /**< Ball velocity in pixels per second. */
     ofPoint setPoint;        /**< Setpoint position. */
     ofPoint oldSetPoint;     /**< Previous setpoint position. */
     ofPoint newSetPoint;     /**< Future setpoint position. */
@@ -263,7 +706,7 @@ private:
     std::vector<ofPolyline> debugLines;   /**< Debug visualization lines. */
     std::vector<ofColor> debugLineColors; /**< Debug visualization line colors. */
 
-    std::array<double, 3> prevError{0.0}; /**< Previous ball position error. */
+    std::array<float, 3> prevSetPointPerAxis{0.f}; /**< Previous setpoint position. */
     std::array<double, 3> iError{0.0};    /**< Current ball position error. */
     std::array<std::array<double, 5>, 3> servoAction{0.0}; /**< Servo angles. */
     int servoActI{0}; /**< Servo action index for the moving average filter. */
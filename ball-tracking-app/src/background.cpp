@@ -0,0 +1,253 @@
+/**
+ * @file       background.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the running background model.
+ */
+
+#include "background.h"
+
+#include "simd.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+namespace {
+
+/**
+ * @brief Number of fractional bits of the fixed-point model.
+ */
+constexpr auto fraction = 7;
+
+/**
+ * @brief Number of additional bits that the region of the ball adapts slower by.
+ */
+constexpr auto slowdown = 3;
+
+/**
+ * @brief Returns the threshold of the absolute difference beyond which a pixel is
+ *     foreground, given its deviation.
+ */
+constexpr auto threshold(int deviation, int gain, int minimum) noexcept -> int {
+    constexpr auto max = int{std::numeric_limits<int16>::max()};
+    return std::min(deviation * gain + (minimum << fraction), max);
+}
+
+#ifdef SIMD_SSE2
+/**
+ * @brief Returns a mask of the 8 lanes whose absolute difference exceeds the threshold.
+ */
+inline auto foreground(__m128i absdiff, __m128i deviation, int gain, int minimum) noexcept
+    -> __m128i
+{
+    auto const limit = _mm_set1_epi16(static_cast<int16>(
+        gain > 0 ? std::numeric_limits<int16>::max() / gain : 0));
+    auto const scaled = _mm_mullo_epi16(_mm_min_epi16(deviation, limit),
+        _mm_set1_epi16(static_cast<int16>(gain)));
+    auto const offset = _mm_set1_epi16(static_cast<int16>(
+        std::min(minimum << fraction, int{std::numeric_limits<int16>::max()})));
+    return _mm_cmpgt_epi16(absdiff, _mm_adds_epi16(scaled, offset));
+}
+
+/**
+ * @brief Widens 8 pixels to fixed point.
+ */
+inline auto widen(__m128i pixels) noexcept -> __m128i
+{ return _mm_slli_epi16(pixels, fraction); }
+
+/**
+ * @brief Returns the absolute values of 8 signed 16-bit lanes.
+ */
+inline auto absolute(__m128i value) noexcept -> __m128i
+{ return _mm_max_epi16(value, _mm_sub_epi16(_mm_setzero_si128(), value)); }
+#endif
+
+} // namespace
+
+/**
+ * @copydoc background_model::background_model
+ */
+background_model::background_model(int width, int height):
+    width_{width},
+    height_{height},
+    mean_(static_cast<std::size_t>(width) * height),
+    deviation_(static_cast<std::size_t>(width) * height)
+{}
+
+/**
+ * @copydoc background_model::segment
+ */
+auto background_model::segment(uint8 const* image, int stride, region roi,
+    background_settings const& settings, uint8* mask, par::worker_pool& pool) const
+    noexcept -> void
+{
+    auto const bands = pool.bands(roi.width, roi.height);
+    pool.for_bands(roi.y, roi.y + roi.height, bands, [&](int, int first, int last) {
+        for (auto y = first; y < last; ++y) {
+            auto* dest = mask + y * width_;
+            if (learning()) {
+                std::fill_n(dest + roi.x, roi.width, uint8{});
+                continue;
+            }
+            auto const columns = settings.plate
+                ? settings.plate->columns(y, roi.x, roi.x + roi.width)
+                : row_span{roi.x, roi.x + roi.width};
+            if (columns.empty()) {
+                std::fill_n(dest + roi.x, roi.width, uint8{});
+                continue;
+            }
+            std::fill(dest + roi.x, dest + columns.first, uint8{});
+            std::fill(dest + columns.last, dest + roi.x + roi.width, uint8{});
+            auto const* pixels = image + y * stride;
+            auto const* mean = mean_.data() + y * width_;
+            auto const* deviation = deviation_.data() + y * width_;
+            auto x = columns.first;
+#ifdef SIMD_SSE2
+            auto const zero = _mm_setzero_si128();
+            for (; x + 16 <= columns.last; x += 16) {
+                auto const p = _mm_loadu_si128(
+                    reinterpret_cast<__m128i const*>(pixels + x));
+                auto const* m = reinterpret_cast<__m128i const*>(mean + x);
+                auto const* d = reinterpret_cast<__m128i const*>(deviation + x);
+                auto const lo = _mm_sub_epi16(widen(_mm_unpacklo_epi8(p, zero)),
+                    _mm_loadu_si128(m));
+                auto const hi = _mm_sub_epi16(widen(_mm_unpackhi_epi8(p, zero)),
+                    _mm_loadu_si128(m + 1));
+                auto const fglo = foreground(absolute(lo), _mm_loadu_si128(d),
+                    settings.gain, settings.minimum);
+                auto const fghi = foreground(absolute(hi), _mm_loadu_si128(d + 1),
+                    settings.gain, settings.minimum);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x),
+                    _mm_packs_epi16(fglo, fghi));
+            }
+#endif
+            for (; x < columns.last; ++x) {
+                auto const absdiff = std::abs((pixels[x] << fraction) - mean[x]);
+                auto const limit = threshold(deviation[x], settings.gain,
+                    settings.minimum);
+                dest[x] = absdiff > limit ? 255 : 0;
+            }
+        }
+    });
+}
+
+/**
+ * @copydoc background_model::update
+ */
+auto background_model::update(uint8 const* image, int stride,
+    background_settings const& settings, region ball, par::worker_pool& pool) noexcept
+    -> void
+{
+    if (learning_ == learnframes) {
+        // Starts from the current frame with a small deviation, which the following
+        // frames adapt to the actual sensor noise.
+        auto const bands = pool.bands(width_, height_);
+        pool.for_bands(0, height_, bands, [&](int, int first, int last) {
+            for (auto y = first; y < last; ++y) {
+                auto const* pixels = image + y * stride;
+                for (int x{}; x < width_; ++x) {
+                    mean_[y * width_ + x] = static_cast<int16>(pixels[x] << fraction);
+                    deviation_[y * width_ + x] = int16{2 << fraction};
+                }
+            }
+        });
+        --learning_;
+        return;
+    }
+    if (learning_ > 0) {
+        auto const bands = pool.bands(width_, height_);
+        pool.for_bands(0, height_, bands, [&](int, int first, int last) {
+            for (auto y = first; y < last; ++y) {
+                auto const columns = span(y, settings.plate);
+                if (columns.empty()) continue;
+                update_span(image + y * stride + columns.first,
+                    mean_.data() + y * width_ + columns.first,
+                    deviation_.data() + y * width_ + columns.first,
+                    columns.last - columns.first, 1);
+            }
+        });
+        --learning_;
+        return;
+    }
+
+    auto const interval = std::max(settings.interval, 1);
+    auto const phase = phase_ % interval;
+    auto const rows = (height_ - phase + interval - 1) / interval;
+    auto const bands = pool.bands(width_, rows);
+    pool.for_bands(0, rows, bands, [&](int, int first, int last) {
+        for (auto row = first; row < last; ++row) {
+            auto const y = phase + row * interval;
+            auto const columns = span(y, settings.plate);
+            if (columns.empty()) continue;
+            auto const* pixels = image + y * stride + columns.first;
+            auto* mean = mean_.data() + y * width_ + columns.first;
+            auto* deviation = deviation_.data() + y * width_ + columns.first;
+            auto const count = columns.last - columns.first;
+            if (ball.empty() or y < ball.y or y >= ball.y + ball.height) {
+                update_span(pixels, mean, deviation, count, settings.rate);
+                continue;
+            }
+            auto const x0 = std::clamp(ball.x - columns.first, 0, count);
+            auto const x1 = std::clamp(ball.x + ball.width - columns.first, x0, count);
+            update_span(pixels, mean, deviation, x0, settings.rate);
+            update_span(pixels + x0, mean + x0, deviation + x0, x1 - x0,
+                settings.rate + slowdown);
+            update_span(pixels + x1, mean + x1, deviation + x1, count - x1,
+                settings.rate);
+        }
+    });
+    phase_ = (phase + 1) % interval;
+}
+
+/**
+ * @copydoc background_model::span
+ */
+auto background_model::span(int y, plate_mask const* plate) const noexcept -> row_span
+{ return plate ? plate->columns(y, 0, width_) : row_span{0, width_}; }
+
+/**
+ * @copydoc background_model::update_span
+ */
+auto background_model::update_span(uint8 const* pixels, int16* mean, int16* deviation,
+    int count, int shift) noexcept -> void
+{
+    auto x = 0;
+#ifdef SIMD_SSE2
+    auto const zero = _mm_setzero_si128();
+    auto const rate = _mm_cvtsi32_si128(shift);
+    auto const adapt = [rate](__m128i p, __m128i* m, __m128i* d) {
+        auto const mv = _mm_loadu_si128(m);
+        auto const dv = _mm_loadu_si128(d);
+        auto const diff = _mm_sub_epi16(widen(p), mv);
+        auto const dd = _mm_sub_epi16(absolute(diff), dv);
+        _mm_storeu_si128(m, _mm_add_epi16(mv, _mm_sra_epi16(diff, rate)));
+        _mm_storeu_si128(d, _mm_add_epi16(dv, _mm_sra_epi16(dd, rate)));
+    };
+    for (; x + 16 <= count; x += 16) {
+        auto const p = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + x));
+        auto* m = reinterpret_cast<__m128i*>(mean + x);
+        auto* d = reinterpret_cast<__m128i*>(deviation + x);
+        adapt(_mm_unpacklo_epi8(p, zero), m, d);
+        adapt(_mm_unpackhi_epi8(p, zero), m + 1, d + 1);
+    }
+#endif
+    for (; x < count; ++x) {
+        auto const diff = (pixels[x] << fraction) - mean[x];
+        mean[x] = static_cast<int16>(mean[x] + (diff >> shift));
+        deviation[x] = static_cast<int16>(
+            deviation[x] + ((std::abs(diff) - deviation[x]) >> shift));
+    }
+}
+
+} // namespace vis
@@ -0,0 +1,136 @@
+/**
+ * @file       background.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Running background model of the static scene.
+ */
+
+#ifndef VIS_BACKGROUND_H
+#define VIS_BACKGROUND_H
+
+#include "blob.h"
+#include "plate.h"
+#include "pool.h"
+#include "types.h"
+
+#include <vector>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @struct background_settings
+ * @brief Parameters of the background model.
+ */
+struct background_settings {
+    int rate;                  /**< Adaption rate as a power of two, i.e. 5 is 1/32. */
+    int interval;              /**< Number of frames that an update is spread over. */
+    int gain;                  /**< Deviations a pixel must differ to be foreground. */
+    int minimum;               /**< Minimum intensity difference of the foreground. */
+    plate_mask const* plate{}; /**< Pixels to model, or null to model the whole frame. */
+};
+
+/**
+ * @class background_model
+ * @brief Per-pixel running average and deviation of a grayscale scene.
+ * @details Means and mean absolute deviations are kept in 16-bit fixed point with 7
+ *     fractional bits, which keeps every intermediate within the range of signed 16-bit
+ *     SIMD lanes. Pixels that differ from the mean by more than the configured number of
+ *     deviations are foreground. The model adapts at the configured rate, except around
+ *     the detected ball, which adapts 8 times slower. That keeps a resting ball from
+ *     being absorbed into the model, while a region that the ball left behind quickly
+ *     fades away. Updates are decimated by rows: every frame only updates every
+ *     interval-th row. Rows are independent, so both segmenting and updating are split
+ *     into bands of rows that run in parallel. Pixels outside the plate mask are
+ *     neither segmented nor updated, so the model is relearned when the mask changes.
+ */
+class background_model {
+public:
+    /**
+     * @brief Default constructs an empty model.
+     */
+    background_model() = default;
+
+    /**
+     * @brief Constructs a model for frames of the given size.
+     * @param[in] width Width of the frames.
+     * @param[in] height Height of the frames.
+     */
+    background_model(int width, int height);
+
+    /**
+     * @brief Discards the model, so it is learned anew from the next frames.
+     */
+    auto relearn() noexcept -> void
+    { learning_ = learnframes; }
+
+    /**
+     * @brief Returns whether the model is still being learned.
+     */
+    [[nodiscard]]
+    constexpr auto learning() const noexcept -> bool
+    { return learning_ > 0; }
+
+    /**
+     * @brief Segments a region of a frame into foreground and background.
+     * @param[in] image Grayscale frame.
+     * @param[in] stride Number of bytes between the starts of two consecutive rows.
+     * @param[in] roi Region of the frame to segment.
+     * @param[in] settings Parameters of the model.
+     * @param[out] mask Destination mask of the frame size, set to 255 for foreground and
+     *     to 0 for background pixels within the region. While learning, the whole region
+     *     is background, as are the pixels outside the plate.
+     * @param[in] pool Workers to process the bands of the region on.
+     */
+    auto segment(uint8 const* image, int stride, region roi,
+        background_settings const& settings, uint8* mask, par::worker_pool& pool) const
+        noexcept -> void;
+
+    /**
+     * @brief Updates the model with a frame.
+     * @param[in] image Grayscale frame.
+     * @param[in] stride Number of bytes between the starts of two consecutive rows.
+     * @param[in] settings Parameters of the model.
+     * @param[in] ball Region of the detected ball, which adapts slower, or an empty
+     *     region if there is none.
+     * @param[in] pool Workers to process the bands of the frame on.
+     */
+    auto update(uint8 const* image, int stride, background_settings const& settings,
+        region ball, par::worker_pool& pool) noexcept -> void;
+
+private:
+    /**
+     * @brief Number of frames to learn the model from.
+     */
+    static constexpr auto learnframes = 16;
+
+    /**
+     * @brief Returns the columns of a row that the model covers.
+     */
+    [[nodiscard]]
+    auto span(int y, plate_mask const* plate) const noexcept -> row_span;
+
+    /**
+     * @brief Updates a span of pixels within a single row of the model.
+     */
+    static auto update_span(uint8 const* pixels, int16* mean, int16* deviation, int count,
+        int shift) noexcept -> void;
+
+    int width_{};                   /**< Width of the frames. */
+    int height_{};                  /**< Height of the frames. */
+    int learning_{learnframes};     /**< Number of frames left to learn from. */
+    int phase_{};                   /**< First row to update in the next frame. */
+    std::vector<int16> mean_;       /**< Mean intensity per pixel. */
+    std::vector<int16> deviation_;  /**< Mean absolute deviation per pixel. */
+};
+
+} // namespace vis
+
+#endif
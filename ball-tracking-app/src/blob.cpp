@@ -0,0 +1,386 @@
+/**
+ * @file       blob.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the blob detector.
+ */
+
+#include "blob.h"
+
+#include "plate.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numbers>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @copydoc blob_detector::blob_detector
+ */
+blob_detector::blob_detector(int width, int height):
+    // A ball and some noise never come close to this many runs; anything beyond is a
+    // badly chosen threshold, which is cheaper to reject than to label.
+    capacity_{static_cast<int>(int64{width} * height / 8)}
+{
+    runs_.resize(capacity_);
+    parents_.resize(capacity_);
+    components_.resize(capacity_);
+}
+
+/**
+ * @copydoc blob_detector::detect
+ */
+auto blob_detector::detect(uint8 const* image, int stride, region roi,
+    blob_settings const& settings, par::worker_pool& pool) -> std::optional<blob>
+{
+    candidatecount_ = 0;
+    if (roi.empty() or capacity_ == 0) return std::nullopt;
+
+    auto bands = std::min(pool.bands(roi.width, roi.height), maxbands);
+    threshold_ = settings.threshold > 0
+        ? settings.threshold : otsu(image, stride, roi, settings.plate, bands, pool);
+
+    // Every band gets an equal share of the capacity, so the bands never share runs.
+    auto encoded = std::array<bool, maxbands>{};
+    pool.for_bands(roi.y, roi.y + roi.height, bands, [&](int band, int first, int last) {
+        auto& runs = spans_[band];
+        runs = {
+            static_cast<int>(int64{capacity_} * band / bands),
+            static_cast<int>(int64{capacity_} * (band + 1) / bands)};
+        encoded[band] = encode(image, stride, {roi.x, first, roi.width, last - first},
+            settings.dark, settings.plate, runs);
+        if (encoded[band]) {
+            label(runs);
+        }
+    });
+    if (not std::all_of(encoded.begin(), encoded.begin() + bands, std::identity{})) {
+        // A band can overflow its share while the region as a whole fits, so the region
+        // is encoded at once before it is rejected, which keeps the result independent
+        // of the number of bands.
+        if (bands == 1) return std::nullopt;
+        bands = 1;
+        auto& runs = spans_[0];
+        runs = {0, capacity_};
+        if (not encode(image, stride, roi, settings.dark, settings.plate, runs)) {
+            return std::nullopt;
+        }
+        label(runs);
+    }
+    compact(bands);
+    stitch(bands);
+    select(image, stride, settings);
+    if (candidatecount_ == 0) return std::nullopt;
+    return candidates_[0].ball;
+}
+
+/**
+ * @copydoc blob_detector::otsu
+ */
+auto blob_detector::otsu(uint8 const* image, int stride, region roi,
+    plate_mask const* plate, int bands, par::worker_pool& pool) noexcept -> int
+{
+    pool.for_bands(roi.y, roi.y + roi.height, bands, [&](int band, int first, int last) {
+        auto& histogram = histograms_[band];
+        histogram.fill(0);
+        for (auto y = first; y < last; ++y) {
+            auto const* row = image + y * stride;
+            auto const columns = plate
+                ? plate->columns(y, roi.x, roi.x + roi.width)
+                : row_span{roi.x, roi.x + roi.width};
+            for (auto x = columns.first; x < columns.last; ++x) {
+                ++histogram[row[x]];
+            }
+        }
+    });
+    auto counts = histograms_[0];
+    for (int band{1}; band < bands; ++band) {
+        for (int i{}; i < 256; ++i) {
+            counts[i] += histograms_[band][i];
+        }
+    }
+
+    // The mask leaves an unknown number of pixels, so the total follows from the counts.
+    auto total = 0.0;
+    auto sum = 0.0;
+    for (int i{}; i < 256; ++i) {
+        total += counts[i];
+        sum += i * static_cast<double>(counts[i]);
+    }
+
+    auto best = 0.0;
+    auto threshold = 128;
+    auto background = 0.0;
+    auto backgroundsum = 0.0;
+    for (int i{}; i < 256; ++i) {
+        background += counts[i];
+        if (background == 0.0) continue;
+        auto const foreground = total - background;
+        if (foreground == 0.0) break;
+        backgroundsum += i * static_cast<double>(counts[i]);
+        auto const meanback = backgroundsum / background;
+        auto const meanfore = (sum - backgroundsum) / foreground;
+        auto const variance = background * foreground
+            * (meanback - meanfore) * (meanback - meanfore);
+        if (variance > best) {
+            best = variance;
+            threshold = i + 1;
+        }
+    }
+    return threshold;
+}
+
+/**
+ * @copydoc blob_detector::encode
+ */
+auto blob_detector::encode(uint8 const* image, int stride, region band, bool dark,
+    plate_mask const* plate, span& runs) noexcept -> bool
+{
+    auto const limit = runs.last;
+    runs.last = runs.first;
+    auto const t = static_cast<uint8>(std::clamp(threshold_, 0, 255));
+
+    for (auto y = band.y; y < band.y + band.height; ++y) {
+        auto const* row = image + y * stride;
+        auto const columns = plate
+            ? plate->columns(y, band.x, band.x + band.width)
+            : row_span{band.x, band.x + band.width};
+        auto const end = std::max(columns.last, columns.first);
+        auto start = -1;
+
+        auto const close = [&](int x) {
+            if (start < 0) return true;
+            if (runs.last == limit) return false;
+            runs_[runs.last++] = {y, start, x};
+            start = -1;
+            return true;
+        };
+
+        auto x = columns.first;
+#ifdef SIMD_SSE2
+        auto const threshold = _mm_set1_epi8(static_cast<char>(t));
+        for (; x + 16 <= end; x += 16) {
+            auto const pixels = _mm_loadu_si128(
+                reinterpret_cast<__m128i const*>(row + x));
+            // The threshold is the first bright level, so dark pixels lie strictly below.
+            auto const bright = _mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_max_epu8(pixels, threshold), pixels));
+            auto const bits = dark ? ~bright & 0xffff : bright;
+            if (bits == 0 and start < 0) continue;
+            if (bits == 0xffff and start >= 0) continue;
+            for (int i{}; i < 16; ++i) {
+                if (bits & (1 << i)) {
+                    if (start < 0) start = x + i;
+                } else if (not close(x + i)) {
+                    return false;
+                }
+            }
+        }
+#endif
+        for (; x < end; ++x) {
+            auto const foreground = dark ? row[x] < t : row[x] >= t;
+            if (foreground) {
+                if (start < 0) start = x;
+            } else if (not close(x)) {
+                return false;
+            }
+        }
+        if (not close(end)) return false;
+    }
+    return true;
+}
+
+/**
+ * @copydoc blob_detector::compact
+ */
+auto blob_detector::compact(int bands) noexcept -> void {
+    count_ = 0;
+    for (int band{}; band < bands; ++band) {
+        auto& runs = spans_[band];
+        // Shifting a band shifts all of its labels equally, which keeps every root the
+        // lowest label of its component.
+        auto const shift = runs.first - count_;
+        if (shift > 0) {
+            for (auto i = runs.first; i < runs.last; ++i) {
+                runs_[i - shift] = runs_[i];
+                parents_[i - shift] = parents_[i] - shift;
+            }
+        }
+        runs = {runs.first - shift, runs.last - shift};
+        count_ = runs.last;
+    }
+}
+
+/**
+ * @copydoc blob_detector::find
+ */
+auto blob_detector::find(int label) noexcept -> int {
+    auto root = label;
+    while (parents_[root] != root) {
+        root = parents_[root];
+    }
+    while (parents_[label] != root) {
+        auto const next = parents_[label];
+        parents_[label] = root;
+        label = next;
+    }
+    return root;
+}
+
+/**
+ * @copydoc blob_detector::merge
+ */
+auto blob_detector::merge(int a, int b) noexcept -> void {
+    auto const ra = find(a);
+    auto const rb = find(b);
+    if (ra == rb) return;
+    // The lowest label always becomes the root, which keeps labeling deterministic.
+    parents_[std::max(ra, rb)] = std::min(ra, rb);
+}
+
+/**
+ * @copydoc blob_detector::connect
+ */
+auto blob_detector::connect(span above, span below) noexcept -> void {
+    auto p = above.first;
+    for (auto c = below.first; c < below.last; ++c) {
+        // Runs touch when they overlap, including diagonally (8-connectivity).
+        while (p < above.last and runs_[p].x1 < runs_[c].x0) {
+            ++p;
+        }
+        for (auto q = p; q < above.last and runs_[q].x0 <= runs_[c].x1; ++q) {
+            merge(c, q);
+        }
+    }
+}
+
+/**
+ * @copydoc blob_detector::label
+ */
+auto blob_detector::label(span runs) noexcept -> void {
+    for (auto i = runs.first; i < runs.last; ++i) {
+        parents_[i] = i;
+    }
+
+    auto above = span{runs.first, runs.first};
+    while (above.last < runs.last) {
+        auto const y = runs_[above.last].y;
+        auto below = span{above.last, above.last};
+        while (below.last < runs.last and runs_[below.last].y == y) {
+            ++below.last;
+        }
+        if (above.last > above.first and runs_[above.first].y == y - 1) {
+            connect(above, below);
+        }
+        above = below;
+    }
+}
+
+/**
+ * @copydoc blob_detector::stitch
+ */
+auto blob_detector::stitch(int bands) noexcept -> void {
+    // Only the last row of a band can touch the first row of the next one.
+    auto above = span{};
+    for (int band{}; band < bands; ++band) {
+        auto const runs = spans_[band];
+        if (runs.first == runs.last) continue;
+        auto const y = runs_[runs.first].y;
+        if (above.last > above.first and runs_[above.first].y == y - 1) {
+            auto below = span{runs.first, runs.first};
+            while (below.last < runs.last and runs_[below.last].y == y) {
+                ++below.last;
+            }
+            connect(above, below);
+        }
+        above = {runs.last, runs.last};
+        while (above.first > runs.first
+            and runs_[above.first - 1].y == runs_[runs.last - 1].y) {
+            --above.first;
+        }
+    }
+}
+
+/**
+ * @copydoc blob_detector::select
+ */
+auto blob_detector::select(uint8 const* image, int stride,
+    blob_settings const& settings) noexcept -> void
+{
+    for (int i{}; i < count_; ++i) {
+        if (find(i) != i) continue;
+        auto const& r = runs_[i];
+        components_[i] = {0, 0.0, 0.0, 0.0, r.x0, r.y, r.x1 - 1, r.y};
+    }
+
+    for (int i{}; i < count_; ++i) {
+        auto const& r = runs_[i];
+        auto& c = components_[parents_[i]];
+        auto const* row = image + r.y * stride;
+        auto weight = int64{};
+        auto sumx = int64{};
+        for (auto x = r.x0; x < r.x1; ++x) {
+            // Pixels further beyond the threshold are more likely part of the ball.
+            auto const w = (settings.dark
+                ? threshold_ - row[x] : row[x] - threshold_) + 1;
+            weight += w;
+            sumx += w * x;
+        }
+        c.area += r.x1 - r.x0;
+        c.weight += static_cast<double>(weight);
+        c.sumx += static_cast<double>(sumx);
+        c.sumy += static_cast<double>(weight) * r.y;
+        c.left = std::min(c.left, r.x0);
+        c.right = std::max(c.right, r.x1 - 1);
+        c.bottom = std::max(c.bottom, r.y);
+    }
+
+    constexpr auto circlefill = std::numbers::pi / 4.0;
+    constexpr auto minscore = 0.5;
+    auto const minarea = std::numbers::pi * settings.minradius * settings.minradius;
+    auto const maxarea = std::numbers::pi * settings.maxradius * settings.maxradius;
+
+    for (int i{}; i < count_; ++i) {
+        if (parents_[i] != i) continue;
+        auto const& c = components_[i];
+        if (c.area < minarea or c.area > maxarea or c.weight <= 0.0) continue;
+
+        auto const width = c.right - c.left + 1;
+        auto const height = c.bottom - c.top + 1;
+        auto const aspect = static_cast<double>(std::min(width, height))
+            / std::max(width, height);
+        auto const fill = static_cast<double>(c.area) / (width * height);
+        auto const score = aspect * (1.0 - std::abs(fill - circlefill) / circlefill);
+        if (score <= minscore) continue;
+
+        // Keeps the candidates sorted, where earlier components win ties.
+        auto const confidence = static_cast<float>(score);
+        auto slot = std::min(candidatecount_, maxcandidates);
+        while (slot > 0 and candidates_[slot - 1].confidence < confidence) {
+            if (slot < maxcandidates) {
+                candidates_[slot] = candidates_[slot - 1];
+            }
+            --slot;
+        }
+        if (slot == maxcandidates) continue;
+        candidates_[slot] = {
+            .ball{
+                static_cast<float>(c.sumx / c.weight),
+                static_cast<float>(c.sumy / c.weight),
+                static_cast<float>(std::sqrt(c.area / std::numbers::pi))},
+            .confidence = confidence};
+        candidatecount_ = std::min(candidatecount_ + 1, maxcandidates);
+    }
+}
+
+} // namespace vis
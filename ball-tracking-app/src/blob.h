@@ -0,0 +1,249 @@
+/**
+ * @file       blob.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Threshold and run-length based blob detector.
+ */
+
+#ifndef VIS_BLOB_H
+#define VIS_BLOB_H
+
+#include "pool.h"
+#include "types.h"
+#include "vision.h"
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+class plate_mask;
+
+/**
+ * @struct region
+ * @brief Rectangular region of an image.
+ */
+struct region {
+    int x;      /**< Left edge. */
+    int y;      /**< Top edge. */
+    int width;  /**< Width of the region. */
+    int height; /**< Height of the region. */
+
+    /**
+     * @brief Returns whether the region contains no pixels.
+     */
+    [[nodiscard]]
+    constexpr auto empty() const noexcept -> bool
+    { return width <= 0 or height <= 0; }
+
+    /**
+     * @brief Compares two objects for equality.
+     */
+    [[nodiscard]]
+    friend auto operator==(region const&, region const&) -> bool = default;
+};
+
+/**
+ * @struct blob_settings
+ * @brief Parameters of the blob detector.
+ */
+struct blob_settings {
+    int threshold;             /**< First bright level, or 0 to select with Otsu. */
+    bool dark;                 /**< Whether the ball is darker than its surroundings. */
+    int minradius;             /**< Minimum radius of the ball. */
+    int maxradius;             /**< Maximum radius of the ball. */
+    plate_mask const* plate{}; /**< Pixels to consider, or null for the whole region. */
+};
+
+/**
+ * @class blob_detector
+ * @brief Detects the ball as the most circular blob of the expected size.
+ * @details The detector thresholds the image, encodes the foreground of every row as
+ *     runs, merges overlapping runs of adjacent rows into connected components, and
+ *     computes an intensity-weighted centroid per component, which yields sub-pixel
+ *     positions. All buffers are allocated upon construction for the given frame size,
+ *     so detecting never allocates.
+ *
+ *     Large regions are split into horizontal bands that are thresholded, encoded and
+ *     labeled in parallel. The runs of the bands are concatenated in row order and the
+ *     components that cross a band border are merged afterwards. Since the lowest label
+ *     always becomes the root, the result is identical to labeling the region at once,
+ *     regardless of the number of bands. Every band gets an equal share of the runs,
+ *     and a band that overflows its share has the region encoded again as a single
+ *     band with the whole capacity, so only a region that exceeds the capacity as a
+ *     whole is rejected.
+ */
+class blob_detector {
+public:
+    /**
+     * @brief Default constructs a detector without buffers.
+     */
+    blob_detector() = default;
+
+    /**
+     * @brief Constructs a detector for frames up to the given size.
+     * @param[in] width Maximum width of the frames.
+     * @param[in] height Maximum height of the frames.
+     */
+    blob_detector(int width, int height);
+
+    /**
+     * @brief Detects the ball within a region of a grayscale image.
+     * @param[in] image Grayscale image.
+     * @param[in] stride Number of bytes between the starts of two consecutive rows.
+     * @param[in] roi Region of the image to search, required to fit within the image
+     *     and the size given upon construction.
+     * @param[in] settings Parameters of the detector.
+     * @param[in] pool Workers to process the bands of the region on.
+     * @return Position and radius of the ball in image coordinates, if found.
+     */
+    [[nodiscard]]
+    auto detect(uint8 const* image, int stride, region roi, blob_settings const& settings,
+        par::worker_pool& pool) -> std::optional<blob>;
+
+    /**
+     * @brief Returns the threshold that was applied during the last detection.
+     */
+    [[nodiscard]]
+    constexpr auto threshold() const noexcept -> int
+    { return threshold_; }
+
+    /**
+     * @brief Returns the most circular blobs of the last detection, by descending
+     *     circularity. The first one is the detected ball.
+     */
+    [[nodiscard]]
+    auto candidates() const noexcept -> std::span<candidate const>
+    { return {candidates_.data(), static_cast<std::size_t>(candidatecount_)}; }
+
+    /**
+     * @brief Maximum number of candidates that are kept per detection.
+     */
+    static constexpr auto maxcandidates = 8;
+
+private:
+    /**
+     * @brief Maximum number of bands that a region is split into.
+     */
+    static constexpr auto maxbands = 16;
+
+    /**
+     * @struct run
+     * @brief Horizontal run of foreground pixels within a single row.
+     */
+    struct run {
+        int y;  /**< Row of the run. */
+        int x0; /**< First column of the run. */
+        int x1; /**< Column past the last pixel of the run. */
+    };
+
+    /**
+     * @struct component
+     * @brief Accumulated statistics of a connected component.
+     */
+    struct component {
+        int64 area;                   /**< Number of pixels. */
+        double weight;                /**< Sum of the pixel weights. */
+        double sumx;                  /**< Weighted sum of the x-coordinates. */
+        double sumy;                  /**< Weighted sum of the y-coordinates. */
+        int left, top, right, bottom; /**< Inclusive bounding box. */
+    };
+
+    /**
+     * @struct span
+     * @brief Range of runs that belong to a single band.
+     */
+    struct span {
+        int first; /**< First run of the band. */
+        int last;  /**< Run past the last run of the band. */
+    };
+
+    /**
+     * @typedef histogram
+     * @brief Number of pixels per intensity.
+     */
+    using histogram = std::array<uint32, 256>;
+
+    /**
+     * @brief Computes a threshold for the region with Otsu's method.
+     * @return First level of the bright class, so that a bright ball lies at or above
+     *     the threshold and a dark ball strictly below it.
+     */
+    [[nodiscard]]
+    auto otsu(uint8 const* image, int stride, region roi, plate_mask const* plate,
+        int bands, par::worker_pool& pool) noexcept -> int;
+
+    /**
+     * @brief Finds the root label of a run and compresses its path.
+     */
+    [[nodiscard]]
+    auto find(int label) noexcept -> int;
+
+    /**
+     * @brief Merges the components of two runs.
+     */
+    auto merge(int a, int b) noexcept -> void;
+
+    /**
+     * @brief Merges the runs of a row with the overlapping runs of the row above.
+     */
+    auto connect(span above, span below) noexcept -> void;
+
+    /**
+     * @brief Thresholds all rows in a band and encodes their foreground as runs.
+     * @details The runs are stored from the given first run onward, and at most up to the
+     *     capacity of a single band. Pixels outside the plate are background.
+     * @return If the number of runs stayed within capacity, returns true. Otherwise,
+     *     the image is considered too noisy and returns false.
+     */
+    auto encode(uint8 const* image, int stride, region band, bool dark,
+        plate_mask const* plate, span& runs) noexcept -> bool;
+
+    /**
+     * @brief Moves the runs of all bands together in row order.
+     */
+    auto compact(int bands) noexcept -> void;
+
+    /**
+     * @brief Labels the runs of a band by merging the runs that overlap between its
+     *     adjacent rows.
+     */
+    auto label(span runs) noexcept -> void;
+
+    /**
+     * @brief Merges the components that cross the borders between bands.
+     */
+    auto stitch(int bands) noexcept -> void;
+
+    /**
+     * @brief Selects the most circular components of the expected size as candidates.
+     */
+    auto select(uint8 const* image, int stride, blob_settings const& settings) noexcept
+        -> void;
+
+    int threshold_{};                                   /**< Last applied threshold. */
+    int capacity_{};                                    /**< Maximum number of runs. */
+    int count_{};                                       /**< Number of runs. */
+    std::vector<run> runs_;                             /**< Runs of the detection. */
+    std::vector<int> parents_;                          /**< Union-find parent per run. */
+    std::vector<component> components_;                 /**< Statistics per root run. */
+    std::array<span, maxbands> spans_{};                /**< Runs per band. */
+    std::array<histogram, maxbands> histograms_{};      /**< Histogram per band. */
+    std::array<candidate, maxcandidates> candidates_{}; /**< Candidates by circularity. */
+    int candidatecount_{};                              /**< Number of candidates. */
+};
+
+} // namespace vis
+
+#endif
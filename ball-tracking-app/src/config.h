@@ -14,8 +14,10 @@
 
 #include "camera.h"
 #include "concepts.h"
+#include "realtime.h"
 #include "types.h"
 #include "utility.h"
+#include "vision.h"
 
 #include <ofxXmlSettings.h>
 
@@ -223,6 +225,55 @@ struct serialcfg {
     cfgitem baudrate; /**< Baudrate of the serial connection. */
 };
 
+/**
+ * @struct threadcfg
+ * @brief Scheduling related configuration of a thread.
+ */
+struct threadcfg {
+    /**
+     * @brief Compares two objects for equality.
+     */
+    [[nodiscard]]
+    friend auto operator==(threadcfg const&, threadcfg const&) -> bool = default;
+
+    /**
+     * @brief Returns the requested scheduling of the thread.
+     */
+    [[nodiscard]]
+    auto settings() const -> par::thread_settings {
+        return {
+            .policy = static_cast<par::scheduling>(policy.to<int>()),
+            .priority = priority.to<int>(),
+            .affinity = static_cast<uint64>(affinity.to<int>())};
+    }
+
+    cfgitem policy;   /**< Scheduling policy. */
+    cfgitem priority; /**< Priority within the scheduling policy. */
+    cfgitem affinity; /**< Bitmask of the processors to run on, or 0 for any. */
+};
+
+/**
+ * @struct pipelinecfg
+ * @brief Processing pipeline related configuration.
+ */
+struct pipelinecfg {
+    /**
+     * @brief Compares two objects for equality.
+     */
+    [[nodiscard]]
+    friend auto operator==(pipelinecfg const&, pipelinecfg const&) -> bool = default;
+
+    cfgitem threaded;   /**< Runs capture, vision and control on their own threads. */
+    cfgitem lockmemory; /**< Megabytes of memory to keep resident, or 0 to not lock. */
+    cfgitem resident;   /**< Backs the frame and transfer buffers by resident memory. */
+    threadcfg usb;      /**< Scheduling of the USB transfer thread. */
+    threadcfg capture;  /**< Scheduling of the capture stage. */
+    threadcfg vision;   /**< Scheduling of the vision stage and its workers. */
+    threadcfg control;  /**< Scheduling of the control stage, which drives the serial. */
+    threadcfg ui;       /**< Scheduling of the user interface thread. */
+    threadcfg recorder; /**< Scheduling of the thread that saves recordings. */
+};
+
 /**
  * @struct rangecfg
  * @brief Range related configuration.
@@ -238,6 +289,106 @@ struct rangecfg {
     cfgitem max; /**< Maximum range value. */
 };
 
+/**
+ * @struct recordcfg
+ * @brief Frame recorder related configuration.
+ */
+struct recordcfg {
+    /**
+     * @brief Compares two objects for equality.
+     */
+    [[nodiscard]]
+    friend auto operator==(recordcfg const&, recordcfg const&) -> bool = default;
+
+    cfgitem frames;        /**< Maximum number of frames per recording. */
+    std::string directory; /**< Directory to save the recorded frames in. */
+};
+
+/**
+ * @struct shadowcfg
+ * @brief Shadow detector related configuration.
+ */
+struct shadowcfg {
+    /**
+     * @brief Compares two objects for equality.
+     */
+    [[nodiscard]]
+    friend auto operator==(shadowcfg const&, shadowcfg const&) -> bool = default;
+
+    cfgitem method;       /**< Method of the shadow detector, or -1 to disable it. */
+    cfgitem tolerance;    /**< Maximum distance in pixels between agreeing positions. */
+    std::string filename; /**< Path of the comparison log. */
+};
+
+/**
+ * @struct backgroundcfg
+ * @brief Background model related configuration.
+ */
+struct backgroundcfg {
+    /**
+     * @brief Compares two objects for equality.
+     */
+    [[nodiscard]]
+    friend auto operator==(backgroundcfg const&, backgroundcfg const&) -> bool = default;
+
+    cfgitem enabled;  /**< Searches only the foreground of the frame. */
+    cfgitem rate;     /**< Adaption rate as a power of two. */
+    cfgitem interval; /**< Number of frames that an update of the model is spread over. */
+    cfgitem gain;     /**< Number of deviations a foreground pixel must differ. */
+    cfgitem minimum;  /**< Minimum intensity difference of foreground pixels. */
+};
+
+/**
+ * @struct platecfg
+ * @brief Plate mask related configuration.
+ */
+struct platecfg {
+    /**
+     * @brief Compares two objects for equality.
+     */
+    [[nodiscard]]
+    friend auto operator==(platecfg const&, platecfg const&) -> bool = default;
+
+    cfgitem enabled; /**< Searches only the calibrated plate. */
+    cfgitem margin;  /**< Distance in frame pixels that the plate is grown by. */
+};
+
+/**
+ * @struct governorcfg
+ * @brief Quality governor related configuration.
+ */
+struct governorcfg {
+    /**
+     * @brief Compares two objects for equality.
+     */
+    [[nodiscard]]
+    friend auto operator==(governorcfg const&, governorcfg const&) -> bool = default;
+
+    cfgitem enabled;      /**< Degrades the vision quality when the stage runs late. */
+    cfgitem budget;       /**< Share of the frame period that the vision may take. */
+    cfgitem headroom;     /**< Share of the frame period to restore quality below. */
+    cfgitem patience;     /**< Consecutive late frames before degrading. */
+    cfgitem recovery;     /**< Consecutive frames with headroom before restoring. */
+    cfgitem method;       /**< Method of the cheapest detector. */
+    std::string filename; /**< Path of the transition log. */
+};
+
+/**
+ * @struct flowcfg
+ * @brief Optical flow related configuration.
+ */
+struct flowcfg {
+    /**
+     * @brief Compares two objects for equality.
+     */
+    [[nodiscard]]
+    friend auto operator==(flowcfg const&, flowcfg const&) -> bool = default;
+
+    cfgitem enabled; /**< Measures the velocity of the ball by optical flow. */
+    cfgitem margin;  /**< Frame pixels around the ball that take part in the flow. */
+    cfgitem noise;   /**< Standard deviation in frame pixels added to the flow. */
+};
+
 /**
  * @struct visioncfg
  * @brief Computer vision related configuration.
@@ -249,9 +400,42 @@ struct visioncfg {
     [[nodiscard]]
     friend auto operator==(visioncfg const&, visioncfg const&) -> bool = default;
 
-    cfgitem displaydebug; /**< Draws debug visualization lines. */
-    cfgitem trackball;    /**< Enables tracking of the ball. */
-    rangecfg ballradius;  /**< Radius of the ball. */
+    cfgitem displaydebug;     /**< Draws debug visualization lines. */
+    cfgitem trackball;        /**< Enables tracking of the ball. */
+    cfgitem colortolerance;   /**< Chroma tolerance of the color segmentation. */
+    cfgitem method;           /**< Method used to detect the ball. */
+    cfgitem threshold;        /**< Blob threshold, or 0 to select one automatically. */
+    cfgitem edgethreshold;    /**< Edge step, or 0 to select one automatically. */
+    cfgitem darkball;         /**< Whether the ball is darker than the plate. */
+    cfgitem roitracking;      /**< Searches only around the predicted ball position. */
+    cfgitem pyramid;          /**< Acquires the ball at a quarter of the resolution. */
+    cfgitem threads;          /**< Number of vision threads, or 0 for one per core. */
+    rangecfg ballradius;      /**< Radius of the ball. */
+    backgroundcfg background; /**< Background model configuration. */
+    recordcfg record;         /**< Frame recorder configuration. */
+    shadowcfg shadow;         /**< Shadow detector configuration. */
+    platecfg plate;           /**< Plate mask configuration. */
+    governorcfg governor;     /**< Quality governor configuration. */
+    flowcfg flow;             /**< Optical flow configuration. */
+};
+
+/**
+ * @struct filtercfg
+ * @brief Ball state estimation related configuration.
+ */
+struct filtercfg {
+    /**
+     * @brief Compares two objects for equality.
+     */
+    [[nodiscard]]
+    friend auto operator==(filtercfg const&, filtercfg const&) -> bool = default;
+
+    cfgitem accelnoise; /**< Standard deviation of unmodeled ball accelerations. */
+    cfgitem measnoise;  /**< Standard deviation of the detected ball positions. */
+    cfgitem coast;      /**< Seconds to keep predicting the ball without detections. */
+    cfgitem gate;       /**< Standard deviations to associate a detection within. */
+    cfgitem confirm;    /**< Detections before a track can be controlled. */
+    cfgitem tracks;     /**< Maximum number of tracked balls. */
 };
 
 /**
@@ -295,6 +479,79 @@ struct balancecfg {
     cfgitem autowhite; /**< Enables automatic white color balancing. */
 };
 
+/**
+ * @struct probecfg
+ * @brief Pipeline capacity probe related configuration.
+ */
+struct probecfg {
+    /**
+     * @brief Compares two objects for equality.
+     */
+    [[nodiscard]]
+    friend auto operator==(probecfg const&, probecfg const&) -> bool = default;
+
+    cfgitem onstart;      /**< Probes the pipeline capacity upon startup. */
+    cfgitem frames;       /**< Number of frames to measure per frame rate. */
+    cfgitem warmup;       /**< Number of frames to skip after switching frame rates. */
+    std::string filename; /**< Name of the report file. */
+};
+
+/**
+ * @struct boardcfg
+ * @brief Calibration checkerboard related configuration.
+ */
+struct boardcfg {
+    /**
+     * @brief Compares two objects for equality.
+     */
+    [[nodiscard]]
+    friend auto operator==(boardcfg const&, boardcfg const&) -> bool = default;
+
+    cfgitem columns; /**< Number of inner corners along a row of the board. */
+    cfgitem rows;    /**< Number of inner corners along a column of the board. */
+    cfgitem views;   /**< Number of views to calibrate from. */
+};
+
+/**
+ * @struct lenscfg
+ * @brief Lens intrinsics related configuration.
+ */
+struct lenscfg {
+    /**
+     * @brief Compares two objects for equality.
+     */
+    [[nodiscard]]
+    friend auto operator==(lenscfg const&, lenscfg const&) -> bool = default;
+
+    cfgitem undistort; /**< Undistorts the ball and setpoint positions. */
+    cfgitem width;     /**< Frame width at calibration, or 0 if uncalibrated. */
+    cfgitem fx;        /**< Focal length along the x-axis in pixels. */
+    cfgitem fy;        /**< Focal length along the y-axis in pixels. */
+    cfgitem cx;        /**< Principal point along the x-axis. */
+    cfgitem cy;        /**< Principal point along the y-axis. */
+    cfgitem k1;        /**< First radial distortion coefficient. */
+    cfgitem k2;        /**< Second radial distortion coefficient. */
+    cfgitem p1;        /**< First tangential distortion coefficient. */
+    cfgitem p2;        /**< Second tangential distortion coefficient. */
+    cfgitem k3;        /**< Third radial distortion coefficient. */
+    boardcfg board;    /**< Calibration checkerboard configuration. */
+};
+
+/**
+ * @struct shuttercfg
+ * @brief Rolling shutter related configuration.
+ */
+struct shuttercfg {
+    /**
+     * @brief Compares two objects for equality.
+     */
+    [[nodiscard]]
+    friend auto operator==(shuttercfg const&, shuttercfg const&) -> bool = default;
+
+    cfgitem enabled; /**< Timestamps detections at the readout of their row. */
+    cfgitem readout; /**< Share of the frame period in which the rows are read out. */
+};
+
 /**
  * @struct camcfg
  * @brief Camera related configuration.
@@ -308,6 +565,9 @@ struct camcfg {
 
     framecfg frame;     /**< Camera frame configuration. */
     balancecfg balance; /**< Color balance configuration. */
+    probecfg probe;     /**< Capacity probe configuration. */
+    lenscfg lens;       /**< Lens intrinsics configuration. */
+    shuttercfg shutter; /**< Rolling shutter configuration. */
     cfgitem format;     /**< Image color format. */
     cfgitem exposure;   /**< Image exposure. */
     cfgitem sharpness;  /**< Image sharpness. */
@@ -340,6 +600,37 @@ struct config {
                 .enabled{"serial enabled", true},
                 .deviceid{"device id", 0},
                 .baudrate{"baudrate", 115'200}},
+            .pipeline{
+                .threaded{"threaded pipeline", true},
+                .lockmemory{"locked memory", 0},
+                .resident{"resident buffers", false},
+                .usb{
+                    .policy{"usb policy", static_cast<int>(par::scheduling::inherit)},
+                    .priority{"usb priority", 0},
+                    .affinity{"usb affinity", 0}},
+                .capture{
+                    .policy{"capture policy", static_cast<int>(par::scheduling::inherit)},
+                    .priority{"capture priority", 0},
+                    .affinity{"capture affinity", 0}},
+                .vision{
+                    .policy{"vision policy", static_cast<int>(par::scheduling::inherit)},
+                    .priority{"vision priority", 0},
+                    .affinity{"vision affinity", 0}},
+                .control{
+                    .policy{"control policy", static_cast<int>(par::scheduling::inherit)},
+                    .priority{"control priority", 0},
+                    .affinity{"control affinity", 0}},
+                .ui{
+                    .policy{"ui policy", static_cast<int>(par::scheduling::inherit)},
+                    .priority{"ui priority", 0},
+                    .affinity{"ui affinity", 0}},
+                // Saving a recording must not compete with the stages that it inherits
+                // from, so it runs below the normal priority by default.
+                .recorder{
+                    .policy{"recorder policy",
+                        static_cast<int>(par::scheduling::timeshare)},
+                    .priority{"recorder priority", -1},
+                    .affinity{"recorder affinity", 0}}},
             .pid{
                 .kp{"proportional", 0.3},
                 .ki{"integral", 0.001},
@@ -347,9 +638,52 @@ struct config {
             .vision{
                 .displaydebug{"display debug", true},
                 .trackball{"ball tracking", true},
+                .colortolerance{"color tolerance", 24},
+                .method{"detection method", static_cast<int>(vis::method::hough)},
+                .threshold{"blob threshold", 0},
+                .edgethreshold{"edge threshold", 0},
+                .darkball{"dark ball", false},
+                .roitracking{"roi tracking", true},
+                .pyramid{"pyramid search", false},
+                .threads{"vision threads", 0},
                 .ballradius{
                     .min{"min. ball radius", 5},
-                    .max{"max. ball radius", 75}}},
+                    .max{"max. ball radius", 75}},
+                .background{
+                    .enabled{"background model", false},
+                    .rate{"bg. rate", 5},
+                    .interval{"bg. interval", 4},
+                    .gain{"bg. gain", 4},
+                    .minimum{"bg. minimum", 10}},
+                .record{
+                    .frames{"record frames", 600},
+                    .directory{"recordings"}},
+                .shadow{
+                    .method{"shadow method", -1},
+                    .tolerance{"shadow tolerance", 2.0},
+                    .filename{"shadow-log.csv"}},
+                .plate{
+                    .enabled{"plate mask", true},
+                    .margin{"plate margin", 30}},
+                .governor{
+                    .enabled{"quality governor", true},
+                    .budget{"gov. budget", 0.7},
+                    .headroom{"gov. headroom", 0.35},
+                    .patience{"gov. patience", 3},
+                    .recovery{"gov. recovery", 120},
+                    .method{"gov. method", static_cast<int>(vis::method::blob)},
+                    .filename{"governor-log.csv"}},
+                .flow{
+                    .enabled{"optical flow", true},
+                    .margin{"flow margin", 3},
+                    .noise{"flow noise", 0.1}}},
+            .filter{
+                .accelnoise{"accel. noise", 1'000.0},
+                .measnoise{"meas. noise", 1.0},
+                .coast{"coast time", 0.1},
+                .gate{"track gate", 4.0},
+                .confirm{"track confirm", 3},
+                .tracks{"max. tracks", 4}},
             .cam{
                 .frame{
                     .width{"frame width", 640},
@@ -360,6 +694,30 @@ struct config {
                     .green{"green balance", 128_u8},
                     .blue{"blue balance", 128_u8},
                     .autowhite{"auto white bal.", false}},
+                .probe{
+                    .onstart{"probe on start", false},
+                    .frames{"probe frames", 300},
+                    .warmup{"probe warmup", 30},
+                    .filename{"probe-report.txt"}},
+                .lens{
+                    .undistort{"undistortion", true},
+                    .width{"lens width", 0},
+                    .fx{"lens fx", 0.0},
+                    .fy{"lens fy", 0.0},
+                    .cx{"lens cx", 0.0},
+                    .cy{"lens cy", 0.0},
+                    .k1{"lens k1", 0.0},
+                    .k2{"lens k2", 0.0},
+                    .p1{"lens p1", 0.0},
+                    .p2{"lens p2", 0.0},
+                    .k3{"lens k3", 0.0},
+                    .board{
+                        .columns{"board columns", 9},
+                        .rows{"board rows", 6},
+                        .views{"board views", 20}}},
+                .shutter{
+                    .enabled{"rolling shutter", true},
+                    .readout{"readout share", 0.94}},
                 .format{"color format", static_cast<int>(cam::format::Gray)},
                 .exposure{"exposure", 20_u8},
                 .sharpness{"sharpness", 128_u8},
@@ -384,13 +742,67 @@ struct config {
             serial.enabled,
             serial.deviceid,
             serial.baudrate,
+            pipeline.threaded,
+            pipeline.lockmemory,
+            pipeline.resident,
+            pipeline.usb.policy,
+            pipeline.usb.priority,
+            pipeline.usb.affinity,
+            pipeline.capture.policy,
+            pipeline.capture.priority,
+            pipeline.capture.affinity,
+            pipeline.vision.policy,
+            pipeline.vision.priority,
+            pipeline.vision.affinity,
+            pipeline.control.policy,
+            pipeline.control.priority,
+            pipeline.control.affinity,
+            pipeline.ui.policy,
+            pipeline.ui.priority,
+            pipeline.ui.affinity,
+            pipeline.recorder.policy,
+            pipeline.recorder.priority,
+            pipeline.recorder.affinity,
             pid.kp,
             pid.ki,
             pid.kd,
             vision.displaydebug,
             vision.trackball,
+            vision.colortolerance,
+            vision.method,
+            vision.threshold,
+            vision.edgethreshold,
+            vision.darkball,
+            vision.roitracking,
+            vision.pyramid,
+            vision.threads,
             vision.ballradius.min,
             vision.ballradius.max,
+            vision.background.enabled,
+            vision.background.rate,
+            vision.background.interval,
+            vision.background.gain,
+            vision.background.minimum,
+            vision.record.frames,
+            vision.shadow.method,
+            vision.shadow.tolerance,
+            vision.plate.enabled,
+            vision.plate.margin,
+            vision.governor.enabled,
+            vision.governor.budget,
+            vision.governor.headroom,
+            vision.governor.patience,
+            vision.governor.recovery,
+            vision.governor.method,
+            vision.flow.enabled,
+            vision.flow.margin,
+            vision.flow.noise,
+            filter.accelnoise,
+            filter.measnoise,
+            filter.coast,
+            filter.gate,
+            filter.confirm,
+            filter.tracks,
             cam.frame.width,
             cam.frame.height,
             cam.frame.rate,
@@ -398,6 +810,25 @@ struct config {
             cam.balance.blue,
             cam.balance.green,
             cam.balance.autowhite,
+            cam.probe.onstart,
+            cam.probe.frames,
+            cam.probe.warmup,
+            cam.lens.undistort,
+            cam.lens.width,
+            cam.lens.fx,
+            cam.lens.fy,
+            cam.lens.cx,
+            cam.lens.cy,
+            cam.lens.k1,
+            cam.lens.k2,
+            cam.lens.p1,
+            cam.lens.p2,
+            cam.lens.k3,
+            cam.lens.board.columns,
+            cam.lens.board.rows,
+            cam.lens.board.views,
+            cam.shutter.enabled,
+            cam.shutter.readout,
             cam.format,
             cam.exposure,
             cam.sharpness,
@@ -444,12 +875,14 @@ struct config {
     [[nodiscard]]
     friend auto operator==(config const&, config const&) -> bool = default;
 
-    xmlcfg xml;       /**< XML configuration. */
-    screencfg screen; /**< Application screen configuration. */
-    serialcfg serial; /**< Serial connection configuration. */
-    pidcfg pid;       /**< PID controller configuration. */
-    visioncfg vision; /**< Computer vision configuration. */
-    camcfg cam;       /**< Camera configuration. */
+    xmlcfg xml;           /**< XML configuration. */
+    screencfg screen;     /**< Application screen configuration. */
+    serialcfg serial;     /**< Serial connection configuration. */
+    pipelinecfg pipeline; /**< Processing pipeline configuration. */
+    pidcfg pid;           /**< PID controller configuration. */
+    visioncfg vision;     /**< Computer vision configuration. */
+    filtercfg filter;     /**< Ball state estimation configuration. */
+    camcfg cam;           /**< Camera configuration. */
 };
 
 } // namespace cfg
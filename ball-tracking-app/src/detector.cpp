@@ -0,0 +1,223 @@
+/**
+ * @file       detector.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the detector interface and registry.
+ */
+
+#include "detector.h"
+
+#include "hough.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+namespace {
+
+/**
+ * @brief Constructs a Hough circle detector.
+ */
+auto make_hough(int, int, par::worker_pool&) -> std::unique_ptr<detector>
+{ return std::make_unique<hough_detector>(); }
+
+/**
+ * @brief Constructs a threshold and blob detector.
+ */
+auto make_blob(int width, int height, par::worker_pool& pool) -> std::unique_ptr<detector>
+{ return std::make_unique<threshold_detector>(width, height, pool); }
+
+/**
+ * @brief Constructs a gradient voting detector.
+ */
+auto make_gradient(int width, int height, par::worker_pool& pool)
+    -> std::unique_ptr<detector>
+{ return std::make_unique<gradient_detector>(width, height, pool); }
+
+/**
+ * @brief Constructs a template tracking detector.
+ */
+auto make_ncc(int width, int height, par::worker_pool& pool) -> std::unique_ptr<detector>
+{ return std::make_unique<template_detector>(width, height, pool); }
+
+/**
+ * @brief Parameters of the template tracker.
+ */
+constexpr auto tracking = template_settings{
+    .searchradius = 12,
+    .minscore = 0.6f,
+    .learnscore = 0.85f,
+    .rate = 1.f / 32.f};
+
+/**
+ * @brief Minimum confidence of a detection to learn the template from.
+ */
+constexpr auto minacquisition = 0.6f;
+
+/**
+ * @brief Consecutive frames without a match after which the template is discarded.
+ */
+constexpr auto maxmisses = 5;
+
+/**
+ * @brief Registered detectors, indexed by their method.
+ */
+constexpr auto registry = std::array{
+    detector_entry{method::hough, "hough", make_hough},
+    detector_entry{method::blob, "blob", make_blob},
+    detector_entry{method::gradient, "gradient", make_gradient},
+    detector_entry{method::ncc, "ncc", make_ncc}
+};
+
+static_assert([] {
+    for (std::size_t i{}; i < registry.size(); ++i) {
+        if (static_cast<std::size_t>(registry[i].kind) != i) return false;
+    }
+    return true;
+}(), "every detector is required to be registered at the index of its method");
+
+} // namespace
+
+/**
+ * @copydoc detector::detect
+ */
+auto detector::detect(cv::Mat const& image, region window,
+    detect_settings const& settings, detection& result) -> void
+{
+    result.candidates.clear();
+    auto const start = perf::clock::now();
+    search(image, window, settings, result.candidates);
+    result.elapsed_ms = perf::elapsed_ms(start);
+}
+
+/**
+ * @copydoc hough_detector::search
+ */
+auto hough_detector::search(cv::Mat const& image, region window,
+    detect_settings const& settings, std::vector<candidate>& candidates) -> void
+{
+    find_circles(image(cv::Rect{window.x, window.y, window.width, window.height}),
+        settings.minradius, settings.maxradius, circles_);
+    auto const count = std::min(std::ssize(circles_), std::ptrdiff_t{maxcandidates});
+    for (std::ptrdiff_t rank{}; rank < count; ++rank) {
+        auto const& circle = circles_[rank];
+        candidates.push_back({
+            .ball{circle[0] + window.x, circle[1] + window.y, circle[2]},
+            .confidence = 1.f - static_cast<float>(rank) / maxcandidates});
+    }
+}
+
+/**
+ * @copydoc threshold_detector::threshold_detector
+ */
+threshold_detector::threshold_detector(int width, int height, par::worker_pool& pool):
+    blobs_{width, height},
+    pool_{&pool}
+{}
+
+/**
+ * @copydoc threshold_detector::search
+ */
+auto threshold_detector::search(cv::Mat const& image, region window,
+    detect_settings const& settings, std::vector<candidate>& candidates) -> void
+{
+    static_cast<void>(blobs_.detect(image.data, static_cast<int>(image.step), window, {
+        .threshold = settings.threshold,
+        .dark = settings.dark,
+        .minradius = settings.minradius,
+        .maxradius = settings.maxradius,
+        .plate = settings.plate.get()}, *pool_));
+    auto const found = blobs_.candidates();
+    candidates.insert(candidates.end(), found.begin(), found.end());
+}
+
+/**
+ * @copydoc gradient_detector::gradient_detector
+ */
+gradient_detector::gradient_detector(int width, int height, par::worker_pool& pool):
+    circles_{width, height},
+    pool_{&pool}
+{}
+
+/**
+ * @copydoc gradient_detector::search
+ */
+auto gradient_detector::search(cv::Mat const& image, region window,
+    detect_settings const& settings, std::vector<candidate>& candidates) -> void
+{
+    static_cast<void>(circles_.detect(image.data, static_cast<int>(image.step), window, {
+        .threshold = settings.edgethreshold,
+        .dark = settings.dark,
+        .minradius = settings.minradius,
+        .maxradius = settings.maxradius,
+        .plate = settings.plate.get()}, *pool_));
+    auto const found = circles_.candidates();
+    candidates.insert(candidates.end(), found.begin(), found.end());
+}
+
+/**
+ * @copydoc template_detector::template_detector
+ */
+template_detector::template_detector(int width, int height, par::worker_pool& pool):
+    templates_{width, height},
+    circles_{width, height},
+    pool_{&pool}
+{}
+
+/**
+ * @copydoc template_detector::search
+ */
+auto template_detector::search(cv::Mat const& image, region window,
+    detect_settings const& settings, std::vector<candidate>& candidates) -> void
+{
+    auto const stride = static_cast<int>(image.step);
+    if (templates_.learned_at(image.cols, image.rows)) {
+        if (auto const match = templates_.track(image.data, stride, window, tracking,
+            *pool_))
+        {
+            misses_ = 0;
+            candidates.push_back(*match);
+            return;
+        }
+    }
+    // Searches at another resolution than the template, as on the levels of a pyramid,
+    // count as misses too, so a template is not kept for a resolution no longer used.
+    if (templates_.learned() and ++misses_ >= maxmisses) templates_.forget();
+
+    static_cast<void>(circles_.detect(image.data, stride, window, {
+        .threshold = settings.edgethreshold,
+        .dark = settings.dark,
+        .minradius = settings.minradius,
+        .maxradius = settings.maxradius,
+        .plate = settings.plate.get()}, *pool_));
+    auto const found = circles_.candidates();
+    candidates.insert(candidates.end(), found.begin(), found.end());
+    if (not templates_.learned() and not found.empty()
+        and found.front().confidence >= minacquisition)
+    {
+        misses_ = 0;
+        static_cast<void>(templates_.learn(image.data, stride, image.cols, image.rows,
+            found.front().ball));
+    }
+}
+
+/**
+ * @copydoc find_detector
+ */
+auto find_detector(int index) noexcept -> detector_entry const* {
+    if (index < 0 or index >= static_cast<int>(registry.size())) return nullptr;
+    return &registry[index];
+}
+
+} // namespace vis
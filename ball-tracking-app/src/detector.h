@@ -0,0 +1,277 @@
+/**
+ * @file       detector.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Common interface and registry of the ball detectors.
+ */
+
+#ifndef VIS_DETECTOR_H
+#define VIS_DETECTOR_H
+
+#include "blob.h"
+#include "gradient.h"
+#include "ncc.h"
+#include "plate.h"
+#include "pool.h"
+#include "vision.h"
+
+#include <opencv.hpp>
+
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @struct detect_settings
+ * @brief Parameters shared by all detectors.
+ * @details The plate mask is shared, so a detection that is deferred to another thread
+ *     keeps it alive after the mask has been replaced. Detectors that cannot skip
+ *     individual pixels may ignore it, since the searched region already lies within
+ *     the bounds of the plate.
+ */
+struct detect_settings {
+    int minradius;                           /**< Minimum radius of the ball. */
+    int maxradius;                           /**< Maximum radius of the ball. */
+    int threshold;                           /**< Threshold, or 0 to select one. */
+    bool dark;                               /**< Whether the ball is darker. */
+    int edgethreshold{};                     /**< Edge step, or 0 to select one. */
+    std::shared_ptr<plate_mask const> plate; /**< Pixels to search, or null for all. */
+};
+
+/**
+ * @struct detection
+ * @brief Outcome of a single detection.
+ */
+struct detection {
+    /**
+     * @brief Returns the most confident candidate, if any.
+     */
+    [[nodiscard]]
+    auto best() const -> std::optional<blob> {
+        if (candidates.empty()) return std::nullopt;
+        return candidates.front().ball;
+    }
+
+    std::vector<candidate> candidates; /**< Candidates by descending confidence. */
+    double elapsed_ms{};               /**< Time spent detecting. */
+};
+
+/**
+ * @class detector
+ * @brief Detects the ball in a region of a grayscale image.
+ * @details Positions are in coordinates of the whole image, regardless of the region.
+ */
+class detector {
+public:
+    /**
+     * @brief Destroys the detector.
+     */
+    virtual ~detector() = default;
+
+    /**
+     * @brief Returns the method that the detector implements.
+     */
+    [[nodiscard]]
+    virtual auto kind() const noexcept -> method = 0;
+
+    /**
+     * @brief Detects the ball and measures the time it took.
+     * @param[in] image Grayscale image.
+     * @param[in] window Region of the image to search, required to fit within the image.
+     * @param[in] settings Parameters of the detector.
+     * @param[out] result Candidates and timing of the detection. The storage of the
+     *     candidates is reused between detections.
+     */
+    auto detect(cv::Mat const& image, region window, detect_settings const& settings,
+        detection& result) -> void;
+
+private:
+    /**
+     * @brief Appends the candidates within the region, by descending confidence.
+     */
+    virtual auto search(cv::Mat const& image, region window,
+        detect_settings const& settings, std::vector<candidate>& candidates) -> void = 0;
+};
+
+/**
+ * @class hough_detector
+ * @brief Detects the ball with the Hough circle transform.
+ * @details Every circle of the transform becomes a candidate, up to the maximum. The
+ *     transform only ranks the circles by their votes, so the confidence follows from
+ *     the rank: the strongest circle has full confidence, and every next one less.
+ */
+class hough_detector final : public detector {
+public:
+    /**
+     * @copydoc detector::kind
+     */
+    [[nodiscard]]
+    auto kind() const noexcept -> method override
+    { return method::hough; }
+
+    /**
+     * @brief Maximum number of candidates per detection.
+     */
+    static constexpr auto maxcandidates = blob_detector::maxcandidates;
+
+private:
+    /**
+     * @copydoc detector::search
+     */
+    auto search(cv::Mat const& image, region window, detect_settings const& settings,
+        std::vector<candidate>& candidates) -> void override;
+
+    std::vector<cv::Vec3f> circles_; /**< Circles found by the transform. */
+};
+
+/**
+ * @class threshold_detector
+ * @brief Detects the ball as the most circular blob, with the circularity as confidence.
+ */
+class threshold_detector final : public detector {
+public:
+    /**
+     * @brief Constructs a detector for frames up to the given size.
+     * @param[in] width Maximum width of the frames.
+     * @param[in] height Maximum height of the frames.
+     * @param[in] pool Workers to process the bands of the frames on, required to outlive
+     *     the detector.
+     */
+    threshold_detector(int width, int height, par::worker_pool& pool);
+
+    /**
+     * @copydoc detector::kind
+     */
+    [[nodiscard]]
+    auto kind() const noexcept -> method override
+    { return method::blob; }
+
+private:
+    /**
+     * @copydoc detector::search
+     */
+    auto search(cv::Mat const& image, region window, detect_settings const& settings,
+        std::vector<candidate>& candidates) -> void override;
+
+    blob_detector blobs_;    /**< Blob detector. */
+    par::worker_pool* pool_; /**< Workers of the blob detector. */
+};
+
+/**
+ * @class gradient_detector
+ * @brief Detects the ball by voting along the image gradient at the known radii, with
+ *     the supported share of the circumference as confidence.
+ * @details Costs a fraction of the Hough transform, while an occluded or glared part of
+ *     the ball only lowers the confidence.
+ */
+class gradient_detector final : public detector {
+public:
+    /**
+     * @brief Constructs a detector for frames up to the given size.
+     * @param[in] width Maximum width of the frames.
+     * @param[in] height Maximum height of the frames.
+     * @param[in] pool Workers to process the bands of the frames on, required to outlive
+     *     the detector.
+     */
+    gradient_detector(int width, int height, par::worker_pool& pool);
+
+    /**
+     * @copydoc detector::kind
+     */
+    [[nodiscard]]
+    auto kind() const noexcept -> method override
+    { return method::gradient; }
+
+private:
+    /**
+     * @copydoc detector::search
+     */
+    auto search(cv::Mat const& image, region window, detect_settings const& settings,
+        std::vector<candidate>& candidates) -> void override;
+
+    circle_voter circles_;   /**< Gradient voting detector. */
+    par::worker_pool* pool_; /**< Workers of the gradient voting detector. */
+};
+
+/**
+ * @class template_detector
+ * @brief Tracks the ball by normalized cross-correlation with a template of its
+ *     appearance, with the correlation as confidence.
+ * @details The template is learned from the first confident detection of the gradient
+ *     voting detector, and is kept while it matches. Frames without a match fall back to
+ *     the gradient voting detector, and after a few of them the ball is acquired anew.
+ *     Searches at another resolution than the template, such as those on a coarse
+ *     pyramid level, fall back as well.
+ */
+class template_detector final : public detector {
+public:
+    /**
+     * @brief Constructs a detector for frames up to the given size.
+     * @param[in] width Maximum width of the frames.
+     * @param[in] height Maximum height of the frames.
+     * @param[in] pool Workers to process the bands of the frames on, required to outlive
+     *     the detector.
+     */
+    template_detector(int width, int height, par::worker_pool& pool);
+
+    /**
+     * @copydoc detector::kind
+     */
+    [[nodiscard]]
+    auto kind() const noexcept -> method override
+    { return method::ncc; }
+
+private:
+    /**
+     * @copydoc detector::search
+     */
+    auto search(cv::Mat const& image, region window, detect_settings const& settings,
+        std::vector<candidate>& candidates) -> void override;
+
+    template_tracker templates_; /**< Template tracker. */
+    circle_voter circles_;       /**< Detector that acquires the ball. */
+    par::worker_pool* pool_;     /**< Workers of both detectors. */
+    int misses_{};               /**< Consecutive frames without a match. */
+};
+
+/**
+ * @struct detector_entry
+ * @brief Registered detector.
+ */
+struct detector_entry {
+    /**
+     * @typedef factory
+     * @brief Constructs a detector for frames up to the given size.
+     */
+    using factory = auto(*)(int width, int height, par::worker_pool& pool)
+        -> std::unique_ptr<detector>;
+
+    method kind;           /**< Method of the detector, which doubles as its index. */
+    std::string_view name; /**< Name of the detector. */
+    factory make;          /**< Constructs the detector. */
+};
+
+/**
+ * @brief Looks up a registered detector by the configured index of its method.
+ * @details A new detector only needs a method, an implementation of the detector
+ *     interface and an entry in the registry to become selectable from the
+ *     configuration.
+ * @return If the index is registered, returns its entry. Otherwise, returns nullptr.
+ */
+[[nodiscard]]
+auto find_detector(int index) noexcept -> detector_entry const*;
+
+} // namespace vis
+
+#endif
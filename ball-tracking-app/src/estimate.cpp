@@ -0,0 +1,134 @@
+/**
+ * @file       estimate.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the ball state estimation.
+ */
+
+#include "estimate.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+/**
+ * @namespace est
+ * @brief State estimation related components.
+ */
+namespace est {
+
+/**
+ * @copydoc kalman_filter::axis::predict
+ */
+auto kalman_filter::axis::predict(double dt, double q) noexcept -> void {
+    // Discrete white noise acceleration model.
+    auto const dt2 = dt * dt;
+    position += velocity * dt;
+    pp += 2.0 * pv * dt + vv * dt2 + q * dt2 * dt / 3.0;
+    pv += vv * dt + q * dt2 / 2.0;
+    vv += q * dt;
+}
+
+/**
+ * @copydoc kalman_filter::axis::correct
+ */
+auto kalman_filter::axis::correct(double z, double r) noexcept -> void {
+    auto const s = pp + r;
+    auto const kp = pp / s;
+    auto const kv = pv / s;
+    auto const innovation = z - position;
+    position += kp * innovation;
+    velocity += kv * innovation;
+    vv -= kv * pv;
+    pv -= kp * pv;
+    pp -= kp * pp;
+}
+
+/**
+ * @copydoc kalman_filter::axis::correct_velocity
+ */
+auto kalman_filter::axis::correct_velocity(double z, double r) noexcept -> void {
+    auto const s = vv + r;
+    auto const kp = pv / s;
+    auto const kv = vv / s;
+    auto const innovation = z - velocity;
+    position += kp * innovation;
+    velocity += kv * innovation;
+    pp -= kp * pv;
+    pv -= kp * vv;
+    vv -= kv * vv;
+}
+
+/**
+ * @copydoc kalman_filter::since
+ */
+auto kalman_filter::since(perf::clock::time_point time) const noexcept -> double {
+    return std::max(std::chrono::duration<double>{time - time_}.count(), 0.0);
+}
+
+/**
+ * @copydoc kalman_filter::update
+ */
+auto kalman_filter::update(perf::clock::time_point time, vec2 position) noexcept -> void {
+    auto const r = settings_.measnoise * settings_.measnoise;
+    if (not initialized_) {
+        // The velocity is unknown, so its variance spans any plausible speed of the ball.
+        constexpr auto maxspeed = 1'000.0;
+        x_ = {position.x, 0.0, r, 0.0, maxspeed * maxspeed};
+        y_ = {position.y, 0.0, r, 0.0, maxspeed * maxspeed};
+        time_ = time;
+        initialized_ = true;
+        return;
+    }
+
+    auto const dt = since(time);
+    auto const q = settings_.accelnoise * settings_.accelnoise;
+    x_.predict(dt, q);
+    y_.predict(dt, q);
+    x_.correct(position.x, r);
+    y_.correct(position.y, r);
+    time_ = std::max(time, time_);
+}
+
+/**
+ * @copydoc kalman_filter::update_velocity
+ */
+auto kalman_filter::update_velocity(vec2 velocity, vec2 variance) noexcept -> void {
+    if (not initialized_) return;
+    x_.correct_velocity(velocity.x, variance.x);
+    y_.correct_velocity(velocity.y, variance.y);
+}
+
+/**
+ * @copydoc kalman_filter::predict
+ */
+auto kalman_filter::predict(perf::clock::time_point time) const noexcept -> vec2 {
+    auto const dt = since(time);
+    return {x_.position + x_.velocity * dt, y_.position + y_.velocity * dt};
+}
+
+/**
+ * @copydoc kalman_filter::spread
+ */
+auto kalman_filter::spread(perf::clock::time_point time) const noexcept -> vec2 {
+    auto const dt = since(time);
+    auto const q = settings_.accelnoise * settings_.accelnoise;
+    auto x = x_;
+    auto y = y_;
+    x.predict(dt, q);
+    y.predict(dt, q);
+    return {std::sqrt(x.pp), std::sqrt(y.pp)};
+}
+
+/**
+ * @copydoc kalman_filter::tracking
+ */
+auto kalman_filter::tracking(perf::clock::time_point time) const noexcept -> bool {
+    return initialized_ and since(time) <= settings_.maxcoast;
+}
+
+} // namespace est
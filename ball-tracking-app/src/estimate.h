@@ -0,0 +1,163 @@
+/**
+ * @file       estimate.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief State estimation of the ball.
+ */
+
+#ifndef EST_ESTIMATE_H
+#define EST_ESTIMATE_H
+
+#include "stats.h"
+
+/**
+ * @namespace est
+ * @brief State estimation related components.
+ */
+namespace est {
+
+/**
+ * @struct vec2
+ * @brief Two-dimensional vector.
+ */
+struct vec2 {
+    double x; /**< Component along the x-axis. */
+    double y; /**< Component along the y-axis. */
+};
+
+/**
+ * @struct kalman_settings
+ * @brief Parameters of the Kalman filter.
+ */
+struct kalman_settings {
+    double accelnoise; /**< Standard deviation of unmodeled accelerations in px/s^2. */
+    double measnoise;  /**< Standard deviation of the measured positions in pixels. */
+    double maxcoast;   /**< Seconds to keep predicting without measurements. */
+};
+
+/**
+ * @class kalman_filter
+ * @brief Constant-velocity Kalman filter of the ball position.
+ * @details Both axes are filtered independently with a state of position and velocity,
+ *     and a covariance that grows with unmodeled accelerations over time. Measurements
+ *     carry a timestamp, so irregular frame intervals and missed frames are accounted
+ *     for. Without measurements, the filter coasts on its velocity until the configured
+ *     time has passed.
+ */
+class kalman_filter {
+public:
+    /**
+     * @brief Default constructs a filter without any state.
+     */
+    kalman_filter() = default;
+
+    /**
+     * @brief Constructs a filter with the given parameters.
+     * @param[in] settings Parameters of the filter.
+     */
+    explicit kalman_filter(kalman_settings const& settings) noexcept
+        : settings_{settings} {}
+
+    /**
+     * @brief Updates the state with a measured position.
+     * @details The first measurement after a reset initializes the state at rest.
+     * @param[in] time Point in time at which the position was measured.
+     * @param[in] position Measured position in pixels.
+     */
+    auto update(perf::clock::time_point time, vec2 position) noexcept -> void;
+
+    /**
+     * @brief Corrects the state with a measured velocity.
+     * @details Applies to the state at the time of the last position update, so the
+     *     velocity is meant to be measured on the same frame. Both axes are filtered
+     *     independently, so any covariance between them is dropped. Without a state, the
+     *     velocity is ignored.
+     * @param[in] velocity Measured velocity in pixels per second.
+     * @param[in] variance Variance of the measured velocity along either axis.
+     */
+    auto update_velocity(vec2 velocity, vec2 variance) noexcept -> void;
+
+    /**
+     * @brief Returns the predicted position at an arbitrary point in time.
+     * @param[in] time Point in time to predict the position at.
+     */
+    [[nodiscard]]
+    auto predict(perf::clock::time_point time) const noexcept -> vec2;
+
+    /**
+     * @brief Returns the standard deviation of the predicted position.
+     * @param[in] time Point in time to predict the position at.
+     */
+    [[nodiscard]]
+    auto spread(perf::clock::time_point time) const noexcept -> vec2;
+
+    /**
+     * @brief Returns the filtered velocity in pixels per second.
+     */
+    [[nodiscard]]
+    constexpr auto velocity() const noexcept -> vec2
+    { return {x_.velocity, y_.velocity}; }
+
+    /**
+     * @brief Returns whether the state can be relied upon at the given point in time.
+     * @details Holds when the last measurement is no older than the maximum coasting
+     *     time.
+     * @param[in] time Point in time to check.
+     */
+    [[nodiscard]]
+    auto tracking(perf::clock::time_point time) const noexcept -> bool;
+
+    /**
+     * @brief Discards the state, so the next measurement initializes it anew.
+     */
+    auto reset() noexcept -> void
+    { initialized_ = false; }
+
+private:
+    /**
+     * @struct axis
+     * @brief State and covariance along a single axis.
+     */
+    struct axis {
+        double position; /**< Filtered position. */
+        double velocity; /**< Filtered velocity. */
+        double pp;       /**< Variance of the position. */
+        double pv;       /**< Covariance of position and velocity. */
+        double vv;       /**< Variance of the velocity. */
+
+        /**
+         * @brief Propagates the state over a time interval.
+         */
+        auto predict(double dt, double q) noexcept -> void;
+
+        /**
+         * @brief Corrects the state with a measured position.
+         */
+        auto correct(double z, double r) noexcept -> void;
+
+        /**
+         * @brief Corrects the state with a measured velocity.
+         */
+        auto correct_velocity(double z, double r) noexcept -> void;
+    };
+
+    /**
+     * @brief Returns the number of seconds from the state to the given point in time.
+     */
+    [[nodiscard]]
+    auto since(perf::clock::time_point time) const noexcept -> double;
+
+    kalman_settings settings_{};   /**< Parameters of the filter. */
+    axis x_{};                     /**< State along the x-axis. */
+    axis y_{};                     /**< State along the y-axis. */
+    perf::clock::time_point time_; /**< Point in time of the state. */
+    bool initialized_{false};      /**< Whether the state holds a measurement. */
+};
+
+} // namespace est
+
+#endif
@@ -0,0 +1,310 @@
+/**
+ * @file       flow.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the sparse optical flow.
+ */
+
+#include "flow.h"
+
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+namespace {
+
+/**
+ * @brief Number of fractional bits of the patch and the resampled intensities.
+ */
+constexpr auto fraction = 5;
+
+/**
+ * @brief Number of fractional bits of the bilinear weights.
+ */
+constexpr auto weightbits = 14;
+
+/**
+ * @brief Shift that takes a weighted sum of pixels to the fixed point of the patch.
+ */
+constexpr auto shift = weightbits - fraction;
+
+/**
+ * @brief Factor of the central differences relative to the actual gradient.
+ */
+constexpr auto gradientscale = 2.0;
+
+/**
+ * @brief Minimum mean of the smallest eigenvalue of the structure tensor per pixel.
+ * @details Below it, the patch lacks the texture to tell a displacement along some
+ *     direction apart from noise.
+ */
+constexpr auto mineigenvalue = 1.0;
+
+/**
+ * @struct bilinear
+ * @brief Weights of the four neighbors of a sample, in fixed point.
+ */
+struct bilinear {
+    int topleft;     /**< Weight of the top-left neighbor. */
+    int topright;    /**< Weight of the top-right neighbor. */
+    int bottomleft;  /**< Weight of the bottom-left neighbor. */
+    int bottomright; /**< Weight of the bottom-right neighbor. */
+};
+
+/**
+ * @brief Returns the weights of a sample at a fractional offset from its neighbors.
+ */
+inline auto weigh(float fx, float fy) noexcept -> bilinear {
+    constexpr auto one = 1 << weightbits;
+    auto const topleft = static_cast<int>(std::lround((1.f - fx) * (1.f - fy) * one));
+    auto const topright = static_cast<int>(std::lround(fx * (1.f - fy) * one));
+    auto const bottomleft = static_cast<int>(std::lround((1.f - fx) * fy * one));
+    return {topleft, topright, bottomleft, one - topleft - topright - bottomleft};
+}
+
+/**
+ * @brief Returns a sample of two rows in the fixed point of the patch.
+ */
+inline auto sample(uint8 const* top, uint8 const* bottom, int i, bilinear const& w)
+    noexcept -> int
+{
+    auto const sum = top[i] * w.topleft + top[i + 1] * w.topright
+        + bottom[i] * w.bottomleft + bottom[i + 1] * w.bottomright;
+    return (sum + (1 << (shift - 1))) >> shift;
+}
+
+/**
+ * @brief Accumulates the products of the gradients of a row of the patch with its
+ *     differences from the resampled image.
+ * @param[in] top Row of the image at or above the samples.
+ * @param[in] bottom Row of the image below the samples.
+ * @param[in] patch Row of the patch.
+ * @param[in] gx Horizontal gradients of the row.
+ * @param[in] gy Vertical gradients of the row.
+ * @param[in] count Number of pixels of the row.
+ * @param[in] w Weights of the neighbors of every sample.
+ * @param[in,out] bx Sum of the products with the horizontal gradients.
+ * @param[in,out] by Sum of the products with the vertical gradients.
+ */
+inline auto accumulate(uint8 const* top, uint8 const* bottom, int16 const* patch,
+    int16 const* gx, int16 const* gy, int count, bilinear const& w, int64& bx, int64& by)
+    noexcept -> void
+{
+    auto sumx = int32{};
+    auto sumy = int32{};
+    int i{};
+#ifdef SIMD_SSE2
+    auto const zero = _mm_setzero_si128();
+    auto const load = [zero](uint8 const* p) {
+        return _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<__m128i const*>(p)), zero);
+    };
+    // Every 32-bit lane multiplies a pixel and its right neighbor by their weights.
+    auto const upper = _mm_set1_epi32(
+        static_cast<int>((static_cast<uint32>(w.topright) << 16) | w.topleft));
+    auto const lower = _mm_set1_epi32(
+        static_cast<int>((static_cast<uint32>(w.bottomright) << 16) | w.bottomleft));
+    auto const rounding = _mm_set1_epi32(1 << (shift - 1));
+    auto lanesx = _mm_setzero_si128();
+    auto lanesy = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        auto const a = load(top + i);
+        auto const b = load(top + i + 1);
+        auto const c = load(bottom + i);
+        auto const d = load(bottom + i + 1);
+        auto lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), upper),
+            _mm_madd_epi16(_mm_unpacklo_epi16(c, d), lower));
+        auto hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), upper),
+            _mm_madd_epi16(_mm_unpackhi_epi16(c, d), lower));
+        lo = _mm_srai_epi32(_mm_add_epi32(lo, rounding), shift);
+        hi = _mm_srai_epi32(_mm_add_epi32(hi, rounding), shift);
+        auto const difference = _mm_sub_epi16(_mm_packs_epi32(lo, hi),
+            _mm_loadu_si128(reinterpret_cast<__m128i const*>(patch + i)));
+        lanesx = _mm_add_epi32(lanesx, _mm_madd_epi16(difference,
+            _mm_loadu_si128(reinterpret_cast<__m128i const*>(gx + i))));
+        lanesy = _mm_add_epi32(lanesy, _mm_madd_epi16(difference,
+            _mm_loadu_si128(reinterpret_cast<__m128i const*>(gy + i))));
+    }
+    auto const total = [](__m128i lanes) {
+        lanes = _mm_add_epi32(lanes, _mm_shuffle_epi32(lanes, _MM_SHUFFLE(1, 0, 3, 2)));
+        lanes = _mm_add_epi32(lanes, _mm_shuffle_epi32(lanes, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(lanes);
+    };
+    sumx = total(lanesx);
+    sumy = total(lanesy);
+#endif
+    for (; i < count; ++i) {
+        auto const difference = sample(top, bottom, i, w) - patch[i];
+        sumx += difference * gx[i];
+        sumy += difference * gy[i];
+    }
+    bx += sumx;
+    by += sumy;
+}
+
+} // namespace
+
+/**
+ * @copydoc patch_flow::patch_flow
+ */
+patch_flow::patch_flow(int maxradius, int margin):
+    capacity_{2 * (std::max(maxradius, 1) + std::max(margin, 0)) + 1},
+    patch_(static_cast<std::size_t>(capacity_) * capacity_),
+    gx_(patch_.size()),
+    gy_(patch_.size())
+{}
+
+/**
+ * @copydoc patch_flow::measure
+ */
+auto patch_flow::measure(uint8 const* image, int stride, int width, int height,
+    blob const& ball, flow_settings const& settings) -> std::optional<flow_measurement>
+{
+    auto result = std::optional<flow_measurement>{};
+    if (side_ > 0 and width == imagewidth_ and height == imageheight_) {
+        result = align(image, stride, width, height, ball.x - ball_.x, ball.y - ball_.y,
+            settings);
+    }
+    capture(image, stride, width, height, ball, settings.margin);
+    return result;
+}
+
+/**
+ * @copydoc patch_flow::align
+ */
+auto patch_flow::align(uint8 const* image, int stride, int width, int height, float dx,
+    float dy, flow_settings const& settings) const noexcept
+    -> std::optional<flow_measurement>
+{
+    auto const det = gxx_ * gyy_ - gxy_ * gxy_;
+    auto const mean = (gxx_ + gyy_) / 2.0;
+    auto const smallest = mean - std::sqrt(std::max(mean * mean - det, 0.0));
+    if (pixels_ < 3 or smallest < mineigenvalue * pixels_) return std::nullopt;
+    auto const ixx = gyy_ / det;
+    auto const ixy = -gxy_ / det;
+    auto const iyy = gxx_ / det;
+    // The steps solve the normal equations in units of whole pixels.
+    constexpr auto unit = gradientscale / (1 << fraction);
+
+    // Returns the top-left sample of the patch at the displacement, if within the image.
+    auto const locate = [&](float x, float y) -> std::optional<bilinear> {
+        auto const ix = static_cast<int>(std::floor(x));
+        auto const iy = static_cast<int>(std::floor(y));
+        if (left_ + ix < 0 or top_ + iy < 0 or left_ + ix + side_ + 1 > width
+            or top_ + iy + side_ + 1 > height) return std::nullopt;
+        return weigh(x - ix, y - iy);
+    };
+    auto const row = [&](float x, float y, int j) {
+        return image + static_cast<std::ptrdiff_t>(top_ + static_cast<int>(std::floor(y))
+            + j) * stride + left_ + static_cast<int>(std::floor(x));
+    };
+
+    auto converged = false;
+    for (int i{}; i < settings.iterations and not converged; ++i) {
+        auto const weights = locate(dx, dy);
+        if (not weights) return std::nullopt;
+        auto bx = int64{};
+        auto by = int64{};
+        for (int j{}; j < side_; ++j) {
+            auto const offset = j * side_;
+            auto const* const top = row(dx, dy, j);
+            accumulate(top, top + stride, patch_.data() + offset, gx_.data() + offset,
+                gy_.data() + offset, side_, *weights, bx, by);
+        }
+        auto const stepx = static_cast<float>(-(ixx * bx + ixy * by) * unit);
+        auto const stepy = static_cast<float>(-(ixy * bx + iyy * by) * unit);
+        dx += stepx;
+        dy += stepy;
+        converged = std::hypot(stepx, stepy) < settings.epsilon;
+    }
+    auto const weights = locate(dx, dy);
+    if (not converged or not weights) return std::nullopt;
+
+    // The remaining differences over the ball make up the noise of the intensities.
+    auto residual = 0.0;
+    auto const limit = reach_ * reach_;
+    for (int j{}; j < side_; ++j) {
+        auto const* const top = row(dx, dy, j);
+        auto const y = top_ + j - ball_.y;
+        for (int i{}; i < side_; ++i) {
+            auto const x = left_ + i - ball_.x;
+            if (x * x + y * y > limit) continue;
+            auto const difference = sample(top, top + stride, i, *weights)
+                - patch_[j * side_ + i];
+            residual += static_cast<double>(difference) * difference;
+        }
+    }
+    auto const variance = residual / (1 << (2 * fraction)) / std::max(pixels_ - 2, 1);
+    auto const scale = variance * gradientscale * gradientscale;
+    return flow_measurement{
+        .dx = dx,
+        .dy = dy,
+        .xx = static_cast<float>(scale * ixx),
+        .xy = static_cast<float>(scale * ixy),
+        .yy = static_cast<float>(scale * iyy)};
+}
+
+/**
+ * @copydoc patch_flow::capture
+ */
+auto patch_flow::capture(uint8 const* image, int stride, int width, int height,
+    blob const& ball, int margin) noexcept -> void
+{
+    side_ = 0;
+    if (capacity_ == 0) return;
+    auto const reach = ball.radius + std::max(margin, 0);
+    auto const half = std::clamp(static_cast<int>(std::ceil(reach)), 1, capacity_ / 2);
+    auto const side = 2 * half + 1;
+    auto const left = static_cast<int>(std::lround(ball.x)) - half;
+    auto const top = static_cast<int>(std::lround(ball.y)) - half;
+    // The gradients at the border of the patch need the pixels just outside of it.
+    if (left < 1 or top < 1 or left + side + 1 > width or top + side + 1 > height) return;
+
+    gxx_ = 0.0;
+    gxy_ = 0.0;
+    gyy_ = 0.0;
+    pixels_ = 0;
+    auto const limit = reach * reach;
+    for (int j{}; j < side; ++j) {
+        auto const* const p = image + static_cast<std::ptrdiff_t>(top + j) * stride
+            + left;
+        auto const y = top + j - ball.y;
+        for (int i{}; i < side; ++i) {
+            auto const k = j * side + i;
+            auto const x = left + i - ball.x;
+            patch_[k] = static_cast<int16>(p[i] << fraction);
+            if (x * x + y * y > limit) {
+                gx_[k] = 0;
+                gy_[k] = 0;
+                continue;
+            }
+            gx_[k] = static_cast<int16>(p[i + 1] - p[i - 1]);
+            gy_[k] = static_cast<int16>(p[i + stride] - p[i - stride]);
+            gxx_ += gx_[k] * gx_[k];
+            gxy_ += gx_[k] * gy_[k];
+            gyy_ += gy_[k] * gy_[k];
+            ++pixels_;
+        }
+    }
+    side_ = side;
+    left_ = left;
+    top_ = top;
+    imagewidth_ = width;
+    imageheight_ = height;
+    ball_ = ball;
+    reach_ = reach;
+}
+
+} // namespace vis
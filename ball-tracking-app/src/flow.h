@@ -0,0 +1,135 @@
+/**
+ * @file       flow.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Sparse optical flow of the ball between consecutive frames.
+ */
+
+#ifndef VIS_FLOW_H
+#define VIS_FLOW_H
+
+#include "blob.h"
+#include "types.h"
+
+#include <optional>
+#include <vector>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @struct flow_settings
+ * @brief Parameters of the optical flow.
+ */
+struct flow_settings {
+    int margin;     /**< Pixels around the ball that belong to the patch. */
+    int iterations; /**< Maximum number of Gauss-Newton iterations. */
+    float epsilon;  /**< Step in pixels below which the iterations have converged. */
+};
+
+/**
+ * @struct flow_measurement
+ * @brief Displacement of the ball between two frames.
+ */
+struct flow_measurement {
+    float dx; /**< Displacement along the x-axis. */
+    float dy; /**< Displacement along the y-axis. */
+    float xx; /**< Variance of the displacement along the x-axis. */
+    float xy; /**< Covariance of the displacement along both axes. */
+    float yy; /**< Variance of the displacement along the y-axis. */
+};
+
+/**
+ * @class patch_flow
+ * @brief Measures the displacement of the ball patch with the Lucas-Kanade method.
+ * @details Every call keeps a patch around the detected ball, and the next call finds
+ *     the translation that best aligns that patch with the new frame. Only the pixels
+ *     within the margin of the ball outline take part, so the static plate around it
+ *     does not pull the displacement towards zero. The patch and its gradients stay
+ *     fixed over the Gauss-Newton iterations, so only the bilinear resampling of the
+ *     frame and two products per pixel remain per iteration, which are computed on
+ *     16-bit fixed-point integers with SSE2.
+ *
+ *     The iterations start from the displacement between the two detections, which is
+ *     already within a pixel, so no coarser pyramid levels are needed. The covariance
+ *     of the result is the variance of the remaining intensity differences times the
+ *     inverse of the structure tensor of the patch, so a blurred or textureless ball
+ *     reports its own uncertainty.
+ */
+class patch_flow {
+public:
+    /**
+     * @brief Default constructs a flow without buffers.
+     */
+    patch_flow() = default;
+
+    /**
+     * @brief Constructs a flow for balls up to the given radius.
+     * @param[in] maxradius Maximum radius of the ball in pixels.
+     * @param[in] margin Maximum margin around the ball in pixels.
+     */
+    patch_flow(int maxradius, int margin);
+
+    /**
+     * @brief Measures the displacement of the ball since the previous call.
+     * @details The patch of the previous call is replaced by one around the given ball.
+     * @param[in] image Grayscale image.
+     * @param[in] stride Number of bytes between the starts of two consecutive rows.
+     * @param[in] width Width of the image.
+     * @param[in] height Height of the image.
+     * @param[in] ball Detected ball in image coordinates.
+     * @param[in] settings Parameters of the flow.
+     * @return If there is a previous patch and the alignment converged within the
+     *     image, returns the displacement. Otherwise, returns std::nullopt.
+     */
+    [[nodiscard]]
+    auto measure(uint8 const* image, int stride, int width, int height, blob const& ball,
+        flow_settings const& settings) -> std::optional<flow_measurement>;
+
+    /**
+     * @brief Discards the patch, so the next call only keeps a new one.
+     */
+    auto reset() noexcept -> void
+    { side_ = 0; }
+
+private:
+    /**
+     * @brief Aligns the patch with an image, starting from a displacement.
+     */
+    [[nodiscard]]
+    auto align(uint8 const* image, int stride, int width, int height, float dx, float dy,
+        flow_settings const& settings) const noexcept -> std::optional<flow_measurement>;
+
+    /**
+     * @brief Keeps the patch around a ball and computes its gradients.
+     */
+    auto capture(uint8 const* image, int stride, int width, int height, blob const& ball,
+        int margin) noexcept -> void;
+
+    int capacity_{};             /**< Maximum width and height of the patch. */
+    int side_{};                 /**< Width and height of the patch, or 0 if none. */
+    int left_{};                 /**< Left edge of the patch in the image. */
+    int top_{};                  /**< Top edge of the patch in the image. */
+    int imagewidth_{};           /**< Width of the image of the patch. */
+    int imageheight_{};          /**< Height of the image of the patch. */
+    blob ball_{};                /**< Ball that the patch was kept around. */
+    float reach_{};              /**< Distance from the ball within which pixels count. */
+    std::vector<int16> patch_;   /**< Intensities of the patch, in fixed point. */
+    std::vector<int16> gx_;      /**< Horizontal gradients, zero outside the ball. */
+    std::vector<int16> gy_;      /**< Vertical gradients, zero outside the ball. */
+    double gxx_{};               /**< Sum of the squared horizontal gradients. */
+    double gxy_{};               /**< Sum of the products of both gradients. */
+    double gyy_{};               /**< Sum of the squared vertical gradients. */
+    int pixels_{};               /**< Number of pixels that take part. */
+};
+
+} // namespace vis
+
+#endif
@@ -0,0 +1,91 @@
+/**
+ * @file       governor.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the quality governor.
+ */
+
+#include "governor.h"
+
+#include <algorithm>
+#include <format>
+#include <iterator>
+
+/**
+ * @namespace perf
+ * @brief Performance measurement related components.
+ */
+namespace perf {
+
+/**
+ * @copydoc to_string(quality)
+ */
+auto to_string(quality level) noexcept -> std::string_view {
+    switch (level) {
+    case quality::full:       return "full";
+    case quality::smallroi:   return "small roi";
+    case quality::binned:     return "binned";
+    case quality::background: return "frozen background";
+    case quality::detector:   return "cheap detector";
+    default:                  return "unknown";
+    }
+}
+
+/**
+ * @copydoc quality_governor::quality_governor
+ */
+quality_governor::quality_governor(governor_settings const& settings,
+    std::filesystem::path const& logfile
+):
+    settings_{settings},
+    log_{logfile}
+{
+    settings_.patience = std::max(settings_.patience, 1);
+    settings_.recovery = std::max(settings_.recovery, 1);
+    log_ << "frame,from,to,stage ms,average ms,period ms\n";
+}
+
+/**
+ * @copydoc quality_governor::update
+ */
+auto quality_governor::update(double stage_ms, double period_ms) -> bool {
+    if (settings_.budget <= 0.0 or period_ms <= 0.0) return false;
+
+    ++frame_;
+    // Follows the stage time over roughly the last 16 frames.
+    constexpr auto smoothing = 1.0 / 16.0;
+    average_ = frame_ == 1 ? stage_ms : average_ + (stage_ms - average_) * smoothing;
+
+    over_ = stage_ms > settings_.budget * period_ms ? over_ + 1 : 0;
+    under_ = average_ < settings_.headroom * period_ms ? under_ + 1 : 0;
+    if (over_ >= settings_.patience and level_ != quality::detector) {
+        change(static_cast<quality>(static_cast<int>(level_) + 1), stage_ms, period_ms);
+        ++summary_.degrades;
+        return true;
+    }
+    if (under_ >= settings_.recovery and level_ != quality::full) {
+        change(static_cast<quality>(static_cast<int>(level_) - 1), stage_ms, period_ms);
+        ++summary_.restores;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @copydoc quality_governor::change
+ */
+auto quality_governor::change(quality to, double stage_ms, double period_ms) -> void {
+    std::format_to(std::ostreambuf_iterator<char>{log_},
+        "{},{},{},{:.3f},{:.3f},{:.3f}\n", frame_, to_string(level_), to_string(to),
+        stage_ms, average_, period_ms);
+    level_ = to;
+    ++summary_.entered[static_cast<int>(to)];
+    over_ = 0;
+    under_ = 0;
+}
+
+} // namespace perf
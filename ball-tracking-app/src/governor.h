@@ -0,0 +1,153 @@
+/**
+ * @file       governor.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Deadline-aware quality scaling of the vision stage.
+ */
+
+#ifndef PERF_GOVERNOR_H
+#define PERF_GOVERNOR_H
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+
+/**
+ * @namespace perf
+ * @brief Performance measurement related components.
+ */
+namespace perf {
+
+/**
+ * @enum quality
+ * @brief Quality levels of the vision stage, from best to cheapest.
+ * @details Every level also applies the degradations of the levels before it.
+ */
+enum class quality {
+    full,       /**< Searches at full quality. */
+    smallroi,   /**< Narrows the tracking window and acquires on the pyramid. */
+    binned,     /**< Searches a 2x2 binned image. */
+    background, /**< Freezes the background model instead of updating it. */
+    detector,   /**< Switches to the cheapest detector. */
+};
+
+/**
+ * @brief Number of quality levels.
+ */
+inline constexpr auto qualitylevels = static_cast<int>(quality::detector) + 1;
+
+/**
+ * @brief Returns the name of a quality level.
+ */
+[[nodiscard]]
+auto to_string(quality level) noexcept -> std::string_view;
+
+/**
+ * @struct governor_settings
+ * @brief Parameters of the quality governor.
+ */
+struct governor_settings {
+    double budget;   /**< Share of the frame period that the stage may take. */
+    double headroom; /**< Share of the frame period below which quality is restored. */
+    int patience;    /**< Consecutive frames over budget before degrading. */
+    int recovery;    /**< Consecutive frames with headroom before restoring. */
+};
+
+/**
+ * @struct governor_summary
+ * @brief Transitions of the quality governor so far.
+ */
+struct governor_summary {
+    std::size_t degrades;                           /**< Number of degradations. */
+    std::size_t restores;                           /**< Number of restorations. */
+    std::array<std::size_t, qualitylevels> entered; /**< Entries per quality level. */
+};
+
+/**
+ * @class quality_governor
+ * @brief Trades image quality for a predictable stage time.
+ * @details The governor compares the time of every frame against its share of the frame
+ *     period. After a number of consecutive frames over budget, it degrades quality by a
+ *     single level and starts counting anew, so a stage that is still over budget keeps
+ *     degrading until it fits. Quality is restored a level at a time once the smoothed
+ *     stage time has stayed below the headroom for a longer run of frames. The gap
+ *     between the budget and the headroom keeps a level whose restoration would push the
+ *     stage straight back over budget from oscillating. Every transition is counted and
+ *     appended to a CSV log.
+ */
+class quality_governor {
+public:
+    /**
+     * @brief Default constructs a governor that stays at full quality.
+     */
+    quality_governor() = default;
+
+    /**
+     * @brief Constructs a governor at full quality.
+     * @param[in] settings Parameters of the governor.
+     * @param[in] logfile Path of the CSV log, which is overwritten.
+     */
+    quality_governor(governor_settings const& settings,
+        std::filesystem::path const& logfile);
+
+    /**
+     * @brief Accounts for the time of a frame and adjusts the quality level.
+     * @param[in] stage_ms Time spent on the vision stage of the frame.
+     * @param[in] period_ms Frame period of the camera.
+     * @return If the quality level changed, returns true. Otherwise, returns false.
+     */
+    auto update(double stage_ms, double period_ms) -> bool;
+
+    /**
+     * @brief Returns the current quality level.
+     */
+    [[nodiscard]]
+    constexpr auto level() const noexcept -> quality
+    { return level_; }
+
+    /**
+     * @brief Returns whether the current level applies the degradation of a level.
+     */
+    [[nodiscard]]
+    constexpr auto degraded(quality step) const noexcept -> bool
+    { return level_ >= step and step != quality::full; }
+
+    /**
+     * @brief Returns the smoothed stage time in milliseconds.
+     */
+    [[nodiscard]]
+    constexpr auto average_ms() const noexcept -> double
+    { return average_; }
+
+    /**
+     * @brief Returns the transitions so far.
+     */
+    [[nodiscard]]
+    constexpr auto summary() const noexcept -> governor_summary const&
+    { return summary_; }
+
+private:
+    /**
+     * @brief Moves to another quality level and logs the transition.
+     */
+    auto change(quality to, double stage_ms, double period_ms) -> void;
+
+    governor_settings settings_{}; /**< Parameters of the governor. */
+    std::ofstream log_;            /**< Transition log. */
+    quality level_{quality::full}; /**< Current quality level. */
+    double average_{};             /**< Smoothed stage time. */
+    int over_{};                   /**< Consecutive frames over budget. */
+    int under_{};                  /**< Consecutive frames with headroom. */
+    std::size_t frame_{};          /**< Number of accounted frames. */
+    governor_summary summary_{};   /**< Transitions so far. */
+};
+
+} // namespace perf
+
+#endif
@@ -0,0 +1,336 @@
+/**
+ * @file       gradient.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the gradient voting detector.
+ */
+
+#include "gradient.h"
+
+#include "plate.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <functional>
+#include <numbers>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+namespace {
+
+/**
+ * @brief Minimum number of votes of an accumulator peak worth refining.
+ */
+constexpr auto minvotes = 8;
+
+/**
+ * @brief Minimum share of the circumference that a circle needs support on.
+ */
+constexpr auto mincoverage = 0.4f;
+
+/**
+ * @brief Number of sectors of the circumference that the support is counted in.
+ */
+constexpr auto sectors = 64;
+
+/**
+ * @brief Returns the columns of a row to compute gradients for.
+ */
+inline auto interior(int y, int first, int last, plate_mask const* plate) noexcept
+    -> row_span
+{ return plate ? plate->columns(y, first, last) : row_span{first, last}; }
+
+} // namespace
+
+/**
+ * @copydoc circle_voter::circle_voter
+ */
+circle_voter::circle_voter(int width, int height):
+    width_{width},
+    // A ball and some texture never come close to this many edges; anything beyond is a
+    // badly chosen threshold, which is cheaper to reject than to vote with.
+    capacity_{static_cast<int>(int64{width} * height / 8)},
+    gx_(static_cast<std::size_t>(width) * height),
+    gy_(static_cast<std::size_t>(width) * height),
+    edges_(capacity_),
+    votes_(static_cast<std::size_t>((width + 1) / 2) * ((height + 1) / 2))
+{}
+
+/**
+ * @copydoc circle_voter::detect
+ */
+auto circle_voter::detect(uint8 const* image, int stride, region roi,
+    gradient_settings const& settings, par::worker_pool& pool) -> std::optional<blob>
+{
+    candidatecount_ = 0;
+    if (roi.width < 3 or roi.height < 3 or capacity_ == 0) return std::nullopt;
+
+    auto const inner = region{roi.x + 1, roi.y + 1, roi.width - 2, roi.height - 2};
+    auto bands = std::min(pool.bands(inner.width, inner.height), maxbands);
+    pool.for_bands(inner.y, inner.y + inner.height, bands,
+        [&](int band, int first, int last) {
+            peaks_[band] = sobel(image, stride,
+                {inner.x, first, inner.width, last - first}, settings.plate);
+        });
+    auto const peak = *std::max_element(peaks_.begin(), peaks_.begin() + bands);
+    // A step between the ball and the plate yields a magnitude of 4 to 6 times the step,
+    // depending on the orientation of the edge.
+    threshold_ = settings.threshold > 0 ? 3 * settings.threshold : std::max(peak / 4, 32);
+
+    auto collected = std::array<bool, maxbands>{};
+    pool.for_bands(inner.y, inner.y + inner.height, bands,
+        [&](int band, int first, int last) {
+            auto& edges = spans_[band];
+            edges = {
+                static_cast<int>(int64{capacity_} * band / bands),
+                static_cast<int>(int64{capacity_} * (band + 1) / bands)};
+            collected[band] = collect({inner.x, first, inner.width, last - first},
+                settings.dark, settings.plate, edges);
+        });
+    if (not std::all_of(collected.begin(), collected.begin() + bands, std::identity{})) {
+        // As with the runs of the blob detector, a band that overflows its share has the
+        // region collected again at once before it is rejected.
+        if (bands == 1) return std::nullopt;
+        bands = 1;
+        auto& edges = spans_[0];
+        edges = {0, capacity_};
+        if (not collect(inner, settings.dark, settings.plate, edges)) return std::nullopt;
+    }
+
+    auto const minradius = std::max(settings.minradius, 1);
+    auto const maxradius = std::max(settings.maxradius, minradius);
+    vote(roi, bands, minradius, maxradius);
+
+    // Every peak is suppressed along with its surroundings once it has been refined, so
+    // the next peak belongs to another circle.
+    auto const suppress = std::max(minradius / 2, 1);
+    for (int attempt{}; attempt < 2 * maxcandidates and candidatecount_ < maxcandidates;
+        ++attempt)
+    {
+        auto const best = std::max_element(votes_.begin(),
+            votes_.begin() + static_cast<std::ptrdiff_t>(columns_) * rows_);
+        if (*best < minvotes) break;
+        auto const index = static_cast<int>(best - votes_.begin());
+        auto const column = index % columns_;
+        auto const row = index / columns_;
+
+        auto const found = refine(roi.x + 2.f * column + 0.5f, roi.y + 2.f * row + 0.5f,
+            bands, minradius, maxradius);
+        if (found) {
+            auto const at = std::upper_bound(candidates_.begin(),
+                candidates_.begin() + candidatecount_, *found,
+                [](candidate const& a, candidate const& b) {
+                    return a.confidence > b.confidence;
+                });
+            std::move_backward(at, candidates_.begin() + candidatecount_,
+                candidates_.begin() + candidatecount_ + 1);
+            *at = *found;
+            ++candidatecount_;
+        }
+        auto const bottom = std::min(row + suppress, rows_ - 1);
+        for (auto r = std::max(row - suppress, 0); r <= bottom; ++r) {
+            auto* cells = votes_.data() + r * columns_;
+            std::fill(cells + std::max(column - suppress, 0),
+                cells + std::min(column + suppress + 1, columns_), uint16{});
+        }
+    }
+    if (candidatecount_ == 0) return std::nullopt;
+    return candidates_[0].ball;
+}
+
+/**
+ * @copydoc circle_voter::sobel
+ */
+auto circle_voter::sobel(uint8 const* image, int stride, region band,
+    plate_mask const* plate) noexcept -> int
+{
+    auto peak = 0;
+    for (auto y = band.y; y < band.y + band.height; ++y) {
+        auto const columns = interior(y, band.x, band.x + band.width, plate);
+        auto const* above = image + (y - 1) * stride;
+        auto const* row = image + y * stride;
+        auto const* below = image + (y + 1) * stride;
+        auto* gx = gx_.data() + y * width_;
+        auto* gy = gy_.data() + y * width_;
+        auto x = columns.first;
+#ifdef SIMD_SSE2
+        auto const zero = _mm_setzero_si128();
+        auto const load = [zero](uint8 const* p) {
+            return _mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<__m128i const*>(p)), zero);
+        };
+        auto peaks = _mm_setzero_si128();
+        for (; x + 8 <= columns.last; x += 8) {
+            auto const a0 = load(above + x - 1);
+            auto const a1 = load(above + x);
+            auto const a2 = load(above + x + 1);
+            auto const b0 = load(row + x - 1);
+            auto const b2 = load(row + x + 1);
+            auto const c0 = load(below + x - 1);
+            auto const c1 = load(below + x);
+            auto const c2 = load(below + x + 1);
+            auto const dx = _mm_add_epi16(
+                _mm_add_epi16(_mm_sub_epi16(a2, a0), _mm_sub_epi16(c2, c0)),
+                _mm_slli_epi16(_mm_sub_epi16(b2, b0), 1));
+            auto const dy = _mm_add_epi16(
+                _mm_add_epi16(_mm_sub_epi16(c0, a0), _mm_sub_epi16(c2, a2)),
+                _mm_slli_epi16(_mm_sub_epi16(c1, a1), 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(gx + x), dx);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(gy + x), dy);
+            auto const ax = _mm_max_epi16(dx, _mm_sub_epi16(zero, dx));
+            auto const ay = _mm_max_epi16(dy, _mm_sub_epi16(zero, dy));
+            peaks = _mm_max_epi16(peaks, _mm_add_epi16(ax, ay));
+        }
+        alignas(16) int16 lanes[8];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), peaks);
+        peak = std::max(peak, int{*std::max_element(lanes, lanes + 8)});
+#endif
+        for (; x < columns.last; ++x) {
+            auto const dx = (above[x + 1] - above[x - 1]) + 2 * (row[x + 1] - row[x - 1])
+                + (below[x + 1] - below[x - 1]);
+            auto const dy = (below[x - 1] - above[x - 1]) + 2 * (below[x] - above[x])
+                + (below[x + 1] - above[x + 1]);
+            gx[x] = static_cast<int16>(dx);
+            gy[x] = static_cast<int16>(dy);
+            peak = std::max(peak, std::abs(dx) + std::abs(dy));
+        }
+    }
+    return peak;
+}
+
+/**
+ * @copydoc circle_voter::collect
+ */
+auto circle_voter::collect(region band, bool dark, plate_mask const* plate,
+    span& edges) noexcept -> bool
+{
+    auto const limit = edges.last;
+    edges.last = edges.first;
+    // Gradients point from dark to bright, so they point towards a bright ball.
+    auto const sign = dark ? -1.f : 1.f;
+    for (auto y = band.y; y < band.y + band.height; ++y) {
+        auto const columns = interior(y, band.x, band.x + band.width, plate);
+        auto const* gx = gx_.data() + y * width_;
+        auto const* gy = gy_.data() + y * width_;
+        for (auto x = columns.first; x < columns.last; ++x) {
+            if (std::abs(gx[x]) + std::abs(gy[x]) < threshold_) continue;
+            if (edges.last == limit) return false;
+            auto const scale = sign
+                / std::hypot(static_cast<float>(gx[x]), static_cast<float>(gy[x]));
+            edges_[edges.last++] = {static_cast<float>(x), static_cast<float>(y),
+                gx[x] * scale, gy[x] * scale};
+        }
+    }
+    return true;
+}
+
+/**
+ * @copydoc circle_voter::vote
+ */
+auto circle_voter::vote(region roi, int bands, int minradius, int maxradius) noexcept
+    -> void
+{
+    columns_ = (roi.width + 1) / 2;
+    rows_ = (roi.height + 1) / 2;
+    std::fill_n(votes_.begin(), static_cast<std::ptrdiff_t>(columns_) * rows_, uint16{});
+
+    // Coordinates relative to the region are offset by half a pixel, so truncation
+    // rounds to the nearest pixel.
+    auto const left = roi.x - 0.5f;
+    auto const top = roi.y - 0.5f;
+    for (int band{}; band < bands; ++band) {
+        for (auto i = spans_[band].first; i < spans_[band].last; ++i) {
+            auto const& e = edges_[i];
+            auto x = e.x - left + e.dx * minradius;
+            auto y = e.y - top + e.dy * minradius;
+            for (auto r = minradius; r <= maxradius; ++r) {
+                // The region is convex, so a ray that left it never returns.
+                if (x < 0.f or y < 0.f) break;
+                auto const px = static_cast<int>(x);
+                auto const py = static_cast<int>(y);
+                if (px >= roi.width or py >= roi.height) break;
+                auto& cell = votes_[(py >> 1) * columns_ + (px >> 1)];
+                cell = static_cast<uint16>(cell + (cell < 0xffff));
+                x += e.dx;
+                y += e.dy;
+            }
+        }
+    }
+}
+
+/**
+ * @copydoc circle_voter::refine
+ */
+auto circle_voter::refine(float x, float y, int bands, int minradius, int maxradius)
+    const noexcept -> std::optional<candidate>
+{
+    auto const nearest = minradius - 1.5f;
+    auto const furthest = maxradius + 1.5f;
+    auto radius = 0.f;
+    auto support = uint64{};
+
+    // The first pass admits the edges of the whole cell, later passes only those that
+    // pass close to the refined center.
+    for (auto const tolerance : {2.f, 1.f, 1.f}) {
+        auto sxx = 0.0;
+        auto sxy = 0.0;
+        auto syy = 0.0;
+        auto bx = 0.0;
+        auto by = 0.0;
+        auto sum = 0.0;
+        auto count = 0;
+        support = 0;
+        for (int band{}; band < bands; ++band) {
+            for (auto i = spans_[band].first; i < spans_[band].last; ++i) {
+                auto const& e = edges_[i];
+                auto const vx = x - e.x;
+                auto const vy = y - e.y;
+                auto const along = vx * e.dx + vy * e.dy;
+                if (along < nearest or along > furthest) continue;
+                if (std::abs(vx * e.dy - vy * e.dx) > tolerance) continue;
+
+                // The normal of the gradient line, whose distance to the center is
+                // minimized in the least-squares sense.
+                auto const nx = double{e.dy};
+                auto const ny = -double{e.dx};
+                auto const offset = nx * e.x + ny * e.y;
+                sxx += nx * nx;
+                sxy += nx * ny;
+                syy += ny * ny;
+                bx += nx * offset;
+                by += ny * offset;
+                sum += along;
+                ++count;
+
+                auto const angle = std::atan2(-vy, -vx);
+                auto const sector = static_cast<int>(
+                    (angle + std::numbers::pi_v<float>) * (sectors / 2)
+                    / std::numbers::pi_v<float>);
+                support |= uint64{1} << std::clamp(sector, 0, sectors - 1);
+            }
+        }
+        auto const det = sxx * syy - sxy * sxy;
+        if (count < 3 or det < 1e-6 * count * count) return std::nullopt;
+        x = static_cast<float>((syy * bx - sxy * by) / det);
+        y = static_cast<float>((sxx * by - sxy * bx) / det);
+        radius = static_cast<float>(sum / count);
+    }
+
+    auto const coverage = static_cast<float>(std::popcount(support)) / sectors;
+    if (coverage < mincoverage or radius < minradius or radius > maxradius) {
+        return std::nullopt;
+    }
+    return candidate{.ball{x, y, radius}, .confidence = coverage};
+}
+
+} // namespace vis
@@ -0,0 +1,188 @@
+/**
+ * @file       gradient.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Circle detector that votes along the image gradient at the known ball radii.
+ */
+
+#ifndef VIS_GRADIENT_H
+#define VIS_GRADIENT_H
+
+#include "blob.h"
+#include "pool.h"
+#include "types.h"
+#include "vision.h"
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @struct gradient_settings
+ * @brief Parameters of the gradient voting detector.
+ */
+struct gradient_settings {
+    int threshold;             /**< Minimum intensity step of an edge, or 0 for auto. */
+    bool dark;                 /**< Whether the ball is darker than its surroundings. */
+    int minradius;             /**< Minimum radius of the ball. */
+    int maxradius;             /**< Maximum radius of the ball. */
+    plate_mask const* plate{}; /**< Pixels to consider, or null for the whole region. */
+};
+
+/**
+ * @class circle_voter
+ * @brief Detects the ball as the circle of the expected radius with the most support.
+ * @details The detector computes Sobel gradients of the region, keeps the pixels whose
+ *     gradient magnitude exceeds the edge threshold, and lets every edge cast votes for
+ *     the centers that lie along its gradient at the radii of the ball. Since the ball
+ *     is either brighter or darker than the plate, an edge only votes on the side that
+ *     the ball lies on. Votes go into an accumulator of 2x2 pixel cells, which is small
+ *     enough to stay in cache. Unlike the Hough transform, there is no Canny stage and no
+ *     accumulator per radius.
+ *
+ *     Every peak is refined with the edges whose gradient line passes close to it: the
+ *     center is the least-squares intersection of their lines, and the radius is their
+ *     mean distance to the center. The confidence is the share of the circumference
+ *     with supporting edges, so an occluded or glared part of the ball only lowers the
+ *     confidence instead of moving the center. All buffers are allocated upon
+ *     construction for the given frame size, so detecting never allocates.
+ */
+class circle_voter {
+public:
+    /**
+     * @brief Default constructs a detector without buffers.
+     */
+    circle_voter() = default;
+
+    /**
+     * @brief Constructs a detector for frames up to the given size.
+     * @param[in] width Maximum width of the frames.
+     * @param[in] height Maximum height of the frames.
+     */
+    circle_voter(int width, int height);
+
+    /**
+     * @brief Detects the ball within a region of a grayscale image.
+     * @details The outermost rows and columns of the region only serve as neighbors of
+     *     the gradients within. The bands share the capacity of edges equally, and a band
+     *     that overflows its share has the region collected again as a single band, so
+     *     only a region that exceeds the capacity as a whole is rejected.
+     * @param[in] image Grayscale image.
+     * @param[in] stride Number of bytes between the starts of two consecutive rows.
+     * @param[in] roi Region of the image to search, required to fit within the image
+     *     and the size given upon construction.
+     * @param[in] settings Parameters of the detector.
+     * @param[in] pool Workers to compute the gradients of the bands of the region on.
+     * @return Position and radius of the ball in image coordinates, if found.
+     */
+    [[nodiscard]]
+    auto detect(uint8 const* image, int stride, region roi,
+        gradient_settings const& settings, par::worker_pool& pool) -> std::optional<blob>;
+
+    /**
+     * @brief Returns the edge threshold that was applied during the last detection.
+     */
+    [[nodiscard]]
+    constexpr auto threshold() const noexcept -> int
+    { return threshold_; }
+
+    /**
+     * @brief Returns the best supported circles of the last detection, by descending
+     *     confidence. The first one is the detected ball.
+     */
+    [[nodiscard]]
+    auto candidates() const noexcept -> std::span<candidate const>
+    { return {candidates_.data(), static_cast<std::size_t>(candidatecount_)}; }
+
+    /**
+     * @brief Maximum number of candidates that are kept per detection.
+     */
+    static constexpr auto maxcandidates = 4;
+
+private:
+    /**
+     * @brief Maximum number of bands that a region is split into.
+     */
+    static constexpr auto maxbands = 16;
+
+    /**
+     * @struct edge
+     * @brief Edge pixel with the unit direction towards the ball.
+     */
+    struct edge {
+        float x;  /**< Column of the pixel. */
+        float y;  /**< Row of the pixel. */
+        float dx; /**< Direction towards the center along the x-axis. */
+        float dy; /**< Direction towards the center along the y-axis. */
+    };
+
+    /**
+     * @struct span
+     * @brief Range of edges that belong to a single band.
+     */
+    struct span {
+        int first; /**< First edge of the band. */
+        int last;  /**< Edge past the last edge of the band. */
+    };
+
+    /**
+     * @brief Computes the gradients of all rows in a band.
+     * @return Largest gradient magnitude within the band.
+     */
+    auto sobel(uint8 const* image, int stride, region band, plate_mask const* plate)
+        noexcept -> int;
+
+    /**
+     * @brief Collects the edges of all rows in a band.
+     * @details The edges are stored from the given first edge onward, and at most up to
+     *     the capacity of a single band.
+     * @return If the number of edges stayed within capacity, returns true. Otherwise,
+     *     the image is considered too noisy and returns false.
+     */
+    auto collect(region band, bool dark, plate_mask const* plate, span& edges) noexcept
+        -> bool;
+
+    /**
+     * @brief Casts the votes of all edges into the accumulator.
+     */
+    auto vote(region roi, int bands, int minradius, int maxradius) noexcept -> void;
+
+    /**
+     * @brief Refines the circle around an accumulator peak.
+     * @return If enough of the circumference is supported, returns the circle.
+     *     Otherwise, returns std::nullopt.
+     */
+    [[nodiscard]]
+    auto refine(float x, float y, int bands, int minradius, int maxradius) const noexcept
+        -> std::optional<candidate>;
+
+    int width_{};                                       /**< Maximum width. */
+    int threshold_{};                                   /**< Last edge threshold. */
+    int capacity_{};                                    /**< Maximum number of edges. */
+    int columns_{};                                     /**< Cells per accumulator row. */
+    int rows_{};                                        /**< Rows of accumulator cells. */
+    std::vector<int16> gx_;                             /**< Horizontal gradients. */
+    std::vector<int16> gy_;                             /**< Vertical gradients. */
+    std::vector<edge> edges_;                           /**< Edges of the detection. */
+    std::vector<uint16> votes_;                         /**< Votes per 2x2 cell. */
+    std::array<span, maxbands> spans_{};                /**< Edges per band. */
+    std::array<int, maxbands> peaks_{};                 /**< Peak magnitude per band. */
+    std::array<candidate, maxcandidates> candidates_{}; /**< Candidates by confidence. */
+    int candidatecount_{};                              /**< Number of candidates. */
+};
+
+} // namespace vis
+
+#endif
@@ -0,0 +1,39 @@
+/**
+ * @file       hough.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the Hough circle detection.
+ */
+
+#include "hough.h"
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @copydoc find_circles
+ */
+auto find_circles(cv::Mat const& image, int minradius, int maxradius,
+    std::vector<cv::Vec3f>& circles) -> void
+{
+    constexpr auto resolution = 1.0; // Accumulator resolution relative to the image.
+    constexpr auto edges = 200.0;    // Upper threshold of the Canny edge detector.
+    constexpr auto votes = 20.0;     // Minimum number of votes of the center.
+
+    // Two balls touch at twice the radius, so closer centers belong to the same circle.
+    auto const mindistance = 2.0 * std::max(minradius, 1);
+    cv::HoughCircles(image, circles, cv::HOUGH_GRADIENT, resolution, mindistance, edges,
+        votes, minradius, maxradius);
+}
+
+} // namespace vis
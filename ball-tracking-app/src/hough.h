@@ -0,0 +1,44 @@
+/**
+ * @file       hough.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Circle detection based upon the Hough transform.
+ */
+
+#ifndef VIS_HOUGH_H
+#define VIS_HOUGH_H
+
+#include "vision.h"
+
+#include <opencv.hpp>
+
+#include <vector>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @brief Detects the circles of the size of the ball in a grayscale image.
+ * @details Applies the gradient Hough transform. Circles may lie as close as two
+ *     minimum radii apart, so every ball and distractor in view is found, not only
+ *     the strongest one.
+ * @param[in] image Grayscale image.
+ * @param[in] minradius Minimum radius of the ball.
+ * @param[in] maxradius Maximum radius of the ball.
+ * @param[out] circles Centers and radii of the circles in image coordinates, by
+ *     decreasing votes. The buffer is kept between calls so the steady state does not
+ *     allocate it again.
+ */
+auto find_circles(cv::Mat const& image, int minradius, int maxradius,
+    std::vector<cv::Vec3f>& circles) -> void;
+
+} // namespace vis
+
+#endif
@@ -0,0 +1,180 @@
+/**
+ * @file       kernels.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation and instantiation of the specialized vision kernels.
+ */
+
+#include "kernels.h"
+
+#include "simd.h"
+#include "vision.h"
+
+#include <opencv.hpp>
+
+#include <algorithm>
+#include <array>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+namespace {
+
+/**
+ * @brief Averages the 2x2 quads of the source rows into a range of result rows, for an
+ *     image of any size.
+ * @details Produces the quad image of a Bayer mosaic as well as the levels of a pyramid.
+ */
+auto halve(uint8 const* source, int width, int first, int last, uint8* result) noexcept
+    -> void
+{
+    downsample(source + int64{2} * first * width, width, 2 * (last - first), width,
+        result + int64{first} * (width / 2), width / 2);
+}
+
+/**
+ * @brief Averages the 2x2 quads of the source rows into a range of result rows, for an
+ *     image of Width x Height pixels.
+ * @details Rows past the bottom of the result are ignored.
+ */
+template<int Width, int Height>
+auto halve(uint8 const* source, int, int first, int last, uint8* result) noexcept
+    -> void
+{
+    static_assert(Width % 2 == 0 and Height % 2 == 0, "quads require even sizes");
+    constexpr auto half = Width / 2;
+
+    last = std::min(last, Height / 2);
+    for (auto y = first; y < last; ++y) {
+        auto const* top = source + 2 * y * Width;
+        auto const* bottom = top + Width;
+        auto* dest = result + y * half;
+        int x{};
+#ifdef SIMD_SSE2
+        for (; x + 16 <= half; x += 16) {
+            auto const* t = reinterpret_cast<__m128i const*>(top + 2 * x);
+            auto const* b = reinterpret_cast<__m128i const*>(bottom + 2 * x);
+            auto const lo = simd::average_quads(_mm_loadu_si128(t),
+                _mm_loadu_si128(b));
+            auto const hi = simd::average_quads(_mm_loadu_si128(t + 1),
+                _mm_loadu_si128(b + 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x),
+                _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; x < half; ++x) {
+            dest[x] = static_cast<uint8>((top[2 * x] + top[2 * x + 1]
+                + bottom[2 * x] + bottom[2 * x + 1] + 2) >> 2);
+        }
+    }
+}
+
+/**
+ * @brief Converts a range of rows of a color frame to luminance.
+ * @tparam Code Conversion code of OpenCV for the channel order of the frame.
+ */
+template<int Code>
+auto luminance(uint8 const* source, int width, int first, int last, uint8* result)
+    noexcept -> void
+{
+    // Wrapping the rows in headers lets OpenCV write into the result in place.
+    auto const color = cv::Mat{last - first, width, CV_8UC3,
+        const_cast<uint8*>(source + int64{3} * first * width)};
+    auto gray = cv::Mat{last - first, width, CV_8UC1, result + int64{first} * width};
+    cv::cvtColor(color, gray, Code);
+}
+
+/**
+ * @brief Returns the gray kernel for frames of the given pixel format.
+ */
+constexpr auto gray_kernel(pixel_format format) noexcept -> row_kernel {
+    switch (format) {
+    case pixel_format::bayer: return &halve;
+    case pixel_format::bgr:   return &luminance<cv::COLOR_BGR2GRAY>;
+    case pixel_format::rgb:   return &luminance<cv::COLOR_RGB2GRAY>;
+    default:                  return nullptr;
+    }
+}
+
+/**
+ * @brief Instantiates the kernels for frames of Width x Height pixels of a format.
+ */
+template<int Width, int Height, pixel_format Format>
+constexpr auto specialize() noexcept -> frame_kernels {
+    // The quads of a Bayer mosaic halve the searched image.
+    constexpr auto bayer = Format == pixel_format::bayer;
+    constexpr auto width = bayer ? Width / 2 : Width;
+    constexpr auto height = bayer ? Height / 2 : Height;
+
+    auto kernels = frame_kernels{Width, Height, Format, gray_kernel(Format),
+        &halve<width, height>, &halve<width / 2, height / 2>};
+    if constexpr (bayer) {
+        kernels.gray = &halve<Width, Height>;
+    }
+    return kernels;
+}
+
+/**
+ * @brief Specializations for the resolutions of the camera, in every pixel format.
+ */
+constexpr auto registry = std::array{
+    specialize<640, 480, pixel_format::bayer>(),
+    specialize<640, 480, pixel_format::bgr>(),
+    specialize<640, 480, pixel_format::rgb>(),
+    specialize<640, 480, pixel_format::gray>(),
+    specialize<320, 240, pixel_format::bayer>(),
+    specialize<320, 240, pixel_format::bgr>(),
+    specialize<320, 240, pixel_format::rgb>(),
+    specialize<320, 240, pixel_format::gray>(),
+};
+
+} // namespace
+
+/**
+ * @copydoc to_string(pixel_format)
+ */
+auto to_string(pixel_format format) noexcept -> std::string_view {
+    switch (format) {
+    case pixel_format::bayer: return "bayer";
+    case pixel_format::bgr:   return "bgr";
+    case pixel_format::rgb:   return "rgb";
+    case pixel_format::gray:  return "gray";
+    }
+    return "unknown";
+}
+
+/**
+ * @copydoc generic_kernels
+ */
+auto generic_kernels(pixel_format format) noexcept -> frame_kernels {
+    return {0, 0, format, gray_kernel(format), &halve, &halve};
+}
+
+/**
+ * @copydoc find_kernels
+ */
+auto find_kernels(int index) noexcept -> frame_kernels const* {
+    if (index < 0 or index >= static_cast<int>(registry.size())) return nullptr;
+    return &registry[static_cast<std::size_t>(index)];
+}
+
+/**
+ * @copydoc select_kernels
+ */
+auto select_kernels(int width, int height, pixel_format format) noexcept
+    -> frame_kernels
+{
+    auto const match = std::ranges::find_if(registry, [&](frame_kernels const& k) {
+        return k.width == width and k.height == height and k.format == format;
+    });
+    return match != registry.end() ? *match : generic_kernels(format);
+}
+
+} // namespace vis
@@ -0,0 +1,110 @@
+/**
+ * @file       kernels.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Hot vision kernels specialized per frame resolution and pixel format.
+ */
+
+#ifndef VIS_KERNELS_H
+#define VIS_KERNELS_H
+
+#include "types.h"
+
+#include <string_view>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @enum pixel_format
+ * @brief Pixel format of the camera frames, in the order of the camera output formats.
+ */
+enum class pixel_format {
+    bayer, /**< Raw GRBG mosaic of one byte per pixel. */
+    bgr,   /**< Three bytes per pixel in blue, green and red order. */
+    rgb,   /**< Three bytes per pixel in red, green and blue order. */
+    gray   /**< One byte of luminance per pixel. */
+};
+
+/**
+ * @brief Returns the name of a pixel format.
+ */
+[[nodiscard]]
+auto to_string(pixel_format format) noexcept -> std::string_view;
+
+/**
+ * @typedef row_kernel
+ * @brief Produces a range of rows of an image from another image.
+ * @details Both images are stored without padding between their rows. The rows of the
+ *     result are independent of each other, so the range can be split into bands.
+ * @param[in] source Source image.
+ * @param[in] width Width of the source image.
+ * @param[in] first First row of the result to produce.
+ * @param[in] last Row past the last row of the result to produce.
+ * @param[out] result Resulting image.
+ */
+using row_kernel = auto(*)(uint8 const* source, int width, int first, int last,
+    uint8* result) noexcept -> void;
+
+/**
+ * @struct frame_kernels
+ * @brief Hot kernels of the vision stage for frames of one resolution and pixel format.
+ * @details The searched image is the quad image of a Bayer mosaic, the luminance of a
+ *     color frame and a gray frame itself. The gray kernel produces it from the frame,
+ *     and the half and quarter kernels build the pyramid on top of it.
+ *
+ *     A specialization knows the width and height of every image at compile time, so
+ *     its loops have constant bounds and strides that the compiler unrolls and
+ *     vectorizes. The generic kernels take the size at run time and serve every other
+ *     resolution. Color frames keep the vectorized conversion of OpenCV in either case.
+ */
+struct frame_kernels {
+    int width;           /**< Width of the frames, or 0 for the generic kernels. */
+    int height;          /**< Height of the frames, or 0 for the generic kernels. */
+    pixel_format format; /**< Pixel format of the frames. */
+    row_kernel gray;     /**< Produces the searched image, or null for gray frames. */
+    row_kernel half;     /**< Halves the searched image. */
+    row_kernel quarter;  /**< Halves the half-resolution image. */
+
+    /**
+     * @brief Returns whether the kernels are specialized for a resolution.
+     */
+    [[nodiscard]]
+    constexpr auto specialized() const noexcept -> bool
+    { return width > 0; }
+};
+
+/**
+ * @brief Returns the kernels that take the resolution at run time.
+ * @param[in] format Pixel format of the frames.
+ */
+[[nodiscard]]
+auto generic_kernels(pixel_format format) noexcept -> frame_kernels;
+
+/**
+ * @brief Returns a specialization by its index.
+ * @param[in] index Index of the specialization.
+ * @return If the index is instantiated, returns its kernels. Otherwise, returns nullptr.
+ */
+[[nodiscard]]
+auto find_kernels(int index) noexcept -> frame_kernels const*;
+
+/**
+ * @brief Selects the kernels for frames of the given resolution and pixel format.
+ * @return If a specialization is instantiated for the frames, returns it. Otherwise,
+ *     returns the generic kernels.
+ */
+[[nodiscard]]
+auto select_kernels(int width, int height, pixel_format format) noexcept
+    -> frame_kernels;
+
+} // namespace vis
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * @file       lens.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the lens calibration and undistortion.
+ */
+
+#include "lens.h"
+
+#include "vision.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @namespace cam
+ * @brief Camera related components.
+ */
+namespace cam {
+
+/**
+ * @copydoc undistort_map::undistort_map
+ */
+undistort_map::undistort_map(intrinsics const& lens, int width, int height, int step) {
+    if (lens.width <= 0 or width <= 0 or height <= 0) return;
+
+    step = std::max(step, 1);
+    columns_ = (width - 1) / step + 2;
+    rows_ = (height - 1) / step + 2;
+    scale_ = 1.f / step;
+
+    // Pixel centers lie half a pixel from the pixel edges that the scale applies to.
+    auto const s = static_cast<double>(width) / lens.width;
+    auto const camera = cv::Matx33d{
+        lens.fx * s, 0.0, (lens.cx + 0.5) * s - 0.5,
+        0.0, lens.fy * s, (lens.cy + 0.5) * s - 0.5,
+        0.0, 0.0, 1.0};
+    auto const distortion = cv::Mat{1, 5, CV_64F, const_cast<double*>(
+        lens.distortion.data())};
+
+    auto grid = std::vector<cv::Point2f>{};
+    grid.reserve(columns_ * rows_);
+    for (int r{}; r < rows_; ++r) {
+        for (int c{}; c < columns_; ++c) {
+            grid.emplace_back(static_cast<float>(c * step), static_cast<float>(r * step));
+        }
+    }
+    auto undistorted = std::vector<cv::Point2f>{};
+    cv::undistortPoints(grid, undistorted, camera, distortion, cv::noArray(), camera);
+
+    offsets_.resize(grid.size());
+    for (std::size_t i{}; i < grid.size(); ++i) {
+        offsets_[i] = {undistorted[i].x - grid[i].x, undistorted[i].y - grid[i].y};
+    }
+}
+
+/**
+ * @copydoc undistort_map::apply
+ */
+auto undistort_map::apply(point p) const noexcept -> point {
+    if (offsets_.empty()) return p;
+
+    auto const gx = std::clamp(p.x * scale_, 0.f, static_cast<float>(columns_ - 1));
+    auto const gy = std::clamp(p.y * scale_, 0.f, static_cast<float>(rows_ - 1));
+    auto const c = std::min(static_cast<int>(gx), columns_ - 2);
+    auto const r = std::min(static_cast<int>(gy), rows_ - 2);
+    auto const u = gx - c;
+    auto const v = gy - r;
+
+    auto const* const top = offsets_.data() + r * columns_ + c;
+    auto const* const bottom = top + columns_;
+    auto const lerp = [u, v](float tl, float tr, float bl, float br) {
+        return (tl + (tr - tl) * u) * (1.f - v) + (bl + (br - bl) * u) * v;
+    };
+    return {
+        p.x + lerp(top[0].x, top[1].x, bottom[0].x, bottom[1].x),
+        p.y + lerp(top[0].y, top[1].y, bottom[0].y, bottom[1].y)};
+}
+
+/**
+ * @copydoc lens_calibrator::lens_calibrator
+ */
+lens_calibrator::lens_calibrator(int columns, int rows, int views):
+    board_{std::max(columns, 2), std::max(rows, 2)},
+    required_{std::max(views, 1)}
+{
+    views_.reserve(required_);
+    corners_.reserve(board_.area());
+}
+
+/**
+ * @copydoc lens_calibrator::add
+ */
+auto lens_calibrator::add(cv::Mat const& image, int scale) -> bool {
+    if (done()) return false;
+    if (not cv::findChessboardCorners(image, board_, corners_,
+            cv::CALIB_CB_ADAPTIVE_THRESH | cv::CALIB_CB_NORMALIZE_IMAGE
+            | cv::CALIB_CB_FAST_CHECK)) return false;
+
+    cv::cornerSubPix(image, corners_, {5, 5}, {-1, -1}, {
+        cv::TermCriteria::EPS | cv::TermCriteria::COUNT, 30, 0.01});
+    if (scale == 2) {
+        for (auto& corner : corners_) {
+            corner = {vis::quad_to_frame(corner.x), vis::quad_to_frame(corner.y)};
+        }
+    }
+
+    if (not views_.empty()) {
+        auto moved = 0.0;
+        auto const& last = views_.back();
+        for (std::size_t i{}; i < corners_.size(); ++i) {
+            moved += std::hypot(corners_[i].x - last[i].x, corners_[i].y - last[i].y);
+        }
+        if (moved / corners_.size() < 0.1 * image.cols * scale) return false;
+    }
+    views_.push_back(corners_);
+    return true;
+}
+
+/**
+ * @copydoc lens_calibrator::solve
+ */
+auto lens_calibrator::solve(int width, int height) const -> lens_fit {
+    // The size of the squares only scales the extrinsics, so the board uses unit squares.
+    auto board = std::vector<cv::Point3f>{};
+    board.reserve(board_.area());
+    for (int r{}; r < board_.height; ++r) {
+        for (int c{}; c < board_.width; ++c) {
+            board.emplace_back(static_cast<float>(c), static_cast<float>(r), 0.f);
+        }
+    }
+    auto const boards = std::vector<std::vector<cv::Point3f>>(views_.size(), board);
+
+    auto camera = cv::Mat{};
+    auto distortion = cv::Mat{};
+    auto rotations = std::vector<cv::Mat>{};
+    auto translations = std::vector<cv::Mat>{};
+    auto const error = cv::calibrateCamera(boards, views_, {width, height}, camera,
+        distortion, rotations, translations);
+
+    auto fit = lens_fit{
+        .lens{
+            .width = width,
+            .fx = camera.at<double>(0, 0),
+            .fy = camera.at<double>(1, 1),
+            .cx = camera.at<double>(0, 2),
+            .cy = camera.at<double>(1, 2),
+            .distortion{}},
+        .error = error};
+    for (int i{}; i < std::min(static_cast<int>(distortion.total()), 5); ++i) {
+        fit.lens.distortion[i] = distortion.at<double>(i);
+    }
+    return fit;
+}
+
+} // namespace cam
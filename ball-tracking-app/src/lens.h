@@ -0,0 +1,169 @@
+/**
+ * @file       lens.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Intrinsic calibration and point-wise undistortion of the camera lens.
+ */
+
+#ifndef CAM_LENS_H
+#define CAM_LENS_H
+
+#include <opencv.hpp>
+
+#include <array>
+#include <vector>
+
+/**
+ * @namespace cam
+ * @brief Camera related components.
+ */
+namespace cam {
+
+/**
+ * @struct point
+ * @brief Position in pixel coordinates of the full-resolution frame.
+ */
+struct point {
+    float x; /**< Coordinate along the x-axis. */
+    float y; /**< Coordinate along the y-axis. */
+};
+
+/**
+ * @struct intrinsics
+ * @brief Pinhole model of the lens with radial and tangential distortion.
+ */
+struct intrinsics {
+    int width;                        /**< Frame width at calibration, or 0 if none. */
+    double fx;                        /**< Focal length along the x-axis in pixels. */
+    double fy;                        /**< Focal length along the y-axis in pixels. */
+    double cx;                        /**< Principal point along the x-axis. */
+    double cy;                        /**< Principal point along the y-axis. */
+    std::array<double, 5> distortion; /**< Coefficients k1, k2, p1, p2 and k3. */
+};
+
+/**
+ * @class undistort_map
+ * @brief Lookup table that undistorts individual points.
+ * @details Undistorting whole frames costs a remap of every pixel, while only a handful
+ *     of positions are needed per frame. The table holds the undistorted position of a
+ *     grid of frame positions, from which any point is interpolated bilinearly. The
+ *     undistorted positions are expressed in the same camera matrix, so they remain in
+ *     pixels and close to where they were. A default constructed map is the identity.
+ */
+class undistort_map {
+public:
+    /**
+     * @brief Default constructs the identity map.
+     */
+    undistort_map() = default;
+
+    /**
+     * @brief Precomputes the table for a frame size.
+     * @details Intrinsics calibrated at another frame width are scaled to the frame.
+     *     Uncalibrated intrinsics result in the identity map.
+     * @param[in] lens Intrinsics of the lens.
+     * @param[in] width Width of the frames.
+     * @param[in] height Height of the frames.
+     * @param[in] step Distance in pixels between the grid positions. Defaulted to 8.
+     */
+    undistort_map(intrinsics const& lens, int width, int height, int step = 8);
+
+    /**
+     * @brief Returns the undistorted position of a point in the frame.
+     * @details Points outside the frame take the correction of the nearest border.
+     * @param[in] p Distorted position.
+     */
+    [[nodiscard]]
+    auto apply(point p) const noexcept -> point;
+
+    /**
+     * @brief Returns whether the map is the identity.
+     */
+    [[nodiscard]]
+    auto empty() const noexcept -> bool
+    { return offsets_.empty(); }
+
+private:
+    std::vector<point> offsets_; /**< Correction at every grid position. */
+    int columns_{};              /**< Number of grid positions per row. */
+    int rows_{};                 /**< Number of grid positions per column. */
+    float scale_{};              /**< Reciprocal of the grid step. */
+};
+
+/**
+ * @struct lens_fit
+ * @brief Outcome of an intrinsic calibration.
+ */
+struct lens_fit {
+    intrinsics lens; /**< Calibrated intrinsics. */
+    double error;    /**< Root mean square reprojection error in pixels. */
+};
+
+/**
+ * @class lens_calibrator
+ * @brief Collects views of a checkerboard and calibrates the intrinsics from them.
+ * @details A view is only taken once the board has moved a tenth of the frame since the
+ *     last view, so that holding it still does not fill the calibration with duplicates.
+ */
+class lens_calibrator {
+public:
+    /**
+     * @brief Default constructs a calibrator that needs no views.
+     */
+    lens_calibrator() = default;
+
+    /**
+     * @brief Constructs a calibrator for a checkerboard.
+     * @param[in] columns Number of inner corners along a row of the board.
+     * @param[in] rows Number of inner corners along a column of the board.
+     * @param[in] views Number of views to collect.
+     */
+    lens_calibrator(int columns, int rows, int views);
+
+    /**
+     * @brief Looks for the board in a grayscale image and takes it as a view if found.
+     * @details The search rejects images without a board quickly, so it can run on
+     *     every frame while the board is being moved into view.
+     * @param[in] image Grayscale image of the frame.
+     * @param[in] scale Scale of the full-resolution frame relative to the image, being
+     *     either 1 or 2 for a half-resolution quad image.
+     * @return If a view was taken, returns true. Otherwise, returns false.
+     */
+    auto add(cv::Mat const& image, int scale) -> bool;
+
+    /**
+     * @brief Calibrates the intrinsics from the collected views.
+     * @param[in] width Width of the full-resolution frame.
+     * @param[in] height Height of the full-resolution frame.
+     */
+    [[nodiscard]]
+    auto solve(int width, int height) const -> lens_fit;
+
+    /**
+     * @brief Returns the number of collected views.
+     */
+    [[nodiscard]]
+    auto views() const noexcept -> int
+    { return static_cast<int>(views_.size()); }
+
+    /**
+     * @brief Returns whether enough views have been collected.
+     */
+    [[nodiscard]]
+    auto done() const noexcept -> bool
+    { return views() >= required_; }
+
+private:
+    cv::Size board_{};                            /**< Inner corners of the board. */
+    int required_{};                              /**< Number of views to collect. */
+    std::vector<std::vector<cv::Point2f>> views_; /**< Corners of the collected views. */
+    std::vector<cv::Point2f> corners_;            /**< Corners of the current frame. */
+};
+
+} // namespace cam
+
+#endif
@@ -0,0 +1,290 @@
+/**
+ * @file       ncc.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the template tracker.
+ */
+
+#include "ncc.h"
+
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <span>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+namespace {
+
+/**
+ * @brief Number of products beyond which the correlation is left to OpenCV.
+ */
+constexpr auto maxproducts = int64{1} << 23;
+
+/**
+ * @brief Returns the dot product of a row of pixels and a row of the template.
+ */
+inline auto dot(uint8 const* pixels, int16 const* weights, int count) noexcept -> int32 {
+    auto sum = int32{};
+    int i{};
+#ifdef SIMD_SSE2
+    auto const zero = _mm_setzero_si128();
+    auto lanes = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        auto const p = _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<__m128i const*>(pixels + i)), zero);
+        auto const w = _mm_loadu_si128(reinterpret_cast<__m128i const*>(weights + i));
+        lanes = _mm_add_epi32(lanes, _mm_madd_epi16(p, w));
+    }
+    lanes = _mm_add_epi32(lanes, _mm_shuffle_epi32(lanes, _MM_SHUFFLE(1, 0, 3, 2)));
+    lanes = _mm_add_epi32(lanes, _mm_shuffle_epi32(lanes, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32(lanes);
+#endif
+    for (; i < count; ++i) {
+        sum += pixels[i] * weights[i];
+    }
+    return sum;
+}
+
+/**
+ * @brief Returns the offset of the top of a parabola through three samples.
+ */
+inline auto vertex(float before, float at, float after) noexcept -> float {
+    auto const curvature = before - 2.f * at + after;
+    if (curvature >= 0.f) return 0.f;
+    return std::clamp(0.5f * (before - after) / curvature, -0.5f, 0.5f);
+}
+
+} // namespace
+
+/**
+ * @copydoc template_tracker::template_tracker
+ */
+template_tracker::template_tracker(int width, int height):
+    maxwidth_{width},
+    model_((2 * maxhalf + 1) * (2 * maxhalf + 1)),
+    zeromean_(model_.size()),
+    sums_(static_cast<std::size_t>(width + 1) * (height + 1)),
+    squares_(sums_.size()),
+    scores_(static_cast<std::size_t>(width) * height)
+{}
+
+/**
+ * @copydoc template_tracker::learn
+ */
+auto template_tracker::learn(uint8 const* image, int stride, int width, int height,
+    blob const& ball) -> bool
+{
+    forget();
+    // Some of the plate around the ball keeps its outline in the template.
+    auto const radius = static_cast<int>(std::ceil(ball.radius));
+    auto const half = std::clamp(radius + std::max(radius / 4, 2), 2, maxhalf);
+    auto const side = 2 * half + 1;
+    auto const x0 = static_cast<int>(std::lround(ball.x)) - half;
+    auto const y0 = static_cast<int>(std::lround(ball.y)) - half;
+    if (x0 < 0 or y0 < 0 or x0 + side > std::min(width, maxwidth_) or y0 + side > height
+        or sums_.empty()) return false;
+
+    side_ = side;
+    imagewidth_ = width;
+    imageheight_ = height;
+    centerx_ = ball.x - x0;
+    centery_ = ball.y - y0;
+    radius_ = ball.radius;
+    for (int y{}; y < side; ++y) {
+        auto const* const row = image + static_cast<std::ptrdiff_t>(y0 + y) * stride + x0;
+        std::copy(row, row + side, model_.begin() + y * side);
+    }
+    if (not prepare()) {
+        forget();
+        return false;
+    }
+    last_ = ball;
+    matches_ = 1;
+    return true;
+}
+
+/**
+ * @copydoc template_tracker::track
+ */
+auto template_tracker::track(uint8 const* image, int stride, region roi,
+    template_settings const& settings, par::worker_pool& pool) -> std::optional<candidate>
+{
+    score_ = 0.f;
+    if (side_ == 0) return std::nullopt;
+
+    // The ball keeps its velocity between two frames.
+    auto predicted = last_;
+    if (matches_ > 1) {
+        predicted.x += last_.x - previous_.x;
+        predicted.y += last_.y - previous_.y;
+    }
+    auto const left = static_cast<int>(std::lround(predicted.x - centerx_));
+    auto const top = static_cast<int>(std::lround(predicted.y - centery_));
+    auto const reach = std::max(settings.searchradius, 1);
+    auto const x0 = std::max(left - reach, roi.x);
+    auto const y0 = std::max(top - reach, roi.y);
+    auto const x1 = std::min(left + reach, roi.x + roi.width - side_);
+    auto const y1 = std::min(top + reach, roi.y + roi.height - side_);
+    if (x1 < x0 or y1 < y0) {
+        matches_ = 0;
+        return std::nullopt;
+    }
+    auto const columns = x1 - x0 + 1;
+    auto const rows = y1 - y0 + 1;
+    auto const area = region{x0, y0, columns + side_ - 1, rows + side_ - 1};
+
+    if (int64{columns} * rows * side_ * side_ > maxproducts) {
+        auto const source = cv::Mat(area.height, area.width, CV_8UC1,
+            const_cast<uint8*>(image + static_cast<std::ptrdiff_t>(y0) * stride + x0),
+            static_cast<std::size_t>(stride));
+        cv::matchTemplate(source, patch_, response_, cv::TM_CCOEFF_NORMED);
+        for (int y{}; y < rows; ++y) {
+            auto const* const row = response_.ptr<float>(y);
+            std::copy(row, row + columns, scores_.begin() + y * columns);
+        }
+    } else {
+        auto const width = area.width + 1;
+        std::fill_n(sums_.begin(), width, 0);
+        std::fill_n(squares_.begin(), width, 0);
+        for (int y{}; y < area.height; ++y) {
+            auto const* const row = image + static_cast<std::ptrdiff_t>(y0 + y) * stride
+                + x0;
+            auto* const sum = sums_.data() + (y + 1) * width;
+            auto* const square = squares_.data() + (y + 1) * width;
+            auto rowsum = int32{};
+            auto rowsquare = int64{};
+            sum[0] = 0;
+            square[0] = 0;
+            for (int x{}; x < area.width; ++x) {
+                rowsum += row[x];
+                rowsquare += row[x] * row[x];
+                sum[x + 1] = sum[x + 1 - width] + rowsum;
+                square[x + 1] = square[x + 1 - width] + rowsquare;
+            }
+        }
+        // Every position takes a product per pixel of the template.
+        pool.for_bands(0, rows, pool.bands(columns * side_, rows * side_),
+            [&](int, int first, int last) {
+                correlate(image, stride, area, first, last);
+            });
+    }
+
+    auto const scores = std::span{scores_.data(),
+        static_cast<std::size_t>(columns) * rows};
+    auto const best = static_cast<int>(std::ranges::max_element(scores) - scores.begin());
+    auto const u = best % columns;
+    auto const v = best / columns;
+    score_ = scores[best];
+    // A peak on the border of the searched positions may well lie beyond them, where
+    // the template no longer fits within the region or the search did not reach.
+    auto const border = u == 0 or v == 0 or u + 1 == columns or v + 1 == rows;
+    if (score_ < settings.minscore or border) {
+        matches_ = 0;
+        return std::nullopt;
+    }
+
+    auto const at = [&](int x, int y) { return scores[y * columns + x]; };
+    auto const dx = vertex(at(u - 1, v), score_, at(u + 1, v));
+    auto const dy = vertex(at(u, v - 1), score_, at(u, v + 1));
+    auto const ball = blob{x0 + u + dx + centerx_, y0 + v + dy + centery_, radius_};
+
+    if (score_ >= settings.learnscore) {
+        for (int y{}; y < side_; ++y) {
+            auto const* const row = image
+                + static_cast<std::ptrdiff_t>(y0 + v + y) * stride + x0 + u;
+            auto* const model = model_.data() + y * side_;
+            for (int x{}; x < side_; ++x) {
+                model[x] += settings.rate * (row[x] - model[x]);
+            }
+        }
+        static_cast<void>(prepare());
+    }
+    previous_ = last_;
+    last_ = ball;
+    matches_ = std::min(matches_ + 1, 2);
+    return candidate{.ball = ball, .confidence = score_};
+}
+
+/**
+ * @copydoc template_tracker::forget
+ */
+auto template_tracker::forget() noexcept -> void {
+    side_ = 0;
+    matches_ = 0;
+    score_ = 0.f;
+}
+
+/**
+ * @copydoc template_tracker::correlate
+ */
+auto template_tracker::correlate(uint8 const* image, int stride, region area, int first,
+    int last) noexcept -> void
+{
+    auto const count = static_cast<double>(side_) * side_;
+    auto const width = area.width + 1;
+    auto const columns = area.width - side_ + 1;
+    for (int v{first}; v < last; ++v) {
+        auto const* const top = image + static_cast<std::ptrdiff_t>(area.y + v) * stride
+            + area.x;
+        for (int u{}; u < columns; ++u) {
+            auto const a = v * width + u;
+            auto const b = (v + side_) * width + u;
+            auto const sum = static_cast<double>(
+                sums_[b + side_] - sums_[a + side_] - sums_[b] + sums_[a]);
+            auto const square = static_cast<double>(
+                squares_[b + side_] - squares_[a + side_] - squares_[b] + squares_[a]);
+            auto const variance = square - sum * sum / count;
+
+            auto product = int64{};
+            for (int y{}; y < side_; ++y) {
+                product += dot(top + static_cast<std::ptrdiff_t>(y) * stride + u,
+                    zeromean_.data() + y * side_, side_);
+            }
+            // The template is rounded to integers, so its sum is not exactly zero.
+            auto const covariance = product - sum * sum_ / count;
+            scores_[v * columns + u] = variance > 1.0
+                ? static_cast<float>(covariance / (norm_ * std::sqrt(variance))) : 0.f;
+        }
+    }
+}
+
+/**
+ * @copydoc template_tracker::prepare
+ */
+auto template_tracker::prepare() -> bool {
+    auto const count = side_ * side_;
+    auto mean = 0.0;
+    for (int i{}; i < count; ++i) {
+        mean += model_[i];
+    }
+    mean /= count;
+
+    sum_ = 0;
+    auto squares = int64{};
+    patch_.create(side_, side_, CV_8UC1);
+    for (int i{}; i < count; ++i) {
+        auto const weight = static_cast<int16>(std::lround(model_[i] - mean));
+        zeromean_[i] = weight;
+        sum_ += weight;
+        squares += weight * weight;
+        patch_.ptr(i / side_)[i % side_] = static_cast<uint8>(
+            std::clamp(std::lround(model_[i]), 0L, 255L));
+    }
+    auto const variance = static_cast<double>(squares)
+        - static_cast<double>(sum_) * sum_ / count;
+    norm_ = std::sqrt(std::max(variance, 0.0));
+    return variance > 1.0;
+}
+
+} // namespace vis
@@ -0,0 +1,169 @@
+/**
+ * @file       ncc.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Template tracker based on normalized cross-correlation.
+ */
+
+#ifndef VIS_NCC_H
+#define VIS_NCC_H
+
+#include "blob.h"
+#include "pool.h"
+#include "types.h"
+
+#include <opencv.hpp>
+
+#include <optional>
+#include <vector>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @struct template_settings
+ * @brief Parameters of the template tracker.
+ */
+struct template_settings {
+    int searchradius; /**< Distance around the predicted position to search. */
+    float minscore;   /**< Minimum correlation of a match. */
+    float learnscore; /**< Minimum correlation of a match to update the template with. */
+    float rate;       /**< Share of a match that is blended into the template. */
+};
+
+/**
+ * @class template_tracker
+ * @brief Tracks the ball by its appearance rather than by its edges.
+ * @details The template is a square patch around the ball, learned from a detection
+ *     when the ball is acquired. Every frame, the template is correlated with the image
+ *     around the position predicted from the last two matches. The correlation is
+ *     normalized by the mean and contrast of every patch that it is compared with, so
+ *     glare, a change of exposure or a weak contrast with the plate lower the score far
+ *     less than they weaken the edges that the circle detectors rely on.
+ *
+ *     The means and contrasts of all patches come from integral images of the searched
+ *     area, so only the dot products with the zero-mean template remain, which are
+ *     computed on 16-bit integers with SSE2. Once the number of products grows beyond a
+ *     limit, for a large ball or a wide search, the correlation is left to OpenCV, which
+ *     switches to the DFT for large templates. A good match is slowly blended into the
+ *     template, so it follows gradual changes of lighting without drifting off the ball
+ *     on a single bad frame.
+ */
+class template_tracker {
+public:
+    /**
+     * @brief Default constructs a tracker without buffers.
+     */
+    template_tracker() = default;
+
+    /**
+     * @brief Constructs a tracker for frames up to the given size.
+     * @param[in] width Maximum width of the frames.
+     * @param[in] height Maximum height of the frames.
+     */
+    template_tracker(int width, int height);
+
+    /**
+     * @brief Learns the template from a detected ball, replacing any earlier one.
+     * @param[in] image Grayscale image.
+     * @param[in] stride Number of bytes between the starts of two consecutive rows.
+     * @param[in] width Width of the image.
+     * @param[in] height Height of the image.
+     * @param[in] ball Detected ball in image coordinates.
+     * @return If the template fits within the image and has any contrast, returns true.
+     *     Otherwise, returns false and the tracker holds no template.
+     */
+    auto learn(uint8 const* image, int stride, int width, int height, blob const& ball)
+        -> bool;
+
+    /**
+     * @brief Finds the template around its predicted position within a region.
+     * @param[in] image Grayscale image of the size that the template was learned from.
+     * @param[in] stride Number of bytes between the starts of two consecutive rows.
+     * @param[in] roi Region of the image to search, required to fit within the image.
+     * @param[in] settings Parameters of the tracker.
+     * @param[in] pool Workers to correlate the bands of the searched area on.
+     * @return If the best match scores high enough, returns the ball with the score as
+     *     confidence. Otherwise, returns std::nullopt.
+     */
+    [[nodiscard]]
+    auto track(uint8 const* image, int stride, region roi,
+        template_settings const& settings, par::worker_pool& pool)
+        -> std::optional<candidate>;
+
+    /**
+     * @brief Discards the template.
+     */
+    auto forget() noexcept -> void;
+
+    /**
+     * @brief Returns whether the tracker holds a template.
+     */
+    [[nodiscard]]
+    constexpr auto learned() const noexcept -> bool
+    { return side_ > 0; }
+
+    /**
+     * @brief Returns whether the template was learned from an image of the given size.
+     */
+    [[nodiscard]]
+    constexpr auto learned_at(int width, int height) const noexcept -> bool
+    { return learned() and width == imagewidth_ and height == imageheight_; }
+
+    /**
+     * @brief Returns the score of the last match.
+     */
+    [[nodiscard]]
+    constexpr auto score() const noexcept -> float
+    { return score_; }
+
+    /**
+     * @brief Largest distance between the center of the template and its edge.
+     */
+    static constexpr auto maxhalf = 80;
+
+private:
+    /**
+     * @brief Correlates the template with every position of a band of rows.
+     */
+    auto correlate(uint8 const* image, int stride, region area, int first, int last)
+        noexcept -> void;
+
+    /**
+     * @brief Derives the zero-mean template and its norm from the learned model.
+     * @return If the template has any contrast, returns true. Otherwise, returns false.
+     */
+    auto prepare() -> bool;
+
+    int maxwidth_{};              /**< Maximum width of the frames. */
+    int imagewidth_{};            /**< Width of the image the template belongs to. */
+    int imageheight_{};           /**< Height of the image the template belongs to. */
+    int side_{};                  /**< Width and height of the template. */
+    float centerx_{};             /**< Column of the ball within the template. */
+    float centery_{};             /**< Row of the ball within the template. */
+    float radius_{};              /**< Radius of the ball. */
+    std::vector<float> model_;    /**< Slowly updated appearance of the ball. */
+    std::vector<int16> zeromean_; /**< Template minus its mean. */
+    int64 sum_{};                 /**< Sum of the zero-mean template. */
+    double norm_{};               /**< Norm of the zero-mean template. */
+    cv::Mat patch_;               /**< Template as an image, for the DFT correlation. */
+    cv::Mat response_;            /**< Scores of the DFT correlation. */
+    std::vector<int32> sums_;     /**< Integral image of the searched area. */
+    std::vector<int64> squares_;  /**< Integral image of the squares of the area. */
+    std::vector<float> scores_;   /**< Score of every position of the searched area. */
+    blob last_{};                 /**< Ball of the last match. */
+    blob previous_{};             /**< Ball of the match before the last one. */
+    int matches_{};               /**< Consecutive matches, up to two. */
+    float score_{};               /**< Score of the last match. */
+};
+
+} // namespace vis
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ * @file       plate.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the plate mask.
+ */
+
+#include "plate.h"
+
+#include <cmath>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @copydoc circumcircle
+ */
+auto circumcircle(cv::Point2f a, cv::Point2f b, cv::Point2f c) noexcept
+    -> std::optional<cv::Vec3f>
+{
+    auto const d = 2.0 * (static_cast<double>(a.x) * (b.y - c.y)
+        + static_cast<double>(b.x) * (c.y - a.y)
+        + static_cast<double>(c.x) * (a.y - b.y));
+    if (std::abs(d) < 1.0) return std::nullopt;
+    auto const aa = static_cast<double>(a.dot(a));
+    auto const bb = static_cast<double>(b.dot(b));
+    auto const cc = static_cast<double>(c.dot(c));
+    auto const x = (aa * (b.y - c.y) + bb * (c.y - a.y) + cc * (a.y - b.y)) / d;
+    auto const y = (aa * (c.x - b.x) + bb * (a.x - c.x) + cc * (b.x - a.x)) / d;
+    auto const radius = std::hypot(a.x - x, a.y - y);
+    return cv::Vec3f{static_cast<float>(x), static_cast<float>(y),
+        static_cast<float>(radius)};
+}
+
+/**
+ * @copydoc plate_mask::plate_mask(int, int)
+ */
+plate_mask::plate_mask(int width, int height):
+    rows_(std::max(height, 0), row_span{0, std::max(width, 0)})
+{
+    measure(width);
+}
+
+/**
+ * @copydoc plate_mask::plate_mask(int, int, cv::Vec3f, float)
+ */
+plate_mask::plate_mask(int width, int height, cv::Vec3f circle, float margin):
+    plate_mask{width, height}
+{
+    auto const x = static_cast<double>(circle[0]);
+    auto const y = static_cast<double>(circle[1]);
+    auto const radius = static_cast<double>(circle[2]) + margin;
+    if (radius <= 0.0) return;
+
+    auto const limit = static_cast<double>(width);
+    for (int row{}; row < std::ssize(rows_); ++row) {
+        auto const dy = row - y;
+        if (std::abs(dy) > radius) {
+            rows_[row] = row_span{};
+            continue;
+        }
+        auto const half = std::sqrt(radius * radius - dy * dy);
+        rows_[row] = row_span{
+            static_cast<int>(std::clamp(std::ceil(x - half), 0.0, limit)),
+            static_cast<int>(std::clamp(std::floor(x + half) + 1.0, 0.0, limit))};
+    }
+    measure(width);
+    if (bounds_.empty()) {
+        *this = plate_mask{width, height};
+    }
+}
+
+/**
+ * @copydoc plate_mask::clip
+ */
+auto plate_mask::clip(region roi) const noexcept -> region {
+    auto const x0 = std::max(roi.x, bounds_.x);
+    auto const y0 = std::max(roi.y, bounds_.y);
+    auto const x1 = std::min(roi.x + roi.width, bounds_.x + bounds_.width);
+    auto const y1 = std::min(roi.y + roi.height, bounds_.y + bounds_.height);
+    return {x0, y0, std::max(x1 - x0, 0), std::max(y1 - y0, 0)};
+}
+
+/**
+ * @copydoc plate_mask::measure
+ */
+auto plate_mask::measure(int width) -> void {
+    auto left = width;
+    auto right = 0;
+    auto top = -1;
+    auto bottom = -1;
+    auto pixels = 0.0;
+    for (int y{}; y < std::ssize(rows_); ++y) {
+        auto const& row = rows_[y];
+        if (row.empty()) continue;
+        left = std::min(left, row.first);
+        right = std::max(right, row.last);
+        if (top < 0) top = y;
+        bottom = y;
+        pixels += row.last - row.first;
+    }
+    bounds_ = top < 0 ? region{} : region{left, top, right - left, bottom - top + 1};
+    auto const area = static_cast<double>(width) * rows_.size();
+    coverage_ = area > 0.0 ? pixels / area : 0.0;
+}
+
+} // namespace vis
@@ -0,0 +1,137 @@
+/**
+ * @file       plate.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Mask of the plate region that the ball can be found in.
+ */
+
+#ifndef VIS_PLATE_H
+#define VIS_PLATE_H
+
+#include "blob.h"
+
+#include <opencv.hpp>
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @struct row_span
+ * @brief Range of columns within a single row.
+ */
+struct row_span {
+    int first; /**< First column of the span. */
+    int last;  /**< Column past the last column of the span. */
+
+    /**
+     * @brief Returns whether the span contains no columns.
+     */
+    [[nodiscard]]
+    constexpr auto empty() const noexcept -> bool
+    { return last <= first; }
+};
+
+/**
+ * @brief Returns the circle through three points, as its center and radius.
+ * @return If the points are not collinear, returns the circle. Otherwise, returns none.
+ */
+[[nodiscard]]
+auto circumcircle(cv::Point2f a, cv::Point2f b, cv::Point2f c) noexcept
+    -> std::optional<cv::Vec3f>;
+
+/**
+ * @class plate_mask
+ * @brief Columns of every image row that lie on the plate.
+ * @details The plate is a circle, so every row crosses it in at most a single span of
+ *     columns. Vision passes intersect the columns they would visit with the span of
+ *     the row, which skips the rig and the background around the plate at the cost of
+ *     a comparison per row. A mask without a shape covers the whole image.
+ *
+ *     The round plate is taken to be the circle through the three calibrated servo
+ *     points, grown by a margin. This only holds when the points were clicked on a
+ *     circle around the center of the plate. Points clicked further inward leave the
+ *     rim outside of the mask, unless the margin covers the difference, and the ball is
+ *     never found outside of the mask.
+ */
+class plate_mask {
+public:
+    /**
+     * @brief Default constructs an empty mask.
+     */
+    plate_mask() = default;
+
+    /**
+     * @brief Constructs a mask that covers the whole image.
+     * @param[in] width Width of the image.
+     * @param[in] height Height of the image.
+     */
+    plate_mask(int width, int height);
+
+    /**
+     * @brief Constructs a mask of a circle, grown by a margin.
+     * @details A pixel is on the plate if its center lies within the grown circle. A
+     *     circle outside of the image results in a mask that covers the whole image.
+     * @param[in] width Width of the image.
+     * @param[in] height Height of the image.
+     * @param[in] circle Center and radius of the circle in image coordinates.
+     * @param[in] margin Distance in pixels to grow the circle by.
+     */
+    plate_mask(int width, int height, cv::Vec3f circle, float margin);
+
+    /**
+     * @brief Returns the columns of a row that lie on the plate, within a range.
+     * @param[in] y Row of the image.
+     * @param[in] first First column of the range.
+     * @param[in] last Column past the last column of the range.
+     */
+    [[nodiscard]]
+    auto columns(int y, int first, int last) const noexcept -> row_span {
+        auto const& row = rows_[y];
+        return {std::max(first, row.first), std::min(last, row.last)};
+    }
+
+    /**
+     * @brief Returns the intersection of a region with the bounding box of the plate.
+     */
+    [[nodiscard]]
+    auto clip(region roi) const noexcept -> region;
+
+    /**
+     * @brief Returns the bounding box of the plate.
+     */
+    [[nodiscard]]
+    constexpr auto bounds() const noexcept -> region
+    { return bounds_; }
+
+    /**
+     * @brief Returns the fraction of the image that lies on the plate.
+     */
+    [[nodiscard]]
+    constexpr auto coverage() const noexcept -> double
+    { return coverage_; }
+
+private:
+    /**
+     * @brief Computes the bounding box and coverage of the spans.
+     */
+    auto measure(int width) -> void;
+
+    std::vector<row_span> rows_; /**< Span of the plate per row. */
+    region bounds_{};            /**< Bounding box of the plate. */
+    double coverage_{};          /**< Fraction of the image on the plate. */
+};
+
+} // namespace vis
+
+#endif
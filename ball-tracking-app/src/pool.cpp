@@ -0,0 +1,217 @@
+/**
+ * @file       pool.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the worker pool.
+ */
+
+#include "pool.h"
+
+#include <algorithm>
+
+/**
+ * @namespace par
+ * @brief Parallel execution related components.
+ */
+namespace par {
+
+namespace {
+
+/**
+ * @brief Number of rounds that an idle worker looks for jobs before it sleeps.
+ */
+constexpr auto spins = 64;
+
+/**
+ * @brief Pool that the calling thread is a worker of, if any.
+ */
+thread_local worker_pool const* owner{};
+
+/**
+ * @brief Index of the deque of the calling thread within the pool that owns it.
+ */
+thread_local std::size_t slot{};
+
+/**
+ * @brief Deque that the calling thread steals from next, which spreads the thieves.
+ */
+thread_local std::size_t victim{};
+
+} // namespace
+
+/**
+ * @copydoc job_deque::push
+ */
+auto job_deque::push(job* forked) noexcept -> bool {
+    auto const bottom = bottom_.load(std::memory_order_relaxed);
+    auto const top = top_.load(std::memory_order_acquire);
+    if (bottom - top >= static_cast<int64>(capacity)) return false;
+    slots_[bottom % capacity].store(forked, std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_seq_cst);
+    return true;
+}
+
+/**
+ * @copydoc job_deque::pop
+ */
+auto job_deque::pop() noexcept -> job* {
+    // Claiming the bottom before reading the top settles any race with a thief on the
+    // compare-and-swap of the top below.
+    auto const bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(bottom, std::memory_order_seq_cst);
+    auto top = top_.load(std::memory_order_seq_cst);
+    if (top > bottom) {
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    auto* forked = slots_[bottom % capacity].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        if (not top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                std::memory_order_relaxed)) {
+            forked = nullptr;
+        }
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return forked;
+}
+
+/**
+ * @copydoc job_deque::steal
+ */
+auto job_deque::steal() noexcept -> job* {
+    auto top = top_.load(std::memory_order_seq_cst);
+    auto const bottom = bottom_.load(std::memory_order_seq_cst);
+    if (top >= bottom) return nullptr;
+    auto* const forked = slots_[top % capacity].load(std::memory_order_acquire);
+    if (not top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+            std::memory_order_relaxed)) return nullptr;
+    return forked;
+}
+
+/**
+ * @copydoc worker_pool::worker_pool(int, thread_settings const&)
+ */
+worker_pool::worker_pool(int threads, thread_settings const& settings) {
+    if (threads <= 0) {
+        threads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    }
+    threads_ = static_cast<std::size_t>(threads);
+    deques_ = std::make_unique<job_deque[]>(threads_);
+    workers_.reserve(threads_ - 1);
+    for (std::size_t i{1}; i < threads_; ++i) {
+        workers_.emplace_back([this, settings, i](std::stop_token stop) {
+            static_cast<void>(schedule_thread(settings));
+            work(stop, i);
+        });
+    }
+}
+
+/**
+ * @copydoc worker_pool::~worker_pool
+ */
+worker_pool::~worker_pool() {
+    for (auto& worker : workers_) {
+        worker.request_stop();
+    }
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    epoch_.notify_all();
+    // Joins before the deques go out of scope.
+    workers_.clear();
+}
+
+/**
+ * @copydoc worker_pool::bands
+ */
+auto worker_pool::bands(int width, int height) const noexcept -> int {
+    auto const pixels = int64{std::max(width, 0)} * std::max(height, 0);
+    return static_cast<int>(std::clamp<int64>(pixels / grain, 1,
+        std::min(size(), std::max(height, 1))));
+}
+
+/**
+ * @copydoc worker_pool::fork
+ */
+auto worker_pool::fork(job& forked) noexcept -> bool {
+    if (not deques_[local()].push(&forked)) return false;
+    // A worker that is about to sleep either sees the new epoch or is counted.
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+        epoch_.notify_one();
+    }
+    return true;
+}
+
+/**
+ * @copydoc worker_pool::join
+ */
+auto worker_pool::join(job& forked) noexcept -> void {
+    auto const index = local();
+    // Every job forked after this one was joined already, so it is the newest one left,
+    // unless a thief took it.
+    if (deques_[index].pop() == &forked) {
+        forked.invoke(forked.task);
+        return;
+    }
+    while (not forked.done.load(std::memory_order_acquire)) {
+        if (auto* const other = steal(index)) {
+            other->invoke(other->task);
+            other->done.store(true, std::memory_order_release);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/**
+ * @copydoc worker_pool::steal
+ */
+auto worker_pool::steal(std::size_t thief) noexcept -> job* {
+    for (std::size_t i{}; i < threads_; ++i) {
+        auto const index = victim++ % threads_;
+        if (index == thief) continue;
+        if (auto* const forked = deques_[index].steal()) return forked;
+    }
+    return nullptr;
+}
+
+/**
+ * @copydoc worker_pool::local
+ */
+auto worker_pool::local() const noexcept -> std::size_t {
+    return owner == this ? slot : 0;
+}
+
+/**
+ * @copydoc worker_pool::work
+ */
+auto worker_pool::work(std::stop_token stop, std::size_t index) -> void {
+    owner = this;
+    slot = index;
+    victim = index + 1;
+    auto idle = 0;
+    while (true) {
+        auto const epoch = epoch_.load(std::memory_order_seq_cst);
+        if (stop.stop_requested()) return;
+        if (auto* const forked = steal(index)) {
+            forked->invoke(forked->task);
+            // The forking thread may release the job as soon as it is done.
+            forked->done.store(true, std::memory_order_release);
+            idle = 0;
+            continue;
+        }
+        if (++idle < spins) {
+            std::this_thread::yield();
+            continue;
+        }
+        idle = 0;
+        sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        epoch_.wait(epoch, std::memory_order_seq_cst);
+        sleepers_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+}
+
+} // namespace par
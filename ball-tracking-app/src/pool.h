@@ -0,0 +1,263 @@
+/**
+ * @file       pool.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Persistent pool of worker threads for data-parallel vision passes.
+ */
+
+#ifndef PAR_POOL_H
+#define PAR_POOL_H
+
+#include "realtime.h"
+#include "types.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @namespace par
+ * @brief Parallel execution related components.
+ */
+namespace par {
+
+/**
+ * @struct job
+ * @brief Forked task that any thread of a pool may execute.
+ * @details Lives on the stack of the thread that forked it, until it is joined.
+ */
+struct job {
+    void* task;               /**< Callable to execute. */
+    void (*invoke)(void*);    /**< Type-erased call of the callable. */
+    std::atomic<bool> done{}; /**< Whether a thief finished the job. */
+};
+
+/**
+ * @class job_deque
+ * @brief Bounded work-stealing deque of a single thread.
+ * @details The owner pushes and pops jobs at the bottom, while any other thread steals
+ *     them from the top, after Chase and Lev. The jobs are kept by address in a fixed
+ *     ring, so neither side allocates or locks, and only a race for the last job costs
+ *     a compare-and-swap.
+ */
+class job_deque {
+public:
+    /**
+     * @brief Maximum number of jobs, which bounds the nesting of forks.
+     */
+    static constexpr auto capacity = std::size_t{256};
+
+    /**
+     * @brief Appends a job at the bottom, unless the deque is full.
+     * @details Only to be called by the owner.
+     * @return If the job was appended, returns true. Otherwise, returns false.
+     */
+    auto push(job* forked) noexcept -> bool;
+
+    /**
+     * @brief Removes the newest job from the bottom, if any.
+     * @details Only to be called by the owner.
+     */
+    [[nodiscard]]
+    auto pop() noexcept -> job*;
+
+    /**
+     * @brief Removes the oldest job from the top, if any and no other thread took it.
+     */
+    [[nodiscard]]
+    auto steal() noexcept -> job*;
+
+private:
+    // The owner writes the bottom and the thieves the top, so they are kept apart to
+    // keep either side from invalidating the cache line of the other.
+    alignas(64) std::atomic<int64> top_{};            /**< Index of the oldest job. */
+    alignas(64) std::atomic<int64> bottom_{};         /**< Index past the newest job. */
+    std::array<std::atomic<job*>, capacity> slots_{}; /**< Ring of jobs. */
+};
+
+/**
+ * @class worker_pool
+ * @brief Fixed set of threads that execute fork/join tasks by work stealing.
+ * @details The threads are started once, so a loop only costs a wake-up instead of
+ *     thread creation. Every thread owns a deque of the jobs it forked, and an idle
+ *     thread steals the oldest job of another thread. A loop is split in halves until
+ *     single tasks remain, so the oldest job of a thread is the largest share of the
+ *     loop that it still holds, and the load spreads without any central queue. Idle
+ *     workers spin briefly before they sleep, so a loop that closely follows another
+ *     one does not wait for the scheduler of the system.
+ *
+ *     The calling thread takes part in every loop through a deque of its own, which
+ *     makes a pool of a single thread run everything inline. Loops and forks block until
+ *     all of their tasks have finished, may be nested within tasks and are required to
+ *     be started from one thread outside the pool at a time.
+ */
+class worker_pool {
+public:
+    /**
+     * @brief Minimum number of pixels per band.
+     */
+    static constexpr auto grain = 1 << 14;
+
+    /**
+     * @brief Constructs a pool that runs everything on the calling thread.
+     */
+    worker_pool(): worker_pool{1} {}
+
+    /**
+     * @brief Constructs a pool of the given number of threads.
+     * @param[in] threads Number of threads including the calling thread, or 0 to use one
+     *     thread per hardware thread.
+     * @param[in] settings Scheduling of the workers, which the calling thread is expected
+     *     to share.
+     */
+    explicit worker_pool(int threads, thread_settings const& settings = {});
+
+    /**
+     * @brief Stops and joins all workers.
+     */
+    ~worker_pool();
+
+    worker_pool(worker_pool const&) = delete;
+    auto operator=(worker_pool const&) -> worker_pool& = delete;
+
+    /**
+     * @brief Returns the number of threads including the calling thread.
+     */
+    [[nodiscard]]
+    auto size() const noexcept -> int
+    { return static_cast<int>(threads_); }
+
+    /**
+     * @brief Returns the number of bands to split an image region into.
+     * @details Every band gets at least grain pixels, below which waking up the workers
+     *     costs more than the band takes to process.
+     * @param[in] width Width of the region.
+     * @param[in] height Height of the region.
+     */
+    [[nodiscard]]
+    auto bands(int width, int height) const noexcept -> int;
+
+    /**
+     * @brief Runs two callables, the second one possibly on another thread, and waits
+     *     for both of them.
+     * @details The second callable is forked, so an idle thread can steal it while the
+     *     calling thread runs the first one. When nobody stole it, the calling thread
+     *     runs it as well. Otherwise, the calling thread executes other jobs until the
+     *     thief finished it.
+     * @param[in] first Callable to run on the calling thread, required not to throw.
+     * @param[in] second Callable to fork, required not to throw.
+     */
+    template<typename F, typename G>
+    auto fork_join(F&& first, G&& second) -> void {
+        auto forked = job{const_cast<void*>(static_cast<void const*>(&second)),
+            [](void* t) { (*static_cast<std::remove_reference_t<G>*>(t))(); }};
+        if (threads_ == 1 or not fork(forked)) {
+            first();
+            second();
+            return;
+        }
+        first();
+        join(forked);
+    }
+
+    /**
+     * @brief Runs a task for every index in [0, count) and waits for all of them.
+     * @param[in] count Number of tasks.
+     * @param[in] task Callable that is invoked with the index of every task, required
+     *     not to throw.
+     */
+    template<typename F>
+    auto run(int count, F&& task) -> void {
+        if (count <= 0) return;
+        if (count == 1 or threads_ == 1) {
+            for (int i{}; i < count; ++i) {
+                task(i);
+            }
+            return;
+        }
+        split(0, count, task);
+    }
+
+    /**
+     * @brief Splits a range of rows into contiguous bands and runs a task for each.
+     * @details Band i covers [begin + rows * i / count, begin + rows * (i + 1) / count),
+     *     which only depends on the range and the number of bands.
+     * @param[in] begin First row of the range.
+     * @param[in] end Row past the last row of the range.
+     * @param[in] count Number of bands.
+     * @param[in] task Callable that is invoked with the index, first row and the row
+     *     past the last row of every band.
+     */
+    template<typename F>
+    auto for_bands(int begin, int end, int count, F&& task) -> void {
+        auto const rows = int64{end - begin};
+        run(count, [&](int i) {
+            task(i, static_cast<int>(begin + rows * i / count),
+                static_cast<int>(begin + rows * (i + 1) / count));
+        });
+    }
+
+private:
+    /**
+     * @brief Runs the tasks of [first, last) by forking the upper half of the range
+     *     until single tasks remain.
+     */
+    template<typename F>
+    auto split(int first, int last, F& task) -> void {
+        if (last - first == 1) {
+            task(first);
+            return;
+        }
+        auto const middle = first + (last - first) / 2;
+        fork_join([&] { split(first, middle, task); },
+            [&] { split(middle, last, task); });
+    }
+
+    /**
+     * @brief Pushes a job onto the deque of the calling thread and wakes a worker.
+     * @return If the job was pushed, returns true. Otherwise, the deque is full and
+     *     returns false.
+     */
+    auto fork(job& forked) noexcept -> bool;
+
+    /**
+     * @brief Waits for a forked job, executing it if nobody stole it.
+     */
+    auto join(job& forked) noexcept -> void;
+
+    /**
+     * @brief Steals a job from the deque of any thread other than the given one.
+     */
+    [[nodiscard]]
+    auto steal(std::size_t thief) noexcept -> job*;
+
+    /**
+     * @brief Returns the index of the deque of the calling thread.
+     */
+    [[nodiscard]]
+    auto local() const noexcept -> std::size_t;
+
+    /**
+     * @brief Main loop of a worker thread.
+     */
+    auto work(std::stop_token stop, std::size_t index) -> void;
+
+    std::size_t threads_;                     /**< Number of threads. */
+    std::unique_ptr<job_deque[]> deques_;     /**< Deques of the caller and workers. */
+    alignas(64) std::atomic<uint32> epoch_{}; /**< Number of forks and stops. */
+    std::atomic<int> sleepers_{};             /**< Number of sleeping workers. */
+    std::vector<std::jthread> workers_;       /**< Worker threads. */
+};
+
+} // namespace par
+
+#endif
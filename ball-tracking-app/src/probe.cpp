@@ -0,0 +1,121 @@
+/**
+ * @file       probe.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the pipeline capacity probe.
+ */
+
+#include "probe.h"
+
+#include <algorithm>
+#include <format>
+#include <utility>
+
+/**
+ * @namespace perf
+ * @brief Performance measurement related components.
+ */
+namespace perf {
+
+/**
+ * @copydoc capacity_probe::capacity_probe
+ */
+capacity_probe::capacity_probe(int width, int height, std::vector<uint16> rates,
+    int frames, int warmup
+):
+    width_{width},
+    height_{height},
+    frames_{std::max(frames, 1)},
+    warmup_{std::max(warmup, 0)},
+    rates_{std::move(rates)},
+    convert_{static_cast<std::size_t>(frames_)},
+    vision_{static_cast<std::size_t>(frames_)},
+    total_{static_cast<std::size_t>(frames_)}
+{ results_.reserve(rates_.size()); }
+
+/**
+ * @copydoc capacity_probe::record
+ */
+auto capacity_probe::record(probe_sample const& sample) -> bool {
+    if (done()) return false;
+
+    // The camera restarts for every frame rate, which resets its count of dropped
+    // frames, so the count is taken from the first sample of a rate at the latest.
+    dropped_last_ = sample.dropped;
+    if (seen_ == 0 or seen_ < warmup_) {
+        dropped_start_ = sample.dropped;
+    }
+    if (++seen_ <= warmup_) return false;
+    convert_.add(sample.convert_ms);
+    vision_.add(sample.vision_ms);
+    total_.add(sample.convert_ms + sample.vision_ms);
+    if (seen_ < warmup_ + frames_) return false;
+
+    finish_rate();
+    return true;
+}
+
+/**
+ * @copydoc capacity_probe::finish_rate
+ */
+auto capacity_probe::finish_rate() -> void {
+    auto const period_ms = 1'000.0 / rates_[current_];
+    auto const total_p99 = total_.percentile(99.0);
+    results_.push_back({
+        .rate = rates_[current_],
+        .frames = total_.count(),
+        .dropped = dropped_last_ > dropped_start_ ? dropped_last_ - dropped_start_ : 0,
+        .convert_p50 = convert_.percentile(50.0),
+        .convert_p99 = convert_.percentile(99.0),
+        .vision_p50 = vision_.percentile(50.0),
+        .vision_p99 = vision_.percentile(99.0),
+        .total_p50 = total_.percentile(50.0),
+        .total_p99 = total_p99,
+        .sustainable = total_p99 <= period_ms
+    });
+    convert_.clear();
+    vision_.clear();
+    total_.clear();
+    seen_ = 0;
+
+    // Lower frame rates only have more headroom, so there is no need to test them.
+    current_ = results_.back().sustainable ? rates_.size() : current_ + 1;
+}
+
+/**
+ * @copydoc capacity_probe::best
+ */
+auto capacity_probe::best() const noexcept -> uint16 {
+    for (auto const& result : results_) {
+        if (result.sustainable) return result.rate;
+    }
+    return results_.empty() ? uint16{} : results_.back().rate;
+}
+
+/**
+ * @copydoc capacity_probe::report
+ */
+auto capacity_probe::report() const -> std::string {
+    auto result = std::format("capacity probe at {}x{}\n"
+        "{:>5} {:>7} {:>8} {:>17} {:>17} {:>17} {:>9} {:>5}\n",
+        width_, height_, "rate", "frames", "dropped",
+        "convert p50/p99", "vision p50/p99", "total p50/p99", "period", "fits");
+    for (auto const& r : results_) {
+        auto const dropratio = 100.0 * r.dropped
+            / std::max<std::size_t>(r.frames + r.dropped, 1);
+        result += std::format(
+            "{:>5} {:>7} {:>7.1f}% {:>6.2f}/{:>6.2f} ms {:>6.2f}/{:>6.2f} ms"
+            " {:>6.2f}/{:>6.2f} ms {:>6.2f} ms {:>5}\n",
+            r.rate, r.frames, dropratio, r.convert_p50, r.convert_p99,
+            r.vision_p50, r.vision_p99, r.total_p50, r.total_p99,
+            1'000.0 / r.rate, r.sustainable ? "yes" : "no");
+    }
+    result += std::format("selected frame rate: {} fps\n", best());
+    return result;
+}
+
+} // namespace perf
@@ -0,0 +1,137 @@
+/**
+ * @file       probe.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Pipeline capacity probe.
+ */
+
+#ifndef PERF_PROBE_H
+#define PERF_PROBE_H
+
+#include "stats.h"
+#include "types.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @namespace perf
+ * @brief Performance measurement related components.
+ */
+namespace perf {
+
+/**
+ * @struct probe_sample
+ * @brief Measurements of a single frame passing through the processing pipeline.
+ */
+struct probe_sample {
+    double convert_ms; /**< Time spent converting the raw camera frame. */
+    double vision_ms;  /**< Time spent on ball detection and control. */
+    uint32 dropped;    /**< Total number of frames dropped by the camera so far. */
+};
+
+/**
+ * @class capacity_probe
+ * @brief Finds the highest camera frame rate the processing pipeline can sustain.
+ * @details The supported frame rates are tested from high to low. For each rate, a
+ *     number of frames is measured after a warm-up period. A rate is sustainable when
+ *     the 99th percentile of the processing time fits inside the frame period. Probing
+ *     stops at the first sustainable rate, since every lower rate has more headroom.
+ */
+class capacity_probe {
+public:
+    /**
+     * @brief Default constructs a finished probe.
+     */
+    capacity_probe() = default;
+
+    /**
+     * @brief Constructs a probe for the given frame rates.
+     * @param[in] width Width of the camera frames.
+     * @param[in] height Height of the camera frames.
+     * @param[in] rates Supported frame rates, ordered from high to low.
+     * @param[in] frames Number of frames to measure per frame rate.
+     * @param[in] warmup Number of frames to skip after switching frame rates.
+     */
+    capacity_probe(int width, int height, std::vector<uint16> rates,
+        int frames, int warmup);
+
+    /**
+     * @brief Records the measurements of a frame at the frame rate under test.
+     * @param[in] sample Measurements of the frame.
+     * @return If the current frame rate has been measured completely and the camera
+     *     should switch to the next frame rate, returns true. Otherwise, returns false.
+     */
+    auto record(probe_sample const& sample) -> bool;
+
+    /**
+     * @brief Returns the frame rate under test.
+     * @pre Ensure the probe is not done before calling this function.
+     */
+    [[nodiscard]]
+    auto rate() const noexcept -> uint16
+    { return rates_[current_]; }
+
+    /**
+     * @brief Returns whether all frame rates of interest have been tested.
+     */
+    [[nodiscard]]
+    auto done() const noexcept -> bool
+    { return current_ >= rates_.size(); }
+
+    /**
+     * @brief Returns the highest sustainable frame rate.
+     * @details Falls back to the lowest tested frame rate when none was sustainable.
+     */
+    [[nodiscard]]
+    auto best() const noexcept -> uint16;
+
+    /**
+     * @brief Returns a human-readable report of all tested frame rates.
+     */
+    [[nodiscard]]
+    auto report() const -> std::string;
+
+private:
+    /**
+     * @struct result
+     * @brief Measured capacity at a single frame rate.
+     */
+    struct result {
+        uint16 rate;                      /**< Tested frame rate. */
+        std::size_t frames;               /**< Number of measured frames. */
+        uint32 dropped;                   /**< Number of dropped frames. */
+        double convert_p50, convert_p99;  /**< Conversion time percentiles. */
+        double vision_p50, vision_p99;    /**< Vision time percentiles. */
+        double total_p50, total_p99;      /**< Total processing time percentiles. */
+        bool sustainable;                 /**< Whether the total p99 fits the period. */
+    };
+
+    /**
+     * @brief Stores the result of the current frame rate and moves on to the next.
+     */
+    auto finish_rate() -> void;
+
+    int width_{};                  /**< Width of the camera frames. */
+    int height_{};                 /**< Height of the camera frames. */
+    int frames_{};                 /**< Number of frames to measure per frame rate. */
+    int warmup_{};                 /**< Number of frames to skip per frame rate. */
+    int seen_{};                   /**< Frames seen at the current frame rate. */
+    uint32 dropped_start_{};       /**< Dropped frames when the measurement starts. */
+    uint32 dropped_last_{};        /**< Dropped frames at the last sample. */
+    std::size_t current_{};        /**< Index of the frame rate under test. */
+    std::vector<uint16> rates_;    /**< Frame rates to test. */
+    std::vector<result> results_;  /**< Results of the tested frame rates. */
+    latency_stats convert_;        /**< Conversion times at the current frame rate. */
+    latency_stats vision_;         /**< Vision times at the current frame rate. */
+    latency_stats total_;          /**< Total times at the current frame rate. */
+};
+
+} // namespace perf
+
+#endif
@@ -5,6 +5,8 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <chrono>
+#include <utility>
 
 #if defined WIN32 || defined _WIN32 || defined WINCE
     #include <windows.h>
@@ -235,6 +237,54 @@ static const uint8_t sensor_start_qvga[][2] = {
     {0x65, 0x2f},
 };
 
+/* supported frame rates per resolution */
+struct rate_s {
+    uint16_t fps;
+    uint8_t r11;
+    uint8_t r0d;
+    uint8_t re5;
+};
+static const struct rate_s rate_0[] = { /* 640x480 */
+    {83, 0x01, 0xc1, 0x02}, /* 83 FPS: video is partly corrupt */
+    {75, 0x01, 0x81, 0x02}, /* 75 FPS or below: video is valid */
+    {60, 0x00, 0x41, 0x04},
+    {50, 0x01, 0x41, 0x02},
+    {40, 0x02, 0xc1, 0x04},
+    {30, 0x04, 0x81, 0x02},
+    {25, 0x00, 0x01, 0x02},
+    {20, 0x04, 0x41, 0x02},
+    {15, 0x09, 0x81, 0x02},
+    {10, 0x09, 0x41, 0x02},
+    {8, 0x02, 0x01, 0x02},
+    {5, 0x04, 0x01, 0x02},
+    {3, 0x06, 0x01, 0x02},
+    {2, 0x09, 0x01, 0x02},
+};
+static const struct rate_s rate_1[] = { /* 320x240 */
+    {290, 0x00, 0xc1, 0x04},
+    {205, 0x01, 0xc1, 0x02}, /* 205 FPS or above: video is partly corrupt */
+    {187, 0x01, 0x81, 0x02}, /* 187 FPS or below: video is valid */
+    {150, 0x00, 0x41, 0x04},
+    {137, 0x02, 0xc1, 0x02},
+    {125, 0x01, 0x41, 0x02},
+    {100, 0x02, 0xc1, 0x04},
+    {90, 0x03, 0x81, 0x02},
+    {75, 0x04, 0x81, 0x02},
+    {60, 0x04, 0xc1, 0x04},
+    {50, 0x04, 0x41, 0x02},
+    {40, 0x06, 0x81, 0x03},
+    {37, 0x00, 0x01, 0x04},
+    {30, 0x04, 0x41, 0x04},
+    {17, 0x18, 0xc1, 0x02},
+    {15, 0x18, 0x81, 0x02},
+    {12, 0x02, 0x01, 0x04},
+    {10, 0x18, 0x41, 0x02},
+    {7, 0x04, 0x01, 0x04},
+    {5, 0x06, 0x01, 0x04},
+    {3, 0x09, 0x01, 0x04},
+    {2, 0x18, 0x01, 0x02},
+};
+
 /* Values for bmHeaderInfo (Video and Still Image Payload Headers, 2.4.3.3) */
 #define UVC_STREAM_EOH    (1 << 7)
 #define UVC_STREAM_ERR    (1 << 6)
@@ -307,6 +357,8 @@ class USBMgr
 
     static std::shared_ptr<USBMgr>  sInstance;
     static int                      sTotalDevices;
+    static std::function<void()>    sTransferThreadInit;
+    static std::function<std::shared_ptr<uint8_t>(size_t)> sBufferAllocator;
 
  private:   
     libusb_context*                    usb_context;
@@ -324,6 +376,8 @@ class USBMgr
 
 std::shared_ptr<USBMgr> USBMgr::sInstance;
 int                     USBMgr::sTotalDevices = 0;
+std::function<void()>   USBMgr::sTransferThreadInit;
+std::function<std::shared_ptr<uint8_t>(size_t)> USBMgr::sBufferAllocator;
 
 USBMgr::USBMgr() 
 {
@@ -376,6 +430,8 @@ void USBMgr::stopTransferThread()
 void USBMgr::transferThreadFunc()
 {
     SetThreadName("PS3EyeDriver Transfer Thread");
+    if (sTransferThreadInit)
+        sTransferThreadInit();
 
     struct timeval tv;
     tv.tv_sec = 0;
@@ -426,35 +482,75 @@ int USBMgr::listDevices( std::vector<PS3EYECam::PS3EYERef>& list )
 
 static void LIBUSB_CALL transfer_completed_callback(struct libusb_transfer *xfr);
 
+// Allocates a frame or transfer buffer through the installed allocator, falling back to the heap
+static std::shared_ptr<uint8_t> allocate_buffer(size_t size)
+{
+    if (USBMgr::sBufferAllocator)
+    {
+        if (auto buffer = USBMgr::sBufferAllocator(size))
+            return buffer;
+    }
+    return std::shared_ptr<uint8_t>((uint8_t*)malloc(size), free);
+}
+
 class FrameQueue
 {
 public:
     FrameQueue(uint32_t frame_size) :
         frame_size            (frame_size),
         num_frames            (2),
-        frame_buffer        ((uint8_t*)malloc(frame_size * num_frames)),
+        frame_storage        (allocate_buffer(frame_size * num_frames)),
+        frame_buffer        (frame_storage.get()),
         head                (0),
         tail                (0),
-        available            (0)
+        available            (0),
+        dropped                (0),
+        convert_time_us        (0),
+        frame_pts            (num_frames, 0),
+        frame_arrival        (num_frames),
+        last_pts            (0)
     {
     }
 
-    ~FrameQueue()
+    uint8_t* GetFrameBufferStart()
     {
-        free(frame_buffer);
+        return frame_buffer;
     }
 
-    uint8_t* GetFrameBufferStart()
+    // Number of frames that were overwritten because the consumer did not keep up
+    uint32_t GetDroppedFrames() const
     {
-        return frame_buffer;
+        return dropped;
+    }
+
+    // Time spent copying or debayering the last dequeued frame, in microseconds
+    uint32_t GetConversionTime() const
+    {
+        return convert_time_us;
+    }
+
+    // Timing of the last dequeued frame: its PTS and the time its last packet arrived
+    uint32_t GetFramePTS() const
+    {
+        return last_pts;
+    }
+
+    std::chrono::steady_clock::time_point GetFrameArrival() const
+    {
+        return last_arrival;
     }
 
-    uint8_t* Enqueue()
+    uint8_t* Enqueue(uint32_t pts)
     {
         uint8_t* new_frame = NULL;
+        auto const arrival = std::chrono::steady_clock::now();
 
         std::lock_guard<std::mutex> lock(mutex);
 
+        // The completed frame is the one at the head, whether it is kept or overwritten
+        frame_pts[head] = pts;
+        frame_arrival[head] = arrival;
+
         // Unlike traditional producer/consumer, we don't block the producer if the buffer is full (ie. the consumer is not reading data fast enough).
         // Instead, if the buffer is full, we simply return the current frame pointer, causing the producer to overwrite the previous frame.
         // This allows performance to degrade gracefully: if the consumer is not fast enough (< Camera FPS), it will miss frames, but if it is fast enough (>= Camera FPS), it will see everything.
@@ -463,6 +559,7 @@ public:
         // otherwise the producer could overwrite the frame the consumer is currently reading (in case of a slow consumer)
         if (available >= num_frames - 1)
         {
+            dropped++;
             return frame_buffer + head * frame_size;
         }
 
@@ -489,6 +586,7 @@ public:
 
         // Copy from internal buffer
         uint8_t* source = frame_buffer + frame_size * tail;
+        auto convert_start = std::chrono::steady_clock::now();
 
         if (outputFormat == PS3EYECam::EOutputFormat::Bayer)
         {
@@ -503,6 +601,11 @@ public:
         {
             DebayerGray(frame_width, frame_height, source, new_frame);
         }
+        convert_time_us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - convert_start).count();
+        last_pts = frame_pts[tail];
+        last_arrival = frame_arrival[tail];
+
         // Update tail and available count
         tail = (tail + 1) % num_frames;
         available--;
@@ -715,10 +818,18 @@ private:
     uint32_t                frame_size;
     uint32_t                num_frames;
 
+    std::shared_ptr<uint8_t> frame_storage;
     uint8_t*                frame_buffer;
     uint32_t                head;
     uint32_t                tail;
     uint32_t                available;
+    std::atomic<uint32_t>    dropped;
+    std::atomic<uint32_t>    convert_time_us;
+
+    std::vector<uint32_t>    frame_pts;
+    std::vector<std::chrono::steady_clock::time_point> frame_arrival;
+    uint32_t                last_pts;
+    std::chrono::steady_clock::time_point last_arrival;
 
     std::mutex                mutex;
     std::condition_variable    empty_condition;
@@ -734,6 +845,7 @@ public:
         last_packet_type        (DISCARD_PACKET), 
         last_pts                (0), 
         last_fid                (0), 
+        cur_frame_pts            (0),
         transfer_buffer            (NULL),
         cur_frame_start            (NULL),
         cur_frame_data_len        (0),
@@ -763,7 +875,8 @@ public:
         libusb_clear_halt(handle, bulk_endpoint);
 
         // Allocate the transfer buffer
-        transfer_buffer = (uint8_t*)malloc(TRANSFER_SIZE * NUM_TRANSFERS);
+        transfer_storage = allocate_buffer(TRANSFER_SIZE * NUM_TRANSFERS);
+        transfer_buffer = transfer_storage.get();
         memset(transfer_buffer, 0, TRANSFER_SIZE * NUM_TRANSFERS);
 
         int res = 0;
@@ -803,7 +916,7 @@ public:
 
         USBMgr::instance()->cameraStopped();
 
-        free(transfer_buffer);
+        transfer_storage.reset();
         transfer_buffer = NULL;
 
         delete frame_queue;
@@ -857,7 +970,7 @@ public:
 
         if (packet_type == LAST_PACKET) {        
             cur_frame_data_len = 0;
-            cur_frame_start = frame_queue->Enqueue();
+            cur_frame_start = frame_queue->Enqueue(cur_frame_pts);
             //debug("frame completed %d\n", frame_complete_ind);
         }
     }
@@ -908,6 +1021,7 @@ public:
                 }
                 last_pts = this_pts;
                 last_fid = this_fid;
+                cur_frame_pts = this_pts;
                 frame_add(FIRST_PACKET, data + 12, len - 12);
             } /* If this packet is marked as EOF, end the frame */
             else if (data[1] & UVC_STREAM_EOF) 
@@ -943,8 +1057,10 @@ public:
     enum gspca_packet_type    last_packet_type;
     uint32_t                last_pts;
     uint16_t                last_fid;
+    uint32_t                cur_frame_pts;
     libusb_transfer*        xfr[NUM_TRANSFERS];
 
+    std::shared_ptr<uint8_t> transfer_storage;
     uint8_t*                transfer_buffer;
     uint8_t*                cur_frame_start;
     uint32_t                cur_frame_data_len;
@@ -1219,6 +1335,27 @@ void PS3EYECam::getFrame(uint8_t* frame)
     urb->frame_queue->Dequeue(frame, frame_width, frame_height, frame_output_format);
 }
 
+uint32_t PS3EYECam::getDroppedFrames() const
+{
+    return urb->frame_queue ? urb->frame_queue->GetDroppedFrames() : 0;
+}
+
+uint32_t PS3EYECam::getConversionTime() const
+{
+    return urb->frame_queue ? urb->frame_queue->GetConversionTime() : 0;
+}
+
+uint32_t PS3EYECam::getFramePTS() const
+{
+    return urb->frame_queue ? urb->frame_queue->GetFramePTS() : 0;
+}
+
+std::chrono::steady_clock::time_point PS3EYECam::getFrameArrival() const
+{
+    return urb->frame_queue ? urb->frame_queue->GetFrameArrival()
+        : std::chrono::steady_clock::time_point{};
+}
+
 bool PS3EYECam::open_usb()
 {
     // open, set first config and claim interface
@@ -1281,53 +1418,7 @@ void PS3EYECam::ov534_set_led(int status)
 uint16_t PS3EYECam::ov534_set_frame_rate(uint16_t frame_rate, bool dry_run)
 {
      int i;
-     struct rate_s {
-             uint16_t fps;
-             uint8_t r11;
-             uint8_t r0d;
-             uint8_t re5;
-     };
      const struct rate_s *r;
-     static const struct rate_s rate_0[] = { /* 640x480 */
-             {83, 0x01, 0xc1, 0x02}, /* 83 FPS: video is partly corrupt */
-             {75, 0x01, 0x81, 0x02}, /* 75 FPS or below: video is valid */
-             {60, 0x00, 0x41, 0x04},
-             {50, 0x01, 0x41, 0x02},
-             {40, 0x02, 0xc1, 0x04},
-             {30, 0x04, 0x81, 0x02},
-             {25, 0x00, 0x01, 0x02},
-             {20, 0x04, 0x41, 0x02},
-             {15, 0x09, 0x81, 0x02},
-             {10, 0x09, 0x41, 0x02},
-             {8, 0x02, 0x01, 0x02},
-             {5, 0x04, 0x01, 0x02},
-             {3, 0x06, 0x01, 0x02},
-             {2, 0x09, 0x01, 0x02},
-     };
-     static const struct rate_s rate_1[] = { /* 320x240 */
-             {290, 0x00, 0xc1, 0x04},
-             {205, 0x01, 0xc1, 0x02}, /* 205 FPS or above: video is partly corrupt */
-             {187, 0x01, 0x81, 0x02}, /* 187 FPS or below: video is valid */
-             {150, 0x00, 0x41, 0x04},
-             {137, 0x02, 0xc1, 0x02},
-             {125, 0x01, 0x41, 0x02},
-             {100, 0x02, 0xc1, 0x04},
-             {90, 0x03, 0x81, 0x02},
-             {75, 0x04, 0x81, 0x02},
-             {60, 0x04, 0xc1, 0x04},
-             {50, 0x04, 0x41, 0x02},
-             {40, 0x06, 0x81, 0x03},
-             {37, 0x00, 0x01, 0x04},
-             {30, 0x04, 0x41, 0x04},
-             {17, 0x18, 0xc1, 0x02},
-             {15, 0x18, 0x81, 0x02},
-             {12, 0x02, 0x01, 0x04},
-             {10, 0x18, 0x41, 0x02},
-             {7, 0x04, 0x01, 0x04},
-             {5, 0x06, 0x01, 0x04},
-             {3, 0x09, 0x01, 0x04},
-             {2, 0x18, 0x01, 0x02},
-     };
 
      if (frame_width == 640) {
              r = rate_0;
@@ -1352,6 +1443,30 @@ uint16_t PS3EYECam::ov534_set_frame_rate(uint16_t frame_rate, bool dry_run)
      return r->fps;
 }
 
+std::vector<uint16_t> PS3EYECam::getFrameRates(uint32_t width)
+{
+    std::vector<uint16_t> rates;
+    const struct rate_s *r = (width == 640) ? rate_0 : rate_1;
+    size_t count = (width == 640) ? ARRAY_SIZE(rate_0) : ARRAY_SIZE(rate_1);
+    uint16_t max_valid = (width == 640) ? 75 : 187; // above these rates the video is partly corrupt
+
+    for (size_t i = 0; i < count; ++i) {
+        if (r[i].fps <= max_valid)
+            rates.push_back(r[i].fps);
+    }
+    return rates;
+}
+
+void PS3EYECam::setTransferThreadInit(std::function<void()> init)
+{
+    USBMgr::sTransferThreadInit = std::move(init);
+}
+
+void PS3EYECam::setBufferAllocator(std::function<std::shared_ptr<uint8_t>(size_t)> allocate)
+{
+    USBMgr::sBufferAllocator = std::move(allocate);
+}
+
 void PS3EYECam::ov534_reg_write(uint16_t reg, uint8_t val)
 {
     int ret;
@@ -2,9 +2,11 @@
 #ifndef PS3EYECAM_H
 #define PS3EYECAM_H
 
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <vector>
 
 #include <memory>
@@ -172,6 +174,18 @@ public:
     // - The output buffer must be sized correctly, depending out the output format. See EOutputFormat.
     void getFrame(uint8_t* frame);
 
+    // Statistics of the running stream. Both are reset whenever the camera is (re)started.
+    // - getDroppedFrames: number of frames overwritten because getFrame was not called in time
+    // - getConversionTime: time spent converting the last frame to the output format, in microseconds
+    uint32_t getDroppedFrames() const;
+    uint32_t getConversionTime() const;
+
+    // Timing of the frame that getFrame returned last. Notes:
+    // - getFramePTS: presentation timestamp from the UVC payload headers, in ticks of the camera clock
+    // - getFrameArrival: time at which the transfer holding the last packet of the frame completed
+    uint32_t getFramePTS() const;
+    std::chrono::steady_clock::time_point getFrameArrival() const;
+
     uint32_t getWidth() const { return frame_width; }
     uint32_t getHeight() const { return frame_height; }
     uint16_t getFrameRate() const { return frame_rate; }
@@ -183,6 +197,17 @@ public:
     uint32_t getRowBytes() const { return frame_width * getOutputBytesPerPixel(); }
     uint32_t getOutputBytesPerPixel() const;
 
+    // Frame rates that produce valid video for the given frame width, from highest to lowest
+    static std::vector<uint16_t> getFrameRates(uint32_t width);
+
+    // Function that the USB transfer thread calls whenever it starts, e.g. to set its priority.
+    // Must be set before the first camera is started.
+    static void setTransferThreadInit(std::function<void()> init);
+
+    // Function that allocates the frame queue and USB transfer buffers of a camera when it starts,
+    // e.g. to keep them resident. Returning null falls back to the heap.
+    static void setBufferAllocator(std::function<std::shared_ptr<uint8_t>(size_t)> allocate);
+
     //
     static const std::vector<PS3EYERef>& getDevices( bool forceRefresh = false );
 
@@ -0,0 +1,170 @@
+/**
+ * @file       queue.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Lock-free handoff of data between the stages of the pipeline.
+ */
+
+#ifndef PAR_QUEUE_H
+#define PAR_QUEUE_H
+
+#include "types.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <stop_token>
+
+/**
+ * @namespace par
+ * @brief Parallel execution related components.
+ */
+namespace par {
+
+/**
+ * @class spsc_queue
+ * @brief Bounded queue between a single producer and a single consumer thread.
+ * @details The elements are kept in a fixed ring, so pushing and popping never allocate
+ *     nor lock. Each side only writes its own index, which the other side reads with
+ *     acquire semantics, so an element is complete before it can be popped. A consumer
+ *     that finds the queue empty sleeps on a counter of pushes instead of spinning, and
+ *     is woken by the next push or by an interruption.
+ * @tparam T Type of the elements, required to be copy assignable.
+ * @tparam Capacity Maximum number of elements, required to be a power of two.
+ */
+template<typename T, std::size_t Capacity>
+    requires (Capacity > 0 and (Capacity & (Capacity - 1)) == 0)
+class spsc_queue {
+public:
+    /**
+     * @brief Appends an element, unless the queue is full.
+     * @details Only to be called by the producer.
+     * @param[in] value Element to append.
+     * @return If the element was appended, returns true. Otherwise, returns false.
+     */
+    auto try_push(T const& value) noexcept -> bool {
+        auto const tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity) return false;
+        slots_[tail % Capacity] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        signal_.fetch_add(1, std::memory_order_release);
+        signal_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest element, unless the queue is empty.
+     * @details Only to be called by the consumer.
+     * @param[out] value Removed element.
+     * @return If an element was removed, returns true. Otherwise, returns false.
+     */
+    auto try_pop(T& value) noexcept -> bool {
+        auto const head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+        value = slots_[head % Capacity];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest element, waiting for one if the queue is empty.
+     * @details Only to be called by the consumer.
+     * @param[out] value Removed element.
+     * @param[in] stop Token whose stop request ends the wait, once it is interrupted.
+     * @return If an element was removed, returns true. Otherwise, a stop was requested
+     *     and returns false.
+     */
+    auto pop(T& value, std::stop_token const& stop) noexcept -> bool {
+        while (true) {
+            // A push between the check and the wait changes the counter first.
+            auto const seen = signal_.load(std::memory_order_acquire);
+            if (try_pop(value)) return true;
+            if (stop.stop_requested()) return false;
+            signal_.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    /**
+     * @brief Wakes a waiting consumer, so it can notice a stop request.
+     */
+    auto interrupt() noexcept -> void {
+        signal_.fetch_add(1, std::memory_order_release);
+        signal_.notify_all();
+    }
+
+private:
+    // Both indices are written by different threads, so they are kept apart to keep
+    // either side from invalidating the cache line of the other.
+    alignas(64) std::atomic<uint64> head_{};   /**< Index of the oldest element. */
+    alignas(64) std::atomic<uint64> tail_{};   /**< Index past the newest element. */
+    alignas(64) std::atomic<uint32> signal_{}; /**< Pushes and interruptions. */
+    std::array<T, Capacity> slots_{};          /**< Ring of elements. */
+};
+
+/**
+ * @class snapshot
+ * @brief Latest value published by a single writer for a single reader.
+ * @details Keeps three copies of the value: one that the writer fills, one that the
+ *     reader holds and one in between that holds the latest publication. Publishing and
+ *     acquiring only swap the index of a copy with the one in between, so neither side
+ *     ever waits for the other, and the reader skips any publication it was too slow
+ *     for.
+ * @tparam T Type of the value.
+ */
+template<typename T>
+class snapshot {
+public:
+    /**
+     * @brief Returns the copy to fill with the next publication.
+     * @details Only to be called by the writer.
+     */
+    [[nodiscard]]
+    auto back() noexcept -> T&
+    { return slots_[back_]; }
+
+    /**
+     * @brief Publishes the copy that was filled, replacing any earlier publication that
+     *     the reader did not acquire.
+     * @details Only to be called by the writer.
+     */
+    auto publish() noexcept -> void {
+        back_ = middle_.exchange(back_ | fresh, std::memory_order_acq_rel) & index;
+    }
+
+    /**
+     * @brief Takes the latest publication, if any arrived since the last call.
+     * @details Only to be called by the reader.
+     * @return If a new publication was taken, returns true. Otherwise, returns false
+     *     and the current copy is kept.
+     */
+    auto acquire() noexcept -> bool {
+        if ((middle_.load(std::memory_order_relaxed) & fresh) == 0) return false;
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index;
+        return true;
+    }
+
+    /**
+     * @brief Returns the copy that was acquired last.
+     * @details Only to be called by the reader.
+     */
+    [[nodiscard]]
+    auto front() const noexcept -> T const&
+    { return slots_[front_]; }
+
+private:
+    static constexpr auto index = 3u; /**< Bits of the index of a copy. */
+    static constexpr auto fresh = 4u; /**< Marks a publication that was not acquired. */
+
+    std::array<T, 3> slots_{};        /**< Copies of the value. */
+    unsigned back_{0};                /**< Copy of the writer. */
+    std::atomic<unsigned> middle_{1}; /**< Copy in between, with its freshness. */
+    unsigned front_{2};               /**< Copy of the reader. */
+};
+
+} // namespace par
+
+#endif
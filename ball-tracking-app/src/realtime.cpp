@@ -0,0 +1,371 @@
+/**
+ * @file       realtime.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the scheduling of time-critical threads.
+ */
+
+#include "realtime.h"
+
+#include <algorithm>
+#include <format>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
+
+/**
+ * @namespace par
+ * @brief Parallel execution related components.
+ */
+namespace par {
+
+namespace {
+
+/**
+ * @brief Returns the name of a scheduling policy.
+ */
+constexpr auto to_string(scheduling policy) noexcept -> std::string_view {
+    switch (policy) {
+    case scheduling::timeshare: return "time-sharing";
+    case scheduling::realtime:  return "real-time";
+    default:                    return "inherited";
+    }
+}
+
+/**
+ * @brief Returns a description of the scheduling of a thread.
+ */
+auto to_string(thread_settings const& settings) -> std::string {
+    auto text = std::format("{} {}", to_string(settings.policy), settings.priority);
+    text += settings.affinity == 0
+        ? " on any cpu" : std::format(" on cpus {:#x}", settings.affinity);
+    return text;
+}
+
+/**
+ * @brief Rounds a size up to a whole number of pages.
+ */
+constexpr auto round_up(std::size_t bytes, std::size_t page) noexcept -> std::size_t
+{ return (bytes + page - 1) / page * page; }
+
+/**
+ * @brief Writes every page of a memory region once, so that all of them are mapped.
+ */
+auto prefault(uint8* data, std::size_t size, std::size_t page) noexcept -> void {
+    // Volatile writes are not optimized away, although nothing reads them.
+    auto* const touched = static_cast<uint8 volatile*>(data);
+    for (std::size_t offset{}; offset < size; offset += page) {
+        touched[offset] = 0;
+    }
+}
+
+#if defined(_WIN32)
+
+/**
+ * @brief Enables the right to lock pages in memory for the process.
+ * @return If the user of the process holds the right, returns true. Otherwise, returns
+ *     false.
+ */
+auto enable_lock_privilege() noexcept -> bool {
+    auto token = HANDLE{};
+    if (not OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY,
+            &token)) return false;
+    auto privileges = TOKEN_PRIVILEGES{};
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    // Adjusting succeeds without granting a right that the user lacks, which only shows
+    // in the last error.
+    auto const enabled = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME,
+            &privileges.Privileges[0].Luid)
+        and AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+        and GetLastError() == ERROR_SUCCESS;
+    CloseHandle(token);
+    return enabled;
+}
+
+#endif
+
+} // namespace
+
+#if defined(_WIN32)
+
+/**
+ * @copydoc schedule_thread
+ */
+auto schedule_thread(thread_settings const& settings) noexcept -> thread_grant {
+    auto const thread = GetCurrentThread();
+    auto const realtime = settings.policy == scheduling::realtime;
+    auto const requested = realtime ? THREAD_PRIORITY_TIME_CRITICAL
+        : std::clamp(settings.priority, THREAD_PRIORITY_LOWEST, THREAD_PRIORITY_HIGHEST);
+    auto grant = thread_grant{.scheduled = true, .pinned = true};
+    if (settings.policy != scheduling::inherit) {
+        grant.scheduled = SetThreadPriority(thread, requested) != 0;
+    }
+    auto const level = GetThreadPriority(thread);
+    grant.settings.policy = level == THREAD_PRIORITY_TIME_CRITICAL
+        ? scheduling::realtime : scheduling::timeshare;
+    grant.settings.priority = level;
+    if (settings.policy != scheduling::inherit) {
+        // The priority of a real-time thread follows from the class of the process.
+        grant.scheduled = grant.scheduled and level == requested
+            and (realtime or level == settings.priority);
+    }
+
+    // Windows offers no way to read the affinity of a thread back.
+    if (settings.affinity != 0) {
+        grant.pinned = SetThreadAffinityMask(
+            thread, static_cast<DWORD_PTR>(settings.affinity)) != 0;
+        grant.settings.affinity = grant.pinned ? settings.affinity : 0;
+    }
+    return grant;
+}
+
+#else
+
+/**
+ * @copydoc schedule_thread
+ */
+auto schedule_thread(thread_settings const& settings) noexcept -> thread_grant {
+    auto const thread = pthread_self();
+#if defined(__linux__)
+    // The nice value of a Linux thread applies to that thread only.
+    auto const tid = static_cast<id_t>(syscall(SYS_gettid));
+#endif
+    auto grant = thread_grant{.scheduled = true, .pinned = true};
+    auto param = sched_param{};
+    switch (settings.policy) {
+    case scheduling::timeshare:
+        grant.scheduled = pthread_setschedparam(thread, SCHED_OTHER, &param) == 0;
+#if defined(__linux__)
+        grant.scheduled = grant.scheduled
+            and setpriority(PRIO_PROCESS, tid, -settings.priority) == 0;
+#endif
+        break;
+    case scheduling::realtime:
+        param.sched_priority = std::clamp(settings.priority,
+            sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+        grant.scheduled = pthread_setschedparam(thread, SCHED_FIFO, &param) == 0;
+        break;
+    default:
+        break;
+    }
+
+    auto policy = 0;
+    if (pthread_getschedparam(thread, &policy, &param) == 0) {
+        auto const realtime = policy == SCHED_FIFO or policy == SCHED_RR;
+        grant.settings.policy = realtime ? scheduling::realtime : scheduling::timeshare;
+        grant.settings.priority = param.sched_priority;
+#if defined(__linux__)
+        if (not realtime) {
+            grant.settings.priority = -getpriority(PRIO_PROCESS, tid);
+        }
+#endif
+    }
+    if (settings.policy != scheduling::inherit) {
+        grant.scheduled = grant.scheduled and grant.settings.policy == settings.policy
+            and grant.settings.priority == settings.priority;
+    }
+
+#if defined(__linux__)
+    auto cpus = cpu_set_t{};
+    if (settings.affinity != 0) {
+        CPU_ZERO(&cpus);
+        for (auto cpu = 0; cpu < 64; ++cpu) {
+            if ((settings.affinity >> cpu) & 1) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        grant.pinned = pthread_setaffinity_np(thread, sizeof(cpus), &cpus) == 0;
+    }
+    CPU_ZERO(&cpus);
+    if (pthread_getaffinity_np(thread, sizeof(cpus), &cpus) == 0) {
+        for (auto cpu = 0; cpu < 64; ++cpu) {
+            if (CPU_ISSET(cpu, &cpus)) {
+                grant.settings.affinity |= uint64{1} << cpu;
+            }
+        }
+    }
+    if (settings.affinity != 0) {
+        grant.pinned = grant.pinned and grant.settings.affinity == settings.affinity;
+    }
+#else
+    grant.pinned = settings.affinity == 0;
+#endif
+    return grant;
+}
+
+#endif
+
+/**
+ * @copydoc lock_memory
+ */
+auto lock_memory(std::size_t bytes) noexcept -> bool {
+#if defined(_WIN32)
+    auto const process = GetCurrentProcess();
+    auto minimum = SIZE_T{};
+    auto maximum = SIZE_T{};
+    if (not GetProcessWorkingSetSize(process, &minimum, &maximum)) return false;
+    minimum = std::max<SIZE_T>(minimum, bytes);
+    maximum = std::max(maximum, minimum);
+    return SetProcessWorkingSetSizeEx(process, minimum, maximum,
+        QUOTA_LIMITS_HARDWS_MIN_ENABLE | QUOTA_LIMITS_HARDWS_MAX_DISABLE) != 0;
+#else
+    static_cast<void>(bytes);
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+#endif
+}
+
+#if defined(_WIN32)
+
+/**
+ * @copydoc resident_buffer::resident_buffer(std::size_t)
+ */
+resident_buffer::resident_buffer(std::size_t bytes) noexcept {
+    if (bytes == 0) return;
+    // Large pages are committed at once and never paged out.
+    if (auto const large = GetLargePageMinimum(); large > 0 and enable_lock_privilege()) {
+        auto const size = round_up(bytes, large);
+        data_ = static_cast<uint8*>(VirtualAlloc(nullptr, size,
+            MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+        if (data_) {
+            size_ = size;
+            huge_ = true;
+            locked_ = true;
+            return;
+        }
+    }
+
+    auto info = SYSTEM_INFO{};
+    GetSystemInfo(&info);
+    auto const page = static_cast<std::size_t>(info.dwPageSize);
+    auto const size = round_up(bytes, page);
+    data_ = static_cast<uint8*>(
+        VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+    if (not data_) return;
+    size_ = size;
+    prefault(data_, size_, page);
+    locked_ = VirtualLock(data_, size_) != 0;
+    if (locked_) return;
+
+    // Locked pages count against the minimum working set, which is raised to fit them.
+    auto const process = GetCurrentProcess();
+    auto minimum = SIZE_T{};
+    auto maximum = SIZE_T{};
+    if (GetProcessWorkingSetSize(process, &minimum, &maximum)
+        and SetProcessWorkingSetSize(process, minimum + size_, maximum + size_))
+    {
+        locked_ = VirtualLock(data_, size_) != 0;
+    }
+}
+
+/**
+ * @copydoc resident_buffer::~resident_buffer
+ */
+resident_buffer::~resident_buffer() {
+    if (not data_) return;
+    if (locked_ and not huge_) {
+        VirtualUnlock(data_, size_);
+    }
+    VirtualFree(data_, 0, MEM_RELEASE);
+}
+
+/**
+ * @copydoc count_page_faults
+ */
+auto count_page_faults() noexcept -> page_faults {
+    auto counters = PROCESS_MEMORY_COUNTERS{};
+    if (not GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return {};
+    }
+    return {.minor = counters.PageFaultCount};
+}
+
+#else
+
+/**
+ * @copydoc resident_buffer::resident_buffer(std::size_t)
+ */
+resident_buffer::resident_buffer(std::size_t bytes) noexcept {
+    if (bytes == 0) return;
+    auto const page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    auto* memory = MAP_FAILED;
+    auto size = std::size_t{};
+#if defined(MAP_HUGETLB)
+    // Huge pages come from the pool that the administrator reserved, if any.
+    constexpr auto large = std::size_t{2} << 20;
+    size = round_up(bytes, large);
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    huge_ = memory != MAP_FAILED;
+#endif
+    if (memory == MAP_FAILED) {
+        size = round_up(bytes, page);
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+            -1, 0);
+        if (memory == MAP_FAILED) return;
+#if defined(MADV_HUGEPAGE)
+        // Transparent huge pages may still back the parts that span whole large pages.
+        static_cast<void>(madvise(memory, size, MADV_HUGEPAGE));
+#endif
+    }
+    data_ = static_cast<uint8*>(memory);
+    size_ = size;
+    prefault(data_, size_, page);
+    locked_ = mlock(data_, size_) == 0;
+}
+
+/**
+ * @copydoc resident_buffer::~resident_buffer
+ */
+resident_buffer::~resident_buffer() {
+    if (not data_) return;
+    if (locked_) {
+        munlock(data_, size_);
+    }
+    munmap(data_, size_);
+}
+
+/**
+ * @copydoc count_page_faults
+ */
+auto count_page_faults() noexcept -> page_faults {
+    auto usage = rusage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return {};
+    return {
+        .minor = static_cast<uint64>(usage.ru_minflt),
+        .major = static_cast<uint64>(usage.ru_majflt)};
+}
+
+#endif
+
+/**
+ * @copydoc describe
+ */
+auto describe(std::string_view role, thread_settings const& settings,
+    thread_grant const& grant) -> std::string
+{
+    auto text = std::format("{} thread: {}", role, to_string(grant.settings));
+    if (not grant.scheduled or not grant.pinned) {
+        text += std::format(" (requested {})", to_string(settings));
+    }
+    return text + '\n';
+}
+
+} // namespace par
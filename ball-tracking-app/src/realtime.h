@@ -0,0 +1,194 @@
+/**
+ * @file       realtime.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Scheduling, processor affinity and resident memory of time-critical threads.
+ */
+
+#ifndef PAR_REALTIME_H
+#define PAR_REALTIME_H
+
+#include "types.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/**
+ * @namespace par
+ * @brief Parallel execution related components.
+ */
+namespace par {
+
+/**
+ * @enum scheduling
+ * @brief Scheduling policy of a thread.
+ */
+enum class scheduling {
+    inherit,   /**< Leaves the policy and priority of the thread untouched. */
+    timeshare, /**< Shares the processors, with the priority as relative weight. */
+    realtime   /**< Preempts every time-sharing thread. */
+};
+
+/**
+ * @struct thread_settings
+ * @brief Requested scheduling of a thread.
+ * @details On Windows, the priority of a time-sharing thread is a thread priority level
+ *     between -2 and 2, and a real-time thread runs at the time-critical level of the
+ *     priority class of the process. On POSIX systems, the priority of a time-sharing
+ *     thread is its negated nice value, which is only applied per thread on Linux, and
+ *     a real-time thread runs under the FIFO policy at the given priority. Raising the
+ *     priority may require elevated rights, in which case the thread keeps what it has.
+ */
+struct thread_settings {
+    scheduling policy{}; /**< Scheduling policy. */
+    int priority{};      /**< Priority within the scheduling policy. */
+    uint64 affinity{};   /**< Bitmask of the processors to run on, or 0 for any. */
+};
+
+/**
+ * @struct thread_grant
+ * @brief Scheduling that a thread actually got.
+ */
+struct thread_grant {
+    thread_settings settings{}; /**< Scheduling in effect after the request. */
+    bool scheduled{};           /**< Whether the policy and priority were granted. */
+    bool pinned{};              /**< Whether the affinity was granted. */
+};
+
+/**
+ * @brief Applies the requested scheduling to the calling thread.
+ * @details The scheduling in effect is read back from the system afterwards, so the
+ *     grant also reflects clamped priorities and refused requests.
+ * @param[in] settings Requested scheduling.
+ * @return Scheduling that the thread got.
+ */
+auto schedule_thread(thread_settings const& settings) noexcept -> thread_grant;
+
+/**
+ * @brief Keeps the memory of the process resident, so the time-critical threads never
+ *     wait for a page to be read back from disk.
+ * @details On Windows, raises the minimum working set of the process to the given size.
+ *     On POSIX systems, locks every current and future page of the process.
+ * @param[in] bytes Amount of memory to keep resident.
+ * @return If the memory is locked, returns true. Otherwise, returns false.
+ */
+auto lock_memory(std::size_t bytes) noexcept -> bool;
+
+/**
+ * @class resident_buffer
+ * @brief Memory that stays mapped to physical pages for its whole lifetime.
+ * @details Maps the memory straight from the system, on large pages where the system
+ *     grants them, writes every page once so none of them faults on first use, and
+ *     locks the pages so they are never paged out. Large pages are locked by nature,
+ *     and need the right to lock pages in memory on Windows. Any step that the system
+ *     refuses is skipped, so the buffer is usable as long as it was mapped at all.
+ */
+class resident_buffer {
+public:
+    /**
+     * @brief Constructs an empty buffer.
+     */
+    resident_buffer() = default;
+
+    /**
+     * @brief Constructs a buffer of at least the given size.
+     * @param[in] bytes Size of the buffer.
+     */
+    explicit resident_buffer(std::size_t bytes) noexcept;
+
+    /**
+     * @brief Unlocks and unmaps the memory.
+     */
+    ~resident_buffer();
+
+    resident_buffer(resident_buffer&& other) noexcept
+    { swap(other); }
+
+    auto operator=(resident_buffer&& other) noexcept -> resident_buffer& {
+        resident_buffer{std::move(other)}.swap(*this);
+        return *this;
+    }
+
+    /**
+     * @brief Returns the start of the memory, or null if it could not be mapped.
+     */
+    [[nodiscard]]
+    auto data() const noexcept -> uint8*
+    { return data_; }
+
+    /**
+     * @brief Returns the size of the memory, rounded up to whole pages.
+     */
+    [[nodiscard]]
+    auto size() const noexcept -> std::size_t
+    { return size_; }
+
+    /**
+     * @brief Returns whether the memory lies on large pages.
+     */
+    [[nodiscard]]
+    auto huge() const noexcept -> bool
+    { return huge_; }
+
+    /**
+     * @brief Returns whether the memory is locked.
+     */
+    [[nodiscard]]
+    auto locked() const noexcept -> bool
+    { return locked_; }
+
+private:
+    /**
+     * @brief Exchanges the memory of two buffers.
+     */
+    auto swap(resident_buffer& other) noexcept -> void {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(huge_, other.huge_);
+        std::swap(locked_, other.locked_);
+    }
+
+    uint8* data_{};      /**< Start of the memory. */
+    std::size_t size_{}; /**< Size of the memory. */
+    bool huge_{};        /**< Whether the memory lies on large pages. */
+    bool locked_{};      /**< Whether the memory is locked. */
+};
+
+/**
+ * @struct page_faults
+ * @brief Page faults of the process.
+ * @details A minor fault maps a page that is already in memory, whereas a major fault
+ *     waits for the page to be read from disk. Windows only counts both together, which
+ *     are reported as minor faults.
+ */
+struct page_faults {
+    uint64 minor{}; /**< Faults that were resolved without disk access. */
+    uint64 major{}; /**< Faults that read from disk. */
+};
+
+/**
+ * @brief Returns the number of page faults of the process since it started.
+ */
+[[nodiscard]]
+auto count_page_faults() noexcept -> page_faults;
+
+/**
+ * @brief Describes the scheduling of a thread for the console.
+ * @details Mentions the request only when it was not granted as is.
+ * @param[in] role Role of the thread in the pipeline.
+ * @param[in] settings Requested scheduling.
+ * @param[in] grant Scheduling that the thread got.
+ */
+[[nodiscard]]
+auto describe(std::string_view role, thread_settings const& settings,
+    thread_grant const& grant) -> std::string;
+
+} // namespace par
+
+#endif
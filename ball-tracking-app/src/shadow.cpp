@@ -0,0 +1,142 @@
+/**
+ * @file       shadow.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the shadow detector.
+ */
+
+#include "shadow.h"
+
+#include <cmath>
+#include <format>
+#include <optional>
+#include <string>
+#include <system_error>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @copydoc shadow_detector::shadow_detector
+ */
+shadow_detector::shadow_detector(detector_entry const& entry, int width, int height,
+    double tolerance, std::filesystem::path const& logfile
+):
+    detector_{entry.make(width, height, pool_)},
+    name_{entry.name},
+    tolerance_{tolerance},
+    log_{logfile, std::ios::app},
+    slot_{height, width, CV_8UC1}
+{
+    // Only a new log gets a header, as the rows of earlier runs are kept.
+    auto error = std::error_code{};
+    if (std::filesystem::file_size(logfile, error) == 0 or error) {
+        log_ << "frame,shadow,active found,active x,active y,active r,active ms,"
+            "shadow found,shadow x,shadow y,shadow r,shadow ms,distance,agree\n";
+    }
+    thread_ = std::jthread{[this](std::stop_token stop) { work(stop); }};
+}
+
+/**
+ * @copydoc shadow_detector::~shadow_detector
+ */
+shadow_detector::~shadow_detector() {
+    // Joins before the members that the thread uses go out of scope.
+    thread_ = {};
+}
+
+/**
+ * @copydoc shadow_detector::submit
+ */
+auto shadow_detector::submit(cv::Mat const& image, region window,
+    detect_settings const& settings, detection const& active) -> bool
+{
+    {
+        auto const lock = std::lock_guard{mutex_};
+        ++offered_;
+        if (busy_) {
+            ++summary_.skipped;
+            return false;
+        }
+        // The shadow thread leaves the slot alone until it is marked busy.
+        image_ = slot_(cv::Rect{0, 0, image.cols, image.rows});
+        image.copyTo(image_);
+        window_ = window;
+        settings_ = settings;
+        active_.candidates.assign(active.candidates.begin(), active.candidates.end());
+        active_.elapsed_ms = active.elapsed_ms;
+        frame_ = offered_;
+        busy_ = true;
+    }
+    ready_.notify_one();
+    return true;
+}
+
+/**
+ * @copydoc shadow_detector::summary
+ */
+auto shadow_detector::summary() const -> shadow_summary {
+    auto const lock = std::lock_guard{mutex_};
+    return summary_;
+}
+
+/**
+ * @copydoc shadow_detector::work
+ */
+auto shadow_detector::work(std::stop_token stop) -> void {
+    while (true) {
+        {
+            auto lock = std::unique_lock{mutex_};
+            if (not ready_.wait(lock, stop, [this] { return busy_; })) return;
+        }
+        detector_->detect(image_, window_, settings_, shadow_);
+        compare();
+    }
+}
+
+/**
+ * @copydoc shadow_detector::compare
+ */
+auto shadow_detector::compare() -> void {
+    auto const a = active_.best();
+    auto const s = shadow_.best();
+    auto distance = 0.0;
+    if (a and s) {
+        distance = std::hypot(a->x - s->x, a->y - s->y);
+    }
+    auto const agree = a.has_value() == s.has_value()
+        and distance <= tolerance_.load(std::memory_order_relaxed);
+
+    auto const field = [](std::optional<blob> const& ball) {
+        if (not ball) return std::string{"0,,,"};
+        return std::format("1,{:.2f},{:.2f},{:.2f}", ball->x, ball->y, ball->radius);
+    };
+    log_ << std::format("{},{},{},{:.3f},{},{:.3f},{:.2f},{}\n", frame_, name_,
+        field(a), active_.elapsed_ms, field(s), shadow_.elapsed_ms, distance,
+        agree ? 1 : 0);
+
+    activelatency_.add(active_.elapsed_ms);
+    shadowlatency_.add(shadow_.elapsed_ms);
+    auto const active_p50 = activelatency_.percentile(50.0);
+    auto const active_p99 = activelatency_.percentile(99.0);
+    auto const shadow_p50 = shadowlatency_.percentile(50.0);
+    auto const shadow_p99 = shadowlatency_.percentile(99.0);
+
+    auto const lock = std::lock_guard{mutex_};
+    ++summary_.compared;
+    summary_.disagreements += not agree;
+    summary_.active_p50 = active_p50;
+    summary_.active_p99 = active_p99;
+    summary_.shadow_p50 = shadow_p50;
+    summary_.shadow_p99 = shadow_p99;
+    busy_ = false;
+}
+
+} // namespace vis
@@ -0,0 +1,153 @@
+/**
+ * @file       shadow.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Side-by-side comparison of a candidate detector against the active one.
+ */
+
+#ifndef VIS_SHADOW_H
+#define VIS_SHADOW_H
+
+#include "detector.h"
+#include "pool.h"
+#include "stats.h"
+#include "vision.h"
+
+#include <opencv.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @struct shadow_summary
+ * @brief Running comparison between the active and the shadow detector.
+ */
+struct shadow_summary {
+    std::size_t compared;      /**< Number of compared frames. */
+    std::size_t skipped;       /**< Frames that arrived while the shadow was busy. */
+    std::size_t disagreements; /**< Compared frames on which the detectors disagreed. */
+    double active_p50;         /**< Median latency of the active detector. */
+    double active_p99;         /**< 99th percentile latency of the active detector. */
+    double shadow_p50;         /**< Median latency of the shadow detector. */
+    double shadow_p99;         /**< 99th percentile latency of the shadow detector. */
+};
+
+/**
+ * @class shadow_detector
+ * @brief Runs a second detector on the frames of the active one, off the critical path.
+ * @details Frames are handed over to a dedicated thread through a single slot. A frame
+ *     that arrives while the previous one is still being processed is skipped, so the
+ *     shadow never delays the control loop, however slow it is. The detectors disagree
+ *     when only one of them finds the ball, or when their positions are further apart
+ *     than the tolerance. Every compared frame is appended to a CSV log, so restarting
+ *     the shadow keeps the comparisons collected before. The slot is allocated for the
+ *     largest image upon construction, so smaller levels of the pyramid are copied into
+ *     a part of it without allocating.
+ */
+class shadow_detector {
+public:
+    /**
+     * @brief Starts a shadow detector.
+     * @param[in] entry Registered detector to run.
+     * @param[in] width Maximum width of the frames.
+     * @param[in] height Maximum height of the frames.
+     * @param[in] tolerance Maximum distance in pixels between agreeing positions.
+     * @param[in] logfile Path of the CSV log, which is appended to.
+     */
+    shadow_detector(detector_entry const& entry, int width, int height, double tolerance,
+        std::filesystem::path const& logfile);
+
+    /**
+     * @brief Stops the shadow thread and flushes the log.
+     */
+    ~shadow_detector();
+
+    shadow_detector(shadow_detector const&) = delete;
+    auto operator=(shadow_detector const&) -> shadow_detector& = delete;
+
+    /**
+     * @brief Offers a frame that the active detector just processed.
+     * @param[in] image Grayscale image, which is copied.
+     * @param[in] window Searched region of the image.
+     * @param[in] settings Parameters of the detection.
+     * @param[in] active Outcome of the active detector.
+     * @return If the shadow was idle and took the frame, returns true. Otherwise, the
+     *     frame is skipped and returns false.
+     */
+    auto submit(cv::Mat const& image, region window, detect_settings const& settings,
+        detection const& active) -> bool;
+
+    /**
+     * @brief Changes the maximum distance in pixels between agreeing positions.
+     * @details Applies from the next compared frame onward. May be called from any
+     *     thread.
+     */
+    auto set_tolerance(double tolerance) noexcept -> void
+    { tolerance_.store(tolerance, std::memory_order_relaxed); }
+
+    /**
+     * @brief Returns the comparison so far.
+     */
+    [[nodiscard]]
+    auto summary() const -> shadow_summary;
+
+    /**
+     * @brief Returns the name of the shadow detector.
+     */
+    [[nodiscard]]
+    constexpr auto name() const noexcept -> std::string_view
+    { return name_; }
+
+private:
+    /**
+     * @brief Main loop of the shadow thread.
+     */
+    auto work(std::stop_token stop) -> void;
+
+    /**
+     * @brief Compares the outcomes of the current frame and logs them.
+     */
+    auto compare() -> void;
+
+    par::worker_pool pool_;                /**< Inline pool, as the shared one is busy. */
+    std::unique_ptr<detector> detector_;   /**< Shadow detector. */
+    std::string_view name_;                /**< Name of the shadow detector. */
+    std::atomic<double> tolerance_;        /**< Maximum distance of agreeing positions. */
+    std::ofstream log_;                    /**< Comparison log. */
+    cv::Mat slot_;                         /**< Storage of the largest image. */
+    cv::Mat image_;                        /**< Current image, a part of the slot. */
+    region window_{};                      /**< Searched region of the current frame. */
+    detect_settings settings_{};           /**< Parameters of the current frame. */
+    detection active_;                     /**< Outcome of the active detector. */
+    detection shadow_;                     /**< Outcome of the shadow detector. */
+    std::size_t frame_{};                  /**< Index of the current frame. */
+    perf::latency_stats activelatency_;    /**< Latency of the active detector. */
+    perf::latency_stats shadowlatency_;    /**< Latency of the shadow detector. */
+    mutable std::mutex mutex_;             /**< Guards the slot and the summary. */
+    std::condition_variable_any ready_;    /**< Signals a frame in the slot. */
+    bool busy_{false};                     /**< Whether the slot holds a frame. */
+    std::size_t offered_{};                /**< Number of offered frames. */
+    shadow_summary summary_{};             /**< Comparison so far. */
+    std::jthread thread_;                  /**< Shadow thread, started last. */
+};
+
+} // namespace vis
+
+#endif
@@ -0,0 +1,111 @@
+/**
+ * @file       shutter.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the rolling shutter timing.
+ */
+
+#include "shutter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+/**
+ * @namespace cam
+ * @brief Camera related components.
+ */
+namespace cam {
+
+namespace {
+
+/**
+ * @brief Seconds per second that the anchor of the camera clock may drift later.
+ */
+constexpr auto maxdrift = 0.005;
+
+/**
+ * @brief Seconds that the camera clock may be off before it is synchronized anew.
+ */
+constexpr auto maxerror = 0.5;
+
+/**
+ * @brief Converts a number of seconds to a duration of the clock.
+ */
+inline auto to_duration(double seconds) noexcept -> perf::clock::duration {
+    return std::chrono::duration_cast<perf::clock::duration>(
+        std::chrono::duration<double>{seconds});
+}
+
+} // namespace
+
+/**
+ * @copydoc rolling_shutter::update
+ */
+auto rolling_shutter::update(uint32 pts, perf::clock::time_point arrival) noexcept
+    -> void
+{
+    // Unsigned subtraction follows the timestamp across its wrap-around.
+    auto const delta = pts - lastpts_;
+    lastpts_ = pts;
+    end_ = arrival;
+    if (frames_ == 0 or delta == 0 or settings_.rate <= 0.0) {
+        restart(arrival);
+        return;
+    }
+
+    // The smallest increment spans a single frame, any larger one a dropped frame.
+    auto const anchored = period_ > 0 and delta >= period_;
+    period_ = anchored ? period_ : delta;
+    ticks_ += delta;
+    ++frames_;
+    auto const frequency = static_cast<double>(period_) * settings_.rate;
+    auto const clock = static_cast<double>(ticks_) / frequency;
+    auto const sample = std::chrono::duration<double>{arrival - base_}.count() - clock;
+    if (anchored and std::abs(sample - offset_) > maxerror) {
+        // The camera clock jumped, which happens when the stream restarts.
+        restart(arrival);
+        return;
+    }
+    // Every frame arrives at least as late as the end of its readout, so the earliest
+    // arrival relative to the camera clock bounds the readout end best.
+    offset_ = anchored
+        ? std::min(offset_ + maxdrift * delta / frequency, sample) : sample;
+    if (synchronized()) {
+        end_ = base_ + to_duration(clock + offset_);
+    }
+}
+
+/**
+ * @copydoc rolling_shutter::restart
+ */
+auto rolling_shutter::restart(perf::clock::time_point arrival) noexcept -> void {
+    base_ = arrival;
+    end_ = arrival;
+    ticks_ = 0;
+    period_ = 0;
+    offset_ = 0.0;
+    frames_ = 1;
+}
+
+/**
+ * @copydoc rolling_shutter::row_time
+ */
+auto rolling_shutter::row_time(double row) const noexcept -> perf::clock::time_point {
+    if (settings_.rows <= 0) return end_;
+    auto const share = std::clamp((row + 0.5) / settings_.rows, 0.0, 1.0);
+    return end_ - to_duration((1.0 - share) * readout_time());
+}
+
+/**
+ * @copydoc rolling_shutter::readout_time
+ */
+auto rolling_shutter::readout_time() const noexcept -> double {
+    return settings_.rate > 0.0 ? settings_.readout / settings_.rate : 0.0;
+}
+
+} // namespace cam
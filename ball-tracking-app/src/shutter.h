@@ -0,0 +1,128 @@
+/**
+ * @file       shutter.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Readout timing of the rolling shutter of the camera.
+ */
+
+#ifndef CAM_SHUTTER_H
+#define CAM_SHUTTER_H
+
+#include "stats.h"
+#include "types.h"
+
+/**
+ * @namespace cam
+ * @brief Camera related components.
+ */
+namespace cam {
+
+/**
+ * @struct shutter_settings
+ * @brief Parameters of the rolling shutter.
+ */
+struct shutter_settings {
+    double rate;    /**< Frame rate of the camera in frames per second. */
+    int rows;       /**< Number of rows of a frame. */
+    double readout; /**< Share of the frame period in which the rows are read out. */
+};
+
+/**
+ * @class rolling_shutter
+ * @brief Derives the point in time at which each row of a frame was read out.
+ * @details The sensor reads out its rows one after another, so the rows of a single
+ *     frame are exposed at different points in time, spread over most of the frame
+ *     period. The timing of a frame follows from its UVC presentation timestamp, which
+ *     the camera stamps from its own clock and is therefore free of the jitter of the
+ *     USB transfers and of the host scheduler. The clock runs at an unknown frequency,
+ *     so a single frame period in ticks is taken from the smallest increment between
+ *     two frames, which skips dropped frames, and tied to the configured frame rate.
+ *
+ *     The timestamps are anchored to the host clock through the earliest arrival of a
+ *     frame relative to its timestamp, which is taken as the end of its readout. The
+ *     anchor is allowed to drift later slowly, so a small mismatch between the actual
+ *     and configured frame rate is followed. Until the clock is synchronized, the
+ *     arrival of the frame itself is taken as the end of its readout.
+ *
+ *     The exposure of each row ends when it is read out, so the timestamps trail the
+ *     middle of the exposures by half the exposure time, which is the same for every
+ *     row.
+ */
+class rolling_shutter {
+public:
+    /**
+     * @brief Default constructs a shutter that has no frame.
+     */
+    rolling_shutter() = default;
+
+    /**
+     * @brief Constructs a shutter with the given parameters.
+     * @param[in] settings Parameters of the shutter.
+     */
+    explicit rolling_shutter(shutter_settings const& settings) noexcept
+        : settings_{settings} {}
+
+    /**
+     * @brief Accounts for the timing of a new frame.
+     * @param[in] pts Presentation timestamp of the frame in ticks of the camera clock.
+     * @param[in] arrival Point in time at which the frame arrived at the host.
+     */
+    auto update(uint32 pts, perf::clock::time_point arrival) noexcept -> void;
+
+    /**
+     * @brief Returns the point in time at which a row of the last frame was read out.
+     * @param[in] row Row of the frame, which may be fractional.
+     */
+    [[nodiscard]]
+    auto row_time(double row) const noexcept -> perf::clock::time_point;
+
+    /**
+     * @brief Returns the point in time at which the middle row of the last frame was
+     *     read out.
+     */
+    [[nodiscard]]
+    auto frame_time() const noexcept -> perf::clock::time_point
+    { return row_time(0.5 * settings_.rows); }
+
+    /**
+     * @brief Returns the number of seconds between the readout of the first and last
+     *     row of a frame.
+     */
+    [[nodiscard]]
+    auto readout_time() const noexcept -> double;
+
+    /**
+     * @brief Returns whether the timestamps of the camera clock are in use.
+     */
+    [[nodiscard]]
+    constexpr auto synchronized() const noexcept -> bool
+    { return period_ > 0 and frames_ >= minframes; }
+
+private:
+    /**
+     * @brief Number of frames before the camera clock is trusted.
+     */
+    static constexpr auto minframes = 30;
+
+    /**
+     * @brief Starts the synchronization anew from a frame.
+     */
+    auto restart(perf::clock::time_point arrival) noexcept -> void;
+
+    shutter_settings settings_{};  /**< Parameters of the shutter. */
+    perf::clock::time_point end_;  /**< Readout end of the last frame. */
+    perf::clock::time_point base_; /**< Arrival of the first frame. */
+    uint32 lastpts_{};             /**< Timestamp of the last frame. */
+    int64 ticks_{};                /**< Camera clock ticks since the first frame. */
+    uint32 period_{};              /**< Ticks of the camera clock per frame, or 0. */
+    double offset_{};              /**< Seconds from camera clock to readout end. */
+    int frames_{};                 /**< Number of frames so far. */
+};
+
+} // namespace cam
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file       simd.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Detection of the available SIMD instruction sets.
+ * @details Defines SIMD_SSE2 when SSE2 intrinsics can be used. SSE2 is always available
+ *     on x64 targets. Every vectorized kernel is required to provide a scalar fallback.
+ *     Vector helpers that several kernels share live here as well.
+ */
+
+#ifndef SIMD_SIMD_H
+#define SIMD_SIMD_H
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef SIMD_SSE2
+/**
+ * @namespace simd
+ * @brief Vector helpers of the SIMD kernels.
+ */
+namespace simd {
+
+/**
+ * @brief Averages the 2x2 byte quads of two rows into 16-bit lanes, rounded to nearest.
+ */
+inline auto average_quads(__m128i top, __m128i bottom) noexcept -> __m128i {
+    auto const low = _mm_set1_epi16(0x00ff);
+    auto const sum = _mm_add_epi16(
+        _mm_add_epi16(_mm_and_si128(top, low), _mm_srli_epi16(top, 8)),
+        _mm_add_epi16(_mm_and_si128(bottom, low), _mm_srli_epi16(bottom, 8)));
+    return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+} // namespace simd
+#endif
+
+#endif
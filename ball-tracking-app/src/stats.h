@@ -0,0 +1,129 @@
+/**
+ * @file       stats.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Timing and latency statistics.
+ */
+
+#ifndef PERF_STATS_H
+#define PERF_STATS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+/**
+ * @namespace perf
+ * @brief Performance measurement related components.
+ */
+namespace perf {
+
+/**
+ * @typedef clock
+ * @brief Monotonic clock used for all performance measurements.
+ */
+using clock = std::chrono::steady_clock;
+
+/**
+ * @brief Returns the time in milliseconds that elapsed between two points in time.
+ * @param[in] start Earliest point in time.
+ * @param[in] stop Latest point in time. Defaulted to the current time.
+ */
+[[nodiscard]]
+inline auto elapsed_ms(clock::time_point start, clock::time_point stop = clock::now())
+    -> double
+{ return std::chrono::duration<double, std::milli>{stop - start}.count(); }
+
+/**
+ * @class latency_stats
+ * @brief Keeps a window of the most recent latency samples.
+ * @details Storage is allocated once upon construction, so adding samples never
+ *     allocates. Once the window is full, the oldest samples are overwritten.
+ */
+class latency_stats {
+public:
+    /**
+     * @brief Constructs an empty set of statistics.
+     * @param[in] capacity Maximum number of samples to keep. Defaulted to 1024.
+     */
+    explicit latency_stats(std::size_t capacity = 1'024)
+    { samples_.reserve(std::max<std::size_t>(capacity, 1)); }
+
+    /**
+     * @brief Adds a latency sample.
+     * @param[in] ms Latency in milliseconds.
+     */
+    auto add(double ms) -> void {
+        if (samples_.size() < samples_.capacity()) {
+            samples_.push_back(ms);
+        } else {
+            samples_[next_] = ms;
+        }
+        next_ = (next_ + 1) % samples_.capacity();
+        ++count_;
+    }
+
+    /**
+     * @brief Removes all samples.
+     */
+    auto clear() noexcept -> void {
+        samples_.clear();
+        next_ = 0;
+        count_ = 0;
+    }
+
+    /**
+     * @brief Returns the given percentile of the kept samples, or zero if there are none.
+     * @details Sorts a copy of the samples, so avoid calling this in a hot path.
+     * @param[in] p Percentile in the range [0, 100].
+     */
+    [[nodiscard]]
+    auto percentile(double p) const -> double {
+        if (samples_.empty()) return 0.0;
+        auto sorted = samples_;
+        auto const rank = std::clamp(p, 0.0, 100.0) / 100.0 * (sorted.size() - 1);
+        auto const nth = sorted.begin() + static_cast<std::ptrdiff_t>(rank + 0.5);
+        std::ranges::nth_element(sorted, nth);
+        return *nth;
+    }
+
+    /**
+     * @brief Returns the mean of the kept samples, or zero if there are none.
+     */
+    [[nodiscard]]
+    auto mean() const noexcept -> double {
+        if (samples_.empty()) return 0.0;
+        return std::reduce(samples_.begin(), samples_.end()) / samples_.size();
+    }
+
+    /**
+     * @brief Returns the largest kept sample, or zero if there are none.
+     */
+    [[nodiscard]]
+    auto max() const noexcept -> double {
+        if (samples_.empty()) return 0.0;
+        return std::ranges::max(samples_);
+    }
+
+    /**
+     * @brief Returns the total number of samples added since the last clear.
+     */
+    [[nodiscard]]
+    constexpr auto count() const noexcept -> std::size_t
+    { return count_; }
+
+private:
+    std::vector<double> samples_; /**< Most recent samples. */
+    std::size_t next_{};          /**< Index of the next sample to overwrite. */
+    std::size_t count_{};         /**< Number of samples added. */
+};
+
+} // namespace perf
+
+#endif
@@ -0,0 +1,67 @@
+/**
+ * @file       track.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the region of interest tracking.
+ */
+
+#include "track.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @copydoc roi_tracker::roi_tracker
+ */
+roi_tracker::roi_tracker(int width, int height, int maxmisses) noexcept:
+    width_{width},
+    height_{height},
+    maxmisses_{std::max(maxmisses, 1)}
+{}
+
+/**
+ * @copydoc roi_tracker::window
+ */
+auto roi_tracker::window(float x, float y, float spreadx, float spready, int maxradius)
+    const noexcept -> region
+{
+    if (not locked_) return {0, 0, width_, height_};
+
+    constexpr auto margin = 4;
+    auto const rx = maxradius + margin + static_cast<int>(std::ceil(3.f * spreadx));
+    auto const ry = maxradius + margin + static_cast<int>(std::ceil(3.f * spready));
+    auto const x0 = std::clamp(static_cast<int>(x) - rx, 0, width_);
+    auto const y0 = std::clamp(static_cast<int>(y) - ry, 0, height_);
+    auto const x1 = std::clamp(static_cast<int>(x) + rx + 1, 0, width_);
+    auto const y1 = std::clamp(static_cast<int>(y) + ry + 1, 0, height_);
+    return {x0, y0, x1 - x0, y1 - y0};
+}
+
+/**
+ * @copydoc roi_tracker::update
+ */
+auto roi_tracker::update(bool found) noexcept -> void {
+    if (not found) {
+        if (locked_ and ++misses_ >= maxmisses_) {
+            locked_ = false;
+        }
+        return;
+    }
+    if (not locked_) {
+        reacquisitions_ += acquired_;
+    }
+    misses_ = 0;
+    locked_ = acquired_ = true;
+}
+
+} // namespace vis
@@ -0,0 +1,99 @@
+/**
+ * @file       track.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Region of interest tracking of the ball.
+ */
+
+#ifndef VIS_TRACK_H
+#define VIS_TRACK_H
+
+#include "blob.h"
+
+#include <cstddef>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @class roi_tracker
+ * @brief Selects the region of the frame that the ball is to be searched in.
+ * @details While the ball is tracked, only a window around its predicted position is
+ *     searched. The window covers the ball radius plus three times the uncertainty of
+ *     the prediction, which grows with every frame that the ball is missed. After too
+ *     many consecutive misses, the ball is considered lost and the full frame is
+ *     searched until it is found again, which counts as a re-acquisition.
+ */
+class roi_tracker {
+public:
+    /**
+     * @brief Default constructs a tracker that always searches an empty frame.
+     */
+    roi_tracker() = default;
+
+    /**
+     * @brief Constructs a tracker for frames of the given size.
+     * @param[in] width Width of the frames.
+     * @param[in] height Height of the frames.
+     * @param[in] maxmisses Number of consecutive misses after which the ball is lost.
+     */
+    roi_tracker(int width, int height, int maxmisses = 3) noexcept;
+
+    /**
+     * @brief Returns the region to search for the ball in the next frame.
+     * @param[in] x Predicted position along the x-axis.
+     * @param[in] y Predicted position along the y-axis.
+     * @param[in] spreadx Standard deviation of the prediction along the x-axis.
+     * @param[in] spready Standard deviation of the prediction along the y-axis.
+     * @param[in] maxradius Maximum radius of the ball.
+     */
+    [[nodiscard]]
+    auto window(float x, float y, float spreadx, float spready, int maxradius) const
+        noexcept -> region;
+
+    /**
+     * @brief Updates the tracker with the outcome of a search.
+     * @param[in] found Whether the ball was found.
+     */
+    auto update(bool found) noexcept -> void;
+
+    /**
+     * @brief Drops the lock on the ball, so the next search covers the full frame.
+     */
+    auto reset() noexcept -> void
+    { locked_ = false; }
+
+    /**
+     * @brief Returns whether the ball is currently tracked.
+     */
+    [[nodiscard]]
+    constexpr auto locked() const noexcept -> bool
+    { return locked_; }
+
+    /**
+     * @brief Returns the number of times the ball was found again after it was lost.
+     */
+    [[nodiscard]]
+    constexpr auto reacquisitions() const noexcept -> std::size_t
+    { return reacquisitions_; }
+
+private:
+    int width_{};                  /**< Width of the frames. */
+    int height_{};                 /**< Height of the frames. */
+    int maxmisses_{};              /**< Misses after which the ball is lost. */
+    int misses_{};                 /**< Consecutive misses since the last detection. */
+    bool locked_{false};           /**< Whether the ball is tracked. */
+    bool acquired_{false};         /**< Whether the ball was ever found. */
+    std::size_t reacquisitions_{}; /**< Number of re-acquisitions. */
+};
+
+} // namespace vis
+
+#endif
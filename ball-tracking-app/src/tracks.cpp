@@ -0,0 +1,174 @@
+/**
+ * @file       tracks.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the multi-target tracker.
+ */
+
+#include "tracks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+
+/**
+ * @namespace est
+ * @brief State estimation related components.
+ */
+namespace est {
+
+/**
+ * @copydoc multi_tracker::multi_tracker
+ */
+multi_tracker::multi_tracker(track_settings const& settings):
+    settings_{settings}
+{
+    auto const capacity = static_cast<std::size_t>(std::max(settings.maxtracks, 1));
+    auto const observations = static_cast<std::size_t>(
+        std::max(settings.maxobservations, 1));
+    tracks_.reserve(capacity);
+    gates_.reserve(capacity);
+    pairs_.reserve(capacity * observations);
+    taken_.reserve(observations);
+}
+
+/**
+ * @copydoc multi_tracker::update
+ */
+auto multi_tracker::update(perf::clock::time_point time,
+    std::span<observation const> observations) -> void
+{
+    pair(time, observations);
+    std::ranges::sort(pairs_, {}, &pairing::cost);
+    taken_.assign(observations.size(), 0);
+    for (auto& track : tracks_) {
+        track.observed = false;
+    }
+    for (auto const& pairing : pairs_) {
+        auto& track = tracks_[pairing.track];
+        if (track.observed or taken_[pairing.observation]) continue;
+        auto const& observed = observations[pairing.observation];
+        track.filter.update(observed.time, observed.position);
+        track.measured = observed.position;
+        track.radius = observed.radius;
+        track.time = observed.time;
+        track.observed = true;
+        track.hits += 1;
+        track.confirmed = track.confirmed or track.hits >= settings_.confirmations;
+        taken_[pairing.observation] = 1;
+    }
+
+    // A tentative track that misses a frame was most likely a false detection.
+    std::erase_if(tracks_, [&](track const& track) {
+        return not track.observed
+            and (not track.confirmed or not track.filter.tracking(time));
+    });
+
+    for (std::size_t i{}; i < observations.size(); ++i) {
+        if (taken_[i]) continue;
+        if (std::ssize(tracks_) >= settings_.maxtracks) break;
+        auto& track = tracks_.emplace_back(est::track{
+            .id = nextid_++,
+            .filter = kalman_filter{settings_.filter},
+            .measured = observations[i].position,
+            .radius = observations[i].radius,
+            .time = observations[i].time,
+            .hits = 1,
+            .confirmed = settings_.confirmations <= 1,
+            .observed = true});
+        track.filter.update(track.time, track.measured);
+    }
+    select();
+}
+
+/**
+ * @copydoc multi_tracker::update_velocity
+ */
+auto multi_tracker::update_velocity(vec2 velocity, vec2 variance) noexcept -> void {
+    for (auto& track : tracks_) {
+        if (track.id == target_) {
+            track.filter.update_velocity(velocity, variance);
+        }
+    }
+}
+
+/**
+ * @copydoc multi_tracker::target
+ */
+auto multi_tracker::target() const noexcept -> track const* {
+    auto const found = std::ranges::find(tracks_, target_, &track::id);
+    return found == tracks_.end() ? nullptr : &*found;
+}
+
+/**
+ * @copydoc multi_tracker::reset
+ */
+auto multi_tracker::reset() noexcept -> void {
+    tracks_.clear();
+    target_ = 0;
+}
+
+/**
+ * @copydoc multi_tracker::pair
+ */
+auto multi_tracker::pair(perf::clock::time_point time,
+    std::span<observation const> observations) -> void
+{
+    pairs_.clear();
+    gates_.clear();
+    auto widest = 0.0;
+    auto fastest = 0.0;
+    for (std::size_t i{}; i < tracks_.size(); ++i) {
+        auto const& track = tracks_[i];
+        auto const spread = track.filter.spread(time);
+        auto const velocity = track.filter.velocity();
+        auto const reach = std::max(
+            settings_.gate * std::max(spread.x, spread.y), track.radius);
+        gates_.push_back({track.filter.predict(time), reach, i});
+        widest = std::max(widest, reach);
+        fastest = std::max(fastest, std::hypot(velocity.x, velocity.y));
+    }
+    std::ranges::sort(gates_, {}, [](gate const& gate) { return gate.position.x; });
+
+    for (std::size_t j{}; j < observations.size(); ++j) {
+        auto const& observed = observations[j];
+        auto const position = observed.position;
+        // The tracks move on between the frame and the row of the detection.
+        auto const lag = std::abs(
+            std::chrono::duration<double>{observed.time - time}.count());
+        auto const window = widest + fastest * lag;
+        auto const first = std::ranges::lower_bound(gates_, position.x - window, {},
+            [](gate const& gate) { return gate.position.x; });
+        for (auto it = first; it != gates_.end(); ++it) {
+            if (it->position.x > position.x + window) break;
+            auto const predicted = tracks_[it->track].filter.predict(observed.time);
+            auto const distance = std::hypot(
+                position.x - predicted.x, position.y - predicted.y);
+            if (distance <= it->reach) {
+                pairs_.push_back({distance / it->reach, it->track, j});
+            }
+        }
+    }
+}
+
+/**
+ * @copydoc multi_tracker::select
+ */
+auto multi_tracker::select() noexcept -> void {
+    if (target() != nullptr) return;
+    target_ = 0;
+    auto hits = 0;
+    for (auto const& track : tracks_) {
+        if (track.confirmed and track.hits > hits) {
+            target_ = track.id;
+            hits = track.hits;
+        }
+    }
+}
+
+} // namespace est
@@ -0,0 +1,189 @@
+/**
+ * @file       tracks.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Tracking of multiple balls with identities.
+ */
+
+#ifndef EST_TRACKS_H
+#define EST_TRACKS_H
+
+#include "estimate.h"
+#include "stats.h"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+/**
+ * @namespace est
+ * @brief State estimation related components.
+ */
+namespace est {
+
+/**
+ * @struct track_settings
+ * @brief Parameters of the multi-target tracker.
+ */
+struct track_settings {
+    kalman_settings filter; /**< Parameters of the filter of every track. */
+    double gate;            /**< Standard deviations of the prediction to associate in. */
+    int confirmations;      /**< Associated detections before a track is confirmed. */
+    int maxtracks;          /**< Maximum number of tracks at a time. */
+    int maxobservations;    /**< Maximum number of observations per frame. */
+};
+
+/**
+ * @struct observation
+ * @brief Detected ball to associate with the tracks.
+ */
+struct observation {
+    vec2 position;                /**< Detected position in pixels. */
+    double radius;                /**< Detected radius in pixels. */
+    perf::clock::time_point time; /**< Point in time at which the ball was seen. */
+};
+
+/**
+ * @struct track
+ * @brief Ball that is followed over consecutive frames.
+ */
+struct track {
+    int id;                       /**< Identity of the track, unique until a reset. */
+    kalman_filter filter;         /**< State estimate of the ball. */
+    vec2 measured;                /**< Position of the last associated detection. */
+    double radius;                /**< Radius of the last associated detection. */
+    perf::clock::time_point time; /**< Point in time of the last associated detection. */
+    int hits;                     /**< Number of associated detections. */
+    bool confirmed;               /**< Whether the track has enough detections. */
+    bool observed;                /**< Whether the last update associated a detection. */
+};
+
+/**
+ * @class multi_tracker
+ * @brief Follows every ball in view and selects the one that is controlled.
+ * @details Every update, each detection is associated with at most one track, and each
+ *     track with at most one detection. A detection is only considered for a track
+ *     within a gate around its predicted position, which spans the configured number of
+ *     standard deviations of the prediction but never less than the ball radius. Each
+ *     detection is compared with the prediction at its own point in time, so balls in
+ *     different rows of a rolling shutter frame are each taken at their readout. The
+ *     gated pairs are assigned greedily, the closest relative to its gate first. The
+ *     tracks are kept sorted by their predicted position along the x-axis, so every
+ *     detection only visits the tracks within the widest gate of its column, and the
+ *     association grows about linearly with the number of balls instead of
+ *     quadratically.
+ *
+ *     A detection that no track takes starts a tentative track, which is dropped as soon
+ *     as it misses a frame, so a single false detection never gains control. Once a
+ *     track is confirmed, it coasts on its filter until the maximum coasting time
+ *     passes. The controlled target is kept for as long as its track exists, so a second
+ *     ball, a reflection or a hand in view cannot take over. Without a target, the
+ *     confirmed track with the most detections is selected.
+ */
+class multi_tracker {
+public:
+    /**
+     * @brief Default constructs a tracker without any tracks.
+     */
+    multi_tracker() = default;
+
+    /**
+     * @brief Constructs a tracker with the given parameters.
+     * @details Reserves room for the tracks and their pairings, so updating with at most
+     *     the maximum number of observations never allocates.
+     * @param[in] settings Parameters of the tracker.
+     */
+    explicit multi_tracker(track_settings const& settings);
+
+    /**
+     * @brief Associates the detections of a frame with the tracks.
+     * @param[in] time Point in time of the frame, at which tracks without detections
+     *     are judged.
+     * @param[in] observations Detections of the frame, the most confident first, since
+     *     they are the first to start new tracks while the number of tracks is limited.
+     */
+    auto update(perf::clock::time_point time, std::span<observation const> observations)
+        -> void;
+
+    /**
+     * @brief Corrects the state of the target with a measured velocity.
+     * @details Without a target, the velocity is ignored.
+     * @param[in] velocity Measured velocity in pixels per second.
+     * @param[in] variance Variance of the measured velocity along either axis.
+     */
+    auto update_velocity(vec2 velocity, vec2 variance) noexcept -> void;
+
+    /**
+     * @brief Returns the controlled target, or a null pointer without one.
+     * @details The pointer is invalidated by the next update or reset.
+     */
+    [[nodiscard]]
+    auto target() const noexcept -> track const*;
+
+    /**
+     * @brief Returns the identity of the controlled target, or 0 without one.
+     */
+    [[nodiscard]]
+    constexpr auto target_id() const noexcept -> int
+    { return target_; }
+
+    /**
+     * @brief Returns every track, in no particular order.
+     */
+    [[nodiscard]]
+    auto tracks() const noexcept -> std::span<track const>
+    { return tracks_; }
+
+    /**
+     * @brief Drops every track, so the next detections start anew.
+     */
+    auto reset() noexcept -> void;
+
+private:
+    /**
+     * @struct pairing
+     * @brief Detection within the gate of a track.
+     */
+    struct pairing {
+        double cost;             /**< Distance relative to the gate of the track. */
+        std::size_t track;       /**< Index of the track. */
+        std::size_t observation; /**< Index of the detection. */
+    };
+
+    /**
+     * @struct gate
+     * @brief Predicted position of a track and the distance it takes detections within.
+     */
+    struct gate {
+        vec2 position;     /**< Position of the track predicted for the frame. */
+        double reach;      /**< Distance within which detections are considered. */
+        std::size_t track; /**< Index of the track. */
+    };
+
+    /**
+     * @brief Collects the detections within the gates of the tracks.
+     */
+    auto pair(perf::clock::time_point time, std::span<observation const> observations)
+        -> void;
+
+    /**
+     * @brief Keeps the target or, without one, selects the most established track.
+     */
+    auto select() noexcept -> void;
+
+    track_settings settings_{};  /**< Parameters of the tracker. */
+    std::vector<track> tracks_;  /**< Every track. */
+    std::vector<gate> gates_;    /**< Gates of the tracks, sorted along the x-axis. */
+    std::vector<pairing> pairs_; /**< Gated pairs of tracks and detections. */
+    std::vector<char> taken_;    /**< Whether each detection is associated. */
+    int nextid_{1};              /**< Identity of the next track. */
+    int target_{};               /**< Identity of the target, or 0 without one. */
+};
+
+} // namespace est
+
+#endif
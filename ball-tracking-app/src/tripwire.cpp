@@ -0,0 +1,111 @@
+/**
+ * @file       tripwire.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the allocation tripwire.
+ */
+
+#include "tripwire.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <iterator>
+#include <new>
+
+#if defined(PERF_COUNT_ALLOCATIONS)
+
+namespace {
+
+/**
+ * @brief Number of calls to the global allocation function by the calling thread.
+ */
+thread_local std::size_t allocations{};
+
+/**
+ * @brief Number of calls to the global allocation function by any thread.
+ */
+std::atomic<std::size_t> totalallocations{};
+
+} // namespace
+
+/**
+ * @brief Counts and performs a heap allocation.
+ * @details Replaces the global allocation function, through which the array and
+ *     non-throwing forms allocate as well.
+ */
+auto operator new(std::size_t size) -> void* {
+    ++allocations;
+    totalallocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto* const memory = std::malloc(std::max<std::size_t>(size, 1))) return memory;
+    throw std::bad_alloc{};
+}
+
+/**
+ * @brief Releases memory of the counting allocation function.
+ */
+auto operator delete(void* memory) noexcept -> void
+{ std::free(memory); }
+
+/**
+ * @brief Releases memory of the counting allocation function.
+ */
+auto operator delete(void* memory, std::size_t) noexcept -> void
+{ std::free(memory); }
+
+#endif
+
+/**
+ * @namespace perf
+ * @brief Performance measurement related components.
+ */
+namespace perf {
+
+/**
+ * @copydoc thread_allocations
+ */
+auto thread_allocations() noexcept -> std::size_t {
+#if defined(PERF_COUNT_ALLOCATIONS)
+    return allocations;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @copydoc total_allocations
+ */
+auto total_allocations() noexcept -> std::size_t {
+#if defined(PERF_COUNT_ALLOCATIONS)
+    return totalallocations.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @copydoc allocation_tripwire::end
+ */
+auto allocation_tripwire::end() -> void {
+    if constexpr (not counting_allocations) return;
+
+    auto const allocated = thread_allocations() - start_;
+    if (remaining_.load(std::memory_order_relaxed) > 0) {
+        remaining_.fetch_sub(1, std::memory_order_relaxed);
+        reported_ = false;
+        return;
+    }
+    if (allocated == 0) return;
+    trips_.fetch_add(1, std::memory_order_relaxed);
+    if (reported_) return;
+    reported_ = true;
+    std::format_to(std::ostreambuf_iterator<char>{std::cerr},
+        "{} stage made {} allocations in a steady-state iteration\n", stage_, allocated);
+}
+
+} // namespace perf
@@ -0,0 +1,120 @@
+/**
+ * @file       tripwire.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Detection of heap allocations in the steady state of the pipeline stages.
+ */
+
+#ifndef PERF_TRIPWIRE_H
+#define PERF_TRIPWIRE_H
+
+#include <atomic>
+#include <cstddef>
+#include <string_view>
+
+/**
+ * @namespace perf
+ * @brief Performance measurement related components.
+ */
+namespace perf {
+
+#if not defined(NDEBUG) and not defined(PERF_COUNT_ALLOCATIONS)
+#define PERF_COUNT_ALLOCATIONS
+#endif
+
+/**
+ * @brief Whether the heap allocations are counted.
+ * @details Debug builds, and builds that define PERF_COUNT_ALLOCATIONS like the
+ *     benchmark, replace the global allocation function to count them. Other release
+ *     builds keep the allocator of the runtime as is.
+ */
+#if defined(PERF_COUNT_ALLOCATIONS)
+inline constexpr auto counting_allocations = true;
+#else
+inline constexpr auto counting_allocations = false;
+#endif
+
+/**
+ * @brief Returns the number of heap allocations that the calling thread made so far.
+ * @details Counts the calls to the global allocation function, through which the
+ *     standard containers allocate. Memory that OpenCV allocates itself is not counted.
+ *     Always returns 0 unless allocations are counted.
+ */
+[[nodiscard]]
+auto thread_allocations() noexcept -> std::size_t;
+
+/**
+ * @brief Returns the number of heap allocations that all threads made so far.
+ * @details Counts the same calls as thread_allocations, from any thread. Always returns
+ *     0 unless allocations are counted.
+ */
+[[nodiscard]]
+auto total_allocations() noexcept -> std::size_t;
+
+/**
+ * @class allocation_tripwire
+ * @brief Reports heap allocations in the iterations of a pipeline stage, once the
+ *     stage has warmed up.
+ * @details The first iterations after construction or rearming fill buffers that are
+ *     allocated lazily and are not checked. Every later iteration is expected to reuse
+ *     those buffers, so one that allocates trips the wire, which is reported on the
+ *     console once per warm-up. The wire does nothing unless allocations are counted.
+ */
+class allocation_tripwire {
+public:
+    /**
+     * @brief Constructs a wire that is armed after the given number of iterations.
+     * @param[in] stage Name of the stage, required to outlive the wire.
+     * @param[in] warmup Number of iterations before allocations trip the wire.
+     */
+    explicit allocation_tripwire(std::string_view stage, int warmup = 100) noexcept:
+        stage_{stage},
+        warmup_{warmup},
+        remaining_{warmup}
+    {}
+
+    /**
+     * @brief Starts a new warm-up, after the stage changed in a way that may need new
+     *     buffers.
+     * @details May be called from any thread.
+     */
+    auto rearm() noexcept -> void
+    { remaining_.store(warmup_, std::memory_order_relaxed); }
+
+    /**
+     * @brief Marks the start of an iteration.
+     * @details Only to be called by the thread of the stage.
+     */
+    auto begin() noexcept -> void
+    { start_ = thread_allocations(); }
+
+    /**
+     * @brief Marks the end of an iteration, and trips the wire if it allocated after
+     *     the warm-up.
+     * @details Only to be called by the thread of the stage, after begin.
+     */
+    auto end() -> void;
+
+    /**
+     * @brief Returns the number of iterations that tripped the wire.
+     */
+    [[nodiscard]]
+    auto trips() const noexcept -> std::size_t
+    { return trips_.load(std::memory_order_relaxed); }
+
+private:
+    std::string_view stage_;           /**< Name of the stage. */
+    int warmup_;                       /**< Iterations before the wire is armed. */
+    std::atomic<int> remaining_;       /**< Iterations left in the warm-up. */
+    std::size_t start_{};              /**< Allocations at the start of an iteration. */
+    std::atomic<std::size_t> trips_{}; /**< Iterations that allocated once armed. */
+    bool reported_{};                  /**< Whether this warm-up was reported. */
+};
+
+} // namespace perf
+
+#endif
@@ -0,0 +1,127 @@
+/**
+ * @file       vision.cpp
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Implementation of the computer vision kernels.
+ */
+
+#include "vision.h"
+
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @copydoc downsample
+ */
+auto downsample(uint8 const* image, int width, int height, int stride, uint8* half,
+    int halfstride) noexcept -> void
+{
+    auto const hwidth = width / 2;
+    for (int y{}; y < height / 2; ++y) {
+        auto const* top = image + 2 * y * stride;
+        auto const* bottom = top + stride;
+        auto* dest = half + y * halfstride;
+        int x{};
+#ifdef SIMD_SSE2
+        for (; x + 16 <= hwidth; x += 16) {
+            auto const* t = reinterpret_cast<__m128i const*>(top + 2 * x);
+            auto const* b = reinterpret_cast<__m128i const*>(bottom + 2 * x);
+            auto const lo = simd::average_quads(_mm_loadu_si128(t),
+                _mm_loadu_si128(b));
+            auto const hi = simd::average_quads(_mm_loadu_si128(t + 1),
+                _mm_loadu_si128(b + 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x),
+                _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; x < hwidth; ++x) {
+            dest[x] = static_cast<uint8>((top[2 * x] + top[2 * x + 1]
+                + bottom[2 * x] + bottom[2 * x + 1] + 2) >> 2);
+        }
+    }
+}
+
+/**
+ * @copydoc bayer_to_quads
+ */
+auto bayer_to_quads(uint8 const* bayer, int width, int height, uint8* quads) noexcept
+    -> void
+{ downsample(bayer, width, height, width, quads, width / 2); }
+
+/**
+ * @copydoc color_table::add
+ */
+auto color_table::add(uint8 r, uint8 g, uint8 b, int tolerance) -> void {
+    samples_.push_back(to_yuv(r, g, b));
+    rebuild(tolerance);
+}
+
+/**
+ * @copydoc color_table::rebuild
+ */
+auto color_table::rebuild(int tolerance) noexcept -> void {
+    constexpr auto levels = 1 << bits;
+    constexpr auto shift = 8 - bits;
+    constexpr auto darkest = 16;
+
+    auto const maxchroma = tolerance * tolerance;
+    auto const maxluma = 4 * tolerance;
+    for (int r{}; r < levels; ++r) {
+        for (int g{}; g < levels; ++g) {
+            for (int b{}; b < levels; ++b) {
+                auto const color = to_yuv(
+                    (r << shift) | (1 << (shift - 1)),
+                    (g << shift) | (1 << (shift - 1)),
+                    (b << shift) | (1 << (shift - 1)));
+                auto const matches = color.y >= darkest and std::ranges::any_of(samples_,
+                    [&](sample const& s) {
+                        auto const du = color.u - s.u;
+                        auto const dv = color.v - s.v;
+                        return du * du + dv * dv <= maxchroma
+                            and std::abs(color.y - s.y) <= maxluma;
+                    });
+                table_[(r << (2 * bits)) | (g << bits) | b] = matches ? 255 : 0;
+            }
+        }
+    }
+}
+
+/**
+ * @copydoc color_table::clear
+ */
+auto color_table::clear() noexcept -> void {
+    samples_.clear();
+    table_.fill(0);
+}
+
+/**
+ * @copydoc color_table::classify
+ */
+auto color_table::classify(uint8 const* rgb, int width, int height, uint8* mask) const
+    noexcept -> void
+{
+    // SSE2 has neither a byte shuffle to deinterleave RGB nor a gather to index the
+    // table, so the index is computed with plain integer arithmetic. The loop is
+    // branch-free and the table lives in L1, which keeps it bound by memory bandwidth.
+    constexpr auto shift = 8 - bits;
+    auto const* table = table_.data();
+    auto const count = width * height;
+    for (int i{}; i < count; ++i, rgb += 3) {
+        mask[i] = table[((rgb[0] >> shift) << (2 * bits))
+            | ((rgb[1] >> shift) << bits) | (rgb[2] >> shift)];
+    }
+}
+
+} // namespace vis
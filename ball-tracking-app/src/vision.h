@@ -0,0 +1,189 @@
+/**
+ * @file       vision.h
+ * @version    0.1
+ * @date       July 2022
+ * @author     Joeri Kok
+ * @author     Rick Horeman
+ * @copyright  GPL-3.0 license
+ *
+ * @brief Computer vision kernels for tracking the ball.
+ */
+
+#ifndef VIS_VISION_H
+#define VIS_VISION_H
+
+#include "types.h"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @namespace vis
+ * @brief Computer vision related components.
+ */
+namespace vis {
+
+/**
+ * @brief Halves the resolution of a grayscale image by averaging every 2x2 block.
+ * @details A pixel at (x, y) of the result is centered at (2x + 0.5, 2y + 0.5) in the
+ *     source image. An odd last row or column of the source is dropped.
+ * @param[in] image Source image.
+ * @param[in] width Width of the source image.
+ * @param[in] height Height of the source image.
+ * @param[in] stride Number of bytes between the starts of two rows of the source image.
+ * @param[out] half Destination image of (width / 2) * (height / 2) pixels.
+ * @param[in] halfstride Number of bytes between the starts of two rows of the result.
+ */
+auto downsample(uint8 const* image, int width, int height, int stride, uint8* half,
+    int halfstride) noexcept -> void;
+
+/**
+ * @brief Reduces a raw Bayer mosaic to a half-resolution grayscale image.
+ * @details The PS3 Eye delivers a GRBG mosaic. Every 2x2 quad of the mosaic holds one
+ *     red, two green and one blue sample, which are averaged into a single pixel. This
+ *     replaces a full debayering pass when only the position of a gray ball is needed.
+ *     A quad at (x, y) is centered at (2x + 0.5, 2y + 0.5) in the full-resolution frame.
+ * @param[in] bayer Raw Bayer mosaic of width * height bytes.
+ * @param[in] width Width of the mosaic, required to be even.
+ * @param[in] height Height of the mosaic, required to be even.
+ * @param[out] quads Destination image of (width / 2) * (height / 2) bytes.
+ */
+auto bayer_to_quads(uint8 const* bayer, int width, int height, uint8* quads) noexcept
+    -> void;
+
+/**
+ * @brief Maps a coordinate of a half-resolution quad image to the full-resolution frame.
+ * @param[in] coordinate Coordinate along either axis of the quad image.
+ */
+[[nodiscard]]
+constexpr auto quad_to_frame(float coordinate) noexcept -> float
+{ return coordinate * 2.f + 0.5f; }
+
+/**
+ * @brief Maps a coordinate of the full-resolution frame to a half-resolution quad image.
+ * @param[in] coordinate Coordinate along either axis of the full-resolution frame.
+ */
+[[nodiscard]]
+constexpr auto frame_to_quad(float coordinate) noexcept -> float
+{ return (coordinate - 0.5f) * 0.5f; }
+
+/**
+ * @enum method
+ * @brief Method used to detect the ball in grayscale frames.
+ */
+enum class method {
+    hough,    /**< Hough circle transform. */
+    blob,     /**< Threshold and run-length blob detection. */
+    gradient, /**< Gradient voting at the known ball radii. */
+    ncc       /**< Normalized cross-correlation with a learned template. */
+};
+
+/**
+ * @struct blob
+ * @brief Position and size of a detected ball, in full-resolution pixel coordinates.
+ */
+struct blob {
+    float x;      /**< Center along the x-axis. */
+    float y;      /**< Center along the y-axis. */
+    float radius; /**< Radius in pixels. */
+};
+
+/**
+ * @struct candidate
+ * @brief Possible position of the ball as reported by a detector.
+ */
+struct candidate {
+    blob ball;        /**< Position and size of the candidate. */
+    float confidence; /**< Confidence in [0, 1] that the candidate is the ball. */
+};
+
+/**
+ * @class color_table
+ * @brief Lookup table that classifies RGB colors as either ball or background.
+ * @details Colors are quantized to 5 bits per channel, which results in a table of 32 KiB
+ *     that stays resident in the L1 cache. The table is built from clicked color samples:
+ *     a color belongs to the ball when its chroma is within the tolerance of any sample
+ *     and its luma is not too far off, which makes the classification robust against
+ *     the shading of the ball.
+ */
+class color_table {
+public:
+    /**
+     * @brief Number of bits per color channel used to index the table.
+     */
+    static constexpr auto bits = 5;
+
+    /**
+     * @brief Default constructs a table without samples that classifies nothing as ball.
+     */
+    color_table() noexcept
+    { table_.fill(0); }
+
+    /**
+     * @brief Adds a color sample of the ball and rebuilds the table.
+     * @param[in] r Red component of the sample.
+     * @param[in] g Green component of the sample.
+     * @param[in] b Blue component of the sample.
+     * @param[in] tolerance Maximum chroma distance to any sample.
+     */
+    auto add(uint8 r, uint8 g, uint8 b, int tolerance) -> void;
+
+    /**
+     * @brief Rebuilds the table with a new tolerance.
+     * @param[in] tolerance Maximum chroma distance to any sample.
+     */
+    auto rebuild(int tolerance) noexcept -> void;
+
+    /**
+     * @brief Removes all samples.
+     */
+    auto clear() noexcept -> void;
+
+    /**
+     * @brief Returns whether the table contains any samples.
+     */
+    [[nodiscard]]
+    auto empty() const noexcept -> bool
+    { return samples_.empty(); }
+
+    /**
+     * @brief Classifies an RGB image into a binary mask in a single pass.
+     * @param[in] rgb Interleaved RGB image of width * height * 3 bytes.
+     * @param[in] width Width of the image.
+     * @param[in] height Height of the image.
+     * @param[out] mask Destination mask of width * height bytes, set to 255 for pixels
+     *     of the ball and to 0 otherwise.
+     */
+    auto classify(uint8 const* rgb, int width, int height, uint8* mask) const noexcept
+        -> void;
+
+private:
+    /**
+     * @struct sample
+     * @brief Color sample in fixed-point YUV.
+     */
+    struct sample {
+        int y; /**< Luma. */
+        int u; /**< Blue-difference chroma. */
+        int v; /**< Red-difference chroma. */
+    };
+
+    /**
+     * @brief Converts an RGB color to fixed-point YUV.
+     */
+    [[nodiscard]]
+    static constexpr auto to_yuv(int r, int g, int b) noexcept -> sample {
+        return {
+            .y = (77 * r + 150 * g + 29 * b) >> 8,
+            .u = (-43 * r - 85 * g + 128 * b) >> 8,
+            .v = (128 * r - 107 * g - 21 * b) >> 8};
+    }
+
+    std::array<uint8, 1 << (3 * bits)> table_; /**< Classification per quantized color. */
+    std::vector<sample> samples_;              /**< Color samples of the ball. */
+};
+
+} // namespace vis
+
+#endif